@@ -0,0 +1,220 @@
+#include "AssetPack.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#ifdef WIN32
+#define NOMINMAX
+#include "Windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(AssetPack::Header) == 16 && sizeof(AssetPack::Entry) == 40, "The layout must not depend on the compiler");
+
+AssetPack::Type AssetPack::TypeOf (std::string const& name)
+{
+   std::string extension = name.substr(name.find_last_of('.') + 1);
+   std::transform(extension.begin(), extension.end(), extension.begin(), [] (unsigned char c) { return char(std::tolower(c)); });
+
+   if (extension == "obj")
+      return Type::MESH;
+   if (extension == "tga" || extension == "png" || extension == "jpg" || extension == "bmp")
+      return Type::TEXTURE;
+   if (extension == "ttf")
+      return Type::FONT;
+   return Type::OTHER;
+}
+
+uint64_t AssetPack::Hash (void const* data, size_t const size)
+{
+   uint64_t hash = 0xcbf29ce484222325ull;
+   auto const* bytes = static_cast<unsigned char const*>(data);
+   for (size_t i = 0; i < size; ++i)
+   {
+      hash ^= bytes[i];
+      hash *= 0x100000001b3ull;
+   }
+   return hash;
+}
+
+bool AssetPack::Write (std::string const& path, std::vector<std::pair<std::string, std::string>> const& files)
+{
+   // Sorted by name, so that they can be looked up by binary search
+   std::vector<std::pair<std::string, std::string>> sorted = files;
+   std::sort(sorted.begin(), sorted.end());
+
+   std::vector<Entry> entries(sorted.size());
+   std::string names;
+   for (size_t i = 0; i < sorted.size(); ++i)
+   {
+      entries[i].nameOffset = uint32_t(names.size());
+      entries[i].nameSize = uint32_t(sorted[i].first.size());
+      entries[i].type = TypeOf(sorted[i].first);
+      entries[i].reserved = 0;
+      names += sorted[i].first;
+   }
+
+   Header header;
+   std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+   header.version = VERSION;
+   header.entryCount = uint32_t(entries.size());
+   header.namesSize = uint32_t(names.size());
+
+   // Contents are read one file at a time, and appended after the index, which is filled in last
+   std::ofstream out(path, std::ios::binary | std::ios::trunc);
+   if (!out)
+   {
+      std::cerr << "Could not create asset pack " << path << std::endl;
+      return false;
+   }
+
+   uint64_t offset = sizeof(Header) + entries.size() * sizeof(Entry) + names.size();
+   std::vector<char> contents;
+   for (size_t i = 0; i < sorted.size(); ++i)
+   {
+      std::ifstream in(sorted[i].second, std::ios::binary);
+      if (!in)
+      {
+         std::cerr << "Could not read " << sorted[i].second << std::endl;
+         return false;
+      }
+      contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+      offset = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+      entries[i].offset = offset;
+      entries[i].size = contents.size();
+      entries[i].hash = Hash(contents.data(), contents.size());
+      out.seekp(std::streamoff(offset));
+      out.write(contents.data(), std::streamsize(contents.size()));
+      offset += contents.size();
+   }
+
+   out.seekp(0);
+   out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+   out.write(reinterpret_cast<char const*>(entries.data()), std::streamsize(entries.size() * sizeof(Entry)));
+   out.write(names.data(), std::streamsize(names.size()));
+   return bool(out);
+}
+
+std::unique_ptr<AssetPack> AssetPack::Open (std::string const& path)
+{
+   std::unique_ptr<AssetPack> pPack(new AssetPack());
+
+#ifdef WIN32
+   HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+   if (file == INVALID_HANDLE_VALUE) return nullptr;
+   pPack->m_file = file;
+
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) return nullptr;
+   pPack->m_size = size_t(size.QuadPart);
+
+   pPack->m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   if (pPack->m_mapping == nullptr) return nullptr;
+   pPack->m_data = MapViewOfFile(pPack->m_mapping, FILE_MAP_READ, 0, 0, 0);
+   if (pPack->m_data == nullptr) return nullptr;
+#else
+   int const file = open(path.c_str(), O_RDONLY);
+   if (file < 0) return nullptr;
+
+   struct stat status;
+   if (fstat(file, &status) != 0 || status.st_size == 0)
+   {
+      close(file);
+      return nullptr;
+   }
+   pPack->m_size = size_t(status.st_size);
+
+   // The mapping stays valid once the file is closed
+   void* data = mmap(nullptr, pPack->m_size, PROT_READ, MAP_PRIVATE, file, 0);
+   close(file);
+   if (data == MAP_FAILED) return nullptr;
+   pPack->m_data = data;
+#endif
+
+   // Everything the index points to must lie within the archive, so that lookups needn't check
+   auto const* bytes = static_cast<char const*>(pPack->m_data);
+   Header header;
+   if (pPack->m_size < sizeof(Header)) return nullptr;
+   std::memcpy(&header, bytes, sizeof(header));
+   if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION)
+   {
+      std::cerr << path << " isn't an asset pack of version " << VERSION << std::endl;
+      return nullptr;
+   }
+
+   uint64_t const namesOffset = sizeof(Header) + uint64_t(header.entryCount) * sizeof(Entry);
+   if (namesOffset + header.namesSize > pPack->m_size)
+   {
+      std::cerr << "Asset pack " << path << " is truncated" << std::endl;
+      return nullptr;
+   }
+   pPack->m_entries = reinterpret_cast<Entry const*>(bytes + sizeof(Header));
+   pPack->m_entryCount = header.entryCount;
+   pPack->m_names = bytes + namesOffset;
+
+   for (uint32_t i = 0; i < header.entryCount; ++i)
+   {
+      Entry const& entry = pPack->m_entries[i];
+      if (uint64_t(entry.nameOffset) + entry.nameSize > header.namesSize || entry.offset > pPack->m_size
+         || entry.size > pPack->m_size - entry.offset)
+      {
+         std::cerr << "Asset pack " << path << " is corrupt" << std::endl;
+         return nullptr;
+      }
+   }
+
+   return pPack;
+}
+
+AssetPack::~AssetPack ()
+{
+#ifdef WIN32
+   if (m_data) UnmapViewOfFile(m_data);
+   if (m_mapping) CloseHandle(m_mapping);
+   if (m_file) CloseHandle(m_file);
+#else
+   if (m_data) munmap(const_cast<void*>(m_data), m_size);
+#endif
+}
+
+AssetPack::Asset AssetPack::Find (std::string const& name) const
+{
+   auto const compare = [this] (Entry const& entry, std::string const& name) {
+      return name.compare(0, std::string::npos, m_names + entry.nameOffset, entry.nameSize) > 0;
+   };
+   Entry const* end = m_entries + m_entryCount;
+   Entry const* entry = std::lower_bound(m_entries, end, name, compare);
+
+   Asset asset;
+   if (entry == end || name.compare(0, std::string::npos, m_names + entry->nameOffset, entry->nameSize) != 0)
+      return asset;
+
+   asset.data = static_cast<char const*>(m_data) + entry->offset;
+   asset.size = size_t(entry->size);
+   asset.type = entry->type;
+   return asset;
+}
+
+bool AssetPack::Verify () const
+{
+   bool valid = true;
+   for (uint32_t i = 0; i < m_entryCount; ++i)
+   {
+      Entry const& entry = m_entries[i];
+      if (Hash(static_cast<char const*>(m_data) + entry.offset, size_t(entry.size)) != entry.hash)
+      {
+         std::cerr << "Asset " << std::string(m_names + entry.nameOffset, entry.nameSize) << " doesn't match its hash" << std::endl;
+         valid = false;
+      }
+   }
+   return valid;
+}
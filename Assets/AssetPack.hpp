@@ -0,0 +1,120 @@
+#ifndef AssetPack_hpp
+#define AssetPack_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Single archive of many asset files, so that loading a scene takes one open rather than one per file, which is slow
+ * on networked storage. The archive is mapped into memory as a whole, and loaders read assets straight from the
+ * mapping, without copying them; the OS pages in whatever is read.
+ *
+ * Layout, little-endian: a Header, then the Entry of every asset, sorted by name, then the names, one after the
+ * other, then the assets' contents, each starting on a multiple of ALIGNMENT. Assets are named after the paths they
+ * were packed from, e.g. "models/cube.obj", so that the same path finds an asset in the pack or on disk.
+ *
+ * Built by the pack_assets tool; cf. Tools/PackAssets.cpp.
+ */
+class AssetPack
+{
+public:
+   enum class Type : uint32_t
+   {
+      OTHER,
+      MESH,
+      TEXTURE,
+      FONT
+   };
+
+   struct Header
+   {
+      char magic[4];
+      uint32_t version;
+      uint32_t entryCount;
+      uint32_t namesSize; // bytes
+   };
+
+   struct Entry
+   {
+      uint64_t offset; // of the contents, from the start of the archive
+      uint64_t size;
+      uint64_t hash; // of the contents; cf. Hash()
+      uint32_t nameOffset; // from the start of the names
+      uint32_t nameSize;
+      Type type;
+      uint32_t reserved;
+   };
+
+   static constexpr char MAGIC[4] = {'P', '3', '1', 'K'};
+   static constexpr uint32_t VERSION = 1;
+   static constexpr size_t ALIGNMENT = 16;
+
+   /**
+    * What an asset is, going by its name's extension
+    */
+   static Type TypeOf (std::string const& name);
+
+   /**
+    * 64-bit FNV-1a; only meant to catch corrupt or stale archives
+    */
+   static uint64_t Hash (void const* data, size_t const size);
+
+   /**
+    * Packs the given files, each a (name, path) pair, into a new archive at `path`. Returns false upon failure, e.g.
+    * if a file couldn't be read.
+    */
+   static bool Write (std::string const& path, std::vector<std::pair<std::string, std::string>> const& files);
+
+   /**
+    * Maps the archive into memory; nullptr if there's none at the given path, or it isn't valid
+    */
+   static std::unique_ptr<AssetPack> Open (std::string const& path);
+
+   ~AssetPack ();
+
+   AssetPack (AssetPack const&) = delete;
+   AssetPack & operator= (AssetPack const&) = delete;
+
+   /**
+    * An asset's contents, in the mapping; valid for as long as the pack is
+    */
+   struct Asset
+   {
+      void const* data = nullptr; // none if not found
+      size_t size = 0;
+      Type type = Type::OTHER;
+
+      explicit operator bool () const { return data != nullptr; }
+   };
+
+   /**
+    * Looks the asset up by name, in logarithmic time
+    */
+   Asset Find (std::string const& name) const;
+
+   /**
+    * Whether every asset's contents match their hash. Reads the whole archive, so it's for tools rather than loading.
+    */
+   bool Verify () const;
+
+   size_t AssetCount () const { return m_entryCount; }
+
+private:
+   AssetPack () {}
+
+   void const* m_data = nullptr;
+   size_t m_size = 0;
+   Entry const* m_entries = nullptr;
+   uint32_t m_entryCount = 0;
+   char const* m_names = nullptr;
+#ifdef WIN32
+   void* m_file = nullptr;
+   void* m_mapping = nullptr;
+#endif
+};
+
+#endif
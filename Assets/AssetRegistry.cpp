@@ -0,0 +1,200 @@
+#include "AssetRegistry.hpp"
+
+#include <algorithm>
+
+#include "SDLTextureLoader.hpp"
+#include "JobSystem.hpp"
+
+AssetRegistry::AssetRegistry ()
+{
+   m_pTextureLoader = std::make_unique<SDLTextureLoader>();
+}
+
+void AssetRegistry::Pack (std::shared_ptr<AssetPack const> pPack)
+{
+   m_pPack = std::move(pPack);
+   m_pTextureLoader = std::make_shared<SDLTextureLoader>(m_compressTextures, m_pPack);
+}
+
+void AssetRegistry::CompressTextures (bool const compress)
+{
+   m_compressTextures = compress;
+   m_pTextureLoader = std::make_shared<SDLTextureLoader>(compress, m_pPack);
+}
+
+std::unique_ptr<Mesh> AssetRegistry::LoadMesh (AssetPack const* pPack, std::string const& path)
+{
+   if (AssetPack::Asset const asset = pPack ? pPack->Find(path) : AssetPack::Asset())
+      return Mesh::MakeFromOBJ(static_cast<char const*>(asset.data), asset.size, path);
+   return Mesh::MakeFromOBJ(path);
+}
+
+std::shared_ptr<StreamedTexture const> AssetRegistry::GetStreamedTexture (std::string const& path)
+{
+   if (!m_pStreamer)
+      m_pStreamer = std::make_unique<TextureStreamer>(std::make_unique<SDLTextureLoader>(m_compressTextures, m_pPack), m_streamingBudget);
+   return m_pStreamer->Get(path);
+}
+
+void AssetRegistry::UpdateStreaming ()
+{
+   if (m_pStreamer)
+      m_pStreamer->Update();
+}
+
+std::shared_ptr<Mesh const> AssetRegistry::GetMesh (std::string const& path)
+{
+   auto & entry = m_meshes[path];
+   if (auto pMesh = entry.lock())
+      return pMesh;
+
+   std::shared_ptr<Mesh const> pMesh = LoadMesh(m_pPack.get(), path);
+   entry = pMesh;
+   return pMesh;
+}
+
+std::shared_ptr<TextureMap const> AssetRegistry::GetTexture (std::string const& path)
+{
+   auto & entry = m_textures[path];
+   if (auto pTexture = entry.lock())
+      return pTexture;
+
+   std::shared_ptr<TextureMap const> pTexture = m_pTextureLoader->LoadFromFile(path);
+   entry = pTexture;
+   return pTexture;
+}
+
+/**
+ * Handle to the resident asset if there's one, or else to the one being loaded, or else to a new one, whose loading
+ * is queued in the background
+ */
+template <typename Asset, typename Load>
+std::shared_ptr<AssetHandle<Asset> const> AssetRegistry::StartLoad (std::string const& path,
+   std::unordered_map<std::string, std::weak_ptr<Asset const>> & resident,
+   std::unordered_map<std::string, std::shared_ptr<AssetHandle<Asset>>> & loading, Load const& load)
+{
+   auto it = loading.find(path);
+   if (it != loading.end())
+      return it->second;
+
+   auto pHandle = std::make_shared<AssetHandle<Asset>>(path);
+   auto residentIt = resident.find(path);
+   if (residentIt != resident.end() && (pHandle->m_pAsset = residentIt->second.lock()))
+   {
+      pHandle->m_loading = false;
+      return pHandle;
+   }
+
+   loading[path] = pHandle;
+   JobSystem::Instance().RunInBackground([pHandle, load] {
+      pHandle->m_pLoaded = load(pHandle->Path());
+      pHandle->m_done.store(true, std::memory_order_release);
+   });
+   return pHandle;
+}
+
+/**
+ * Publishes the assets whose loads finished, to their handles and the registry; returns whether there were any
+ */
+template <typename Asset>
+bool AssetRegistry::FinishLoads (std::unordered_map<std::string, std::weak_ptr<Asset const>> & resident,
+   std::unordered_map<std::string, std::shared_ptr<AssetHandle<Asset>>> & loading)
+{
+   bool any = false;
+   for (auto it = loading.begin(); it != loading.end();)
+   {
+      AssetHandle<Asset> & handle = *it->second;
+      if (!handle.m_done.load(std::memory_order_acquire))
+      {
+         ++it;
+         continue;
+      }
+
+      handle.m_pAsset = std::move(handle.m_pLoaded);
+      handle.m_loading = false;
+      if (handle.m_pAsset)
+         resident[it->first] = handle.m_pAsset;
+      it = loading.erase(it);
+      any = true;
+   }
+   return any;
+}
+
+std::shared_ptr<AssetHandle<Mesh> const> AssetRegistry::LoadMeshAsync (std::string const& path)
+{
+   std::shared_ptr<AssetPack const> pPack = m_pPack;
+   return StartLoad(path, m_meshes, m_loadingMeshes, [pPack] (std::string const& path) {
+      return std::shared_ptr<Mesh const>(LoadMesh(pPack.get(), path));
+   });
+}
+
+std::shared_ptr<AssetHandle<TextureMap> const> AssetRegistry::LoadTextureAsync (std::string const& path)
+{
+   std::shared_ptr<ITextureLoader> pTextureLoader = m_pTextureLoader;
+   return StartLoad(path, m_textures, m_loadingTextures, [pTextureLoader] (std::string const& path) {
+      return std::shared_ptr<TextureMap const>(pTextureLoader->LoadFromFile(path));
+   });
+}
+
+bool AssetRegistry::UpdateLoads ()
+{
+   if (m_loadingMeshes.empty() && m_loadingTextures.empty()) return false;
+
+   bool const meshes = FinishLoads(m_meshes, m_loadingMeshes);
+   bool const textures = FinishLoads(m_textures, m_loadingTextures);
+   return meshes || textures;
+}
+
+std::vector<std::shared_ptr<void const>> AssetRegistry::Preload (std::vector<std::string> const& meshPaths, std::vector<std::string> const& texturePaths)
+{
+   std::vector<std::shared_ptr<void const>> resident;
+
+   // The maps are only ever touched from this thread; the jobs merely fill in their own slots
+   std::vector<std::string const*> meshesToLoad, texturesToLoad;
+   for (auto const& path : meshPaths)
+   {
+      if (auto pMesh = m_meshes[path].lock())
+         resident.push_back(std::move(pMesh));
+      else if (std::find_if(meshesToLoad.begin(), meshesToLoad.end(), [&] (std::string const* p) { return *p == path; }) == meshesToLoad.end())
+         meshesToLoad.push_back(&path);
+   }
+   for (auto const& path : texturePaths)
+   {
+      if (auto pTexture = m_textures[path].lock())
+         resident.push_back(std::move(pTexture));
+      else if (std::find_if(texturesToLoad.begin(), texturesToLoad.end(), [&] (std::string const* p) { return *p == path; }) == texturesToLoad.end())
+         texturesToLoad.push_back(&path);
+   }
+
+   std::vector<std::shared_ptr<Mesh const>> meshes(meshesToLoad.size());
+   std::vector<std::shared_ptr<TextureMap const>> textures(texturesToLoad.size());
+   uint const meshCount = uint(meshesToLoad.size());
+   uint const count = meshCount + uint(texturesToLoad.size());
+
+   // One asset per job, as they vary wildly in size
+   ITextureLoader* pTextureLoader = m_pTextureLoader.get();
+   JobSystem::Instance().ParallelFor(count, 1, [&] (uint const begin, uint const end) {
+      for (uint i = begin; i < end; ++i)
+      {
+         if (i < meshCount)
+            meshes[i] = LoadMesh(m_pPack.get(), *meshesToLoad[i]);
+         else
+            textures[i - meshCount] = pTextureLoader->LoadFromFile(*texturesToLoad[i - meshCount]);
+      }
+   });
+
+   for (size_t i = 0; i < meshes.size(); ++i)
+   {
+      if (!meshes[i]) continue;
+      m_meshes[*meshesToLoad[i]] = meshes[i];
+      resident.push_back(std::move(meshes[i]));
+   }
+   for (size_t i = 0; i < textures.size(); ++i)
+   {
+      if (!textures[i]) continue;
+      m_textures[*texturesToLoad[i]] = textures[i];
+      resident.push_back(std::move(textures[i]));
+   }
+
+   return resident;
+}
@@ -0,0 +1,136 @@
+#ifndef AssetRegistry_hpp
+#define AssetRegistry_hpp
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AssetHandle.hpp"
+#include "AssetPack.hpp"
+#include "Mesh.hpp"
+#include "Texture.hpp"
+#include "ITextureLoader.hpp"
+#include "TextureStreamer.hpp"
+
+/**
+ * Loads immutable assets on demand and shares a single instance between everyone who asks for the same path.
+ * Only weak references are kept here, so an asset is freed as soon as the last object using it is destroyed,
+ * and gets reloaded if it is ever asked for again.
+ */
+class AssetRegistry
+{
+   std::shared_ptr<AssetPack const> m_pPack; // searched before loose files, if any
+   std::shared_ptr<ITextureLoader> m_pTextureLoader; // shared with the background loads, which may outlive the registry
+   bool m_compressTextures = false;
+   bool m_atlasTextures = false;
+   size_t m_streamingBudget = 0; // bytes; none if textures aren't streamed
+   std::unique_ptr<TextureStreamer> m_pStreamer; // once the first streamed texture is asked for
+
+   std::unordered_map<std::string, std::weak_ptr<Mesh const>> m_meshes;
+   std::unordered_map<std::string, std::weak_ptr<TextureMap const>> m_textures;
+
+   bool m_loadAsync = false;
+   std::unordered_map<std::string, std::shared_ptr<AssetHandle<Mesh>>> m_loadingMeshes;
+   std::unordered_map<std::string, std::shared_ptr<AssetHandle<TextureMap>>> m_loadingTextures;
+
+   /**
+    * Loads the mesh from the pack if it's in there, or else from its file
+    */
+   static std::unique_ptr<Mesh> LoadMesh (AssetPack const* pPack, std::string const& path);
+
+   template <typename Asset, typename Load>
+   static std::shared_ptr<AssetHandle<Asset> const> StartLoad (std::string const& path,
+      std::unordered_map<std::string, std::weak_ptr<Asset const>> & resident,
+      std::unordered_map<std::string, std::shared_ptr<AssetHandle<Asset>>> & loading, Load const& load);
+
+   template <typename Asset>
+   static bool FinishLoads (std::unordered_map<std::string, std::weak_ptr<Asset const>> & resident,
+      std::unordered_map<std::string, std::shared_ptr<AssetHandle<Asset>>> & loading);
+
+public:
+   AssetRegistry ();
+
+   /**
+    * Archive that assets asked for from now on are read from, when they're in it, rather than from loose files;
+    * cf. AssetPack
+    */
+   AssetPack const* Pack () const { return m_pPack.get(); }
+   void Pack (std::shared_ptr<AssetPack const> pPack);
+
+   /**
+    * Returns nullptr if the mesh could not be loaded
+    */
+   std::shared_ptr<Mesh const> GetMesh (std::string const& path);
+
+   /**
+    * Returns nullptr if the texture could not be loaded
+    */
+   std::shared_ptr<TextureMap const> GetTexture (std::string const& path);
+
+   /**
+    * Loads every asset in the lists that isn't already resident, in parallel on the job system, so that the
+    * subsequent Get*() calls are served from the registry. As only weak references are kept, the assets stay
+    * resident for as long as the returned references are held.
+    */
+   std::vector<std::shared_ptr<void const>> Preload (std::vector<std::string> const& meshPaths, std::vector<std::string> const& texturePaths);
+
+   /**
+    * Whether scenes loaded from now on load their assets in the background, rather than up front; cf. LoadMeshAsync
+    */
+   bool LoadAsync () const { return m_loadAsync; }
+   void LoadAsync (bool const async) { m_loadAsync = async; }
+
+   /**
+    * Loads the asset as a background task on the job system, unless it's resident or already being loaded, and
+    * returns right away. The handle's asset shows up once UpdateLoads() has seen the load finish, and is then
+    * shared like any other.
+    */
+   std::shared_ptr<AssetHandle<Mesh> const> LoadMeshAsync (std::string const& path);
+   std::shared_ptr<AssetHandle<TextureMap> const> LoadTextureAsync (std::string const& path);
+
+   /**
+    * Swaps the assets that finished loading into their handles. Must be called between frames, when nothing is
+    * being drawn, on the thread that asks for assets. Returns whether any showed up, or failed to.
+    */
+   bool UpdateLoads ();
+
+   /**
+    * Assets still being loaded in the background
+    */
+   size_t PendingLoads () const { return m_loadingMeshes.size() + m_loadingTextures.size(); }
+
+   /**
+    * Whether textures loaded from now on are compressed; cf. TextureCompression. Those already resident stay as is.
+    */
+   bool CompressTextures () const { return m_compressTextures; }
+   void CompressTextures (bool const compress);
+
+   /**
+    * Whether scenes loaded from now on pack their small textures into atlas pages; cf. TextureAtlas
+    */
+   bool AtlasTextures () const { return m_atlasTextures; }
+   void AtlasTextures (bool const atlas) { m_atlasTextures = atlas; }
+
+   /**
+    * Whether scenes loaded from now on stream their textures, within the given budget of resident texels;
+    * cf. TextureStreamer
+    */
+   bool StreamTextures () const { return m_streamingBudget != 0; }
+   void StreamTextures (bool const stream, size_t const budgetBytes) { m_streamingBudget = stream ? budgetBytes : 0; }
+
+   /**
+    * The texture of the given file, loaded in the background; a placeholder until then
+    */
+   std::shared_ptr<StreamedTexture const> GetStreamedTexture (std::string const& path);
+
+   /**
+    * Swaps in the streamed textures that finished loading, and trims or loads others as needed. Must be called
+    * between frames, when nothing is being drawn.
+    */
+   void UpdateStreaming ();
+
+   TextureStreamer const* Streamer () const { return m_pStreamer.get(); }
+};
+
+#endif
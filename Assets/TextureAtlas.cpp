@@ -0,0 +1,156 @@
+#include "TextureAtlas.hpp"
+
+#include <algorithm>
+
+#include "MemoryTracker.hpp"
+
+/**
+ * Regions start, and their padding ends, on multiples of this many texels, so that at every level of a page, a texel
+ * only ever covers a single region's
+ */
+static constexpr uint REGION_ALIGNMENT = 2 * TextureAtlas::PADDING;
+
+static uint AlignRegion (uint const size)
+{
+   return (size + REGION_ALIGNMENT - 1) / REGION_ALIGNMENT * REGION_ALIGNMENT;
+}
+
+bool TextureAtlas::Fits (TextureMap const& texture)
+{
+   return texture.m_width <= MAX_TEXTURE_SIZE && texture.m_height <= MAX_TEXTURE_SIZE;
+}
+
+bool TextureAtlas::HasUnitUVs (Mesh const& mesh)
+{
+   for (auto const& face : mesh.GetFaces())
+   {
+      for (uint8_t i = 0; i < 3; ++i)
+      {
+         Vector2 const& uv = face[i].uv();
+         if (uv.x < 0.f || uv.x > 1.f || uv.y < 0.f || uv.y > 1.f)
+            return false;
+      }
+   }
+   return true;
+}
+
+TextureAtlas::TextureAtlas (std::vector<TextureMap const*> const& textures, bool const compress)
+{
+   MEMORY_SCOPE(TEXTURES);
+
+   struct Placement
+   {
+      TextureMap const* texture;
+      uint width, height; // padding included
+      uint page, x, y;
+   };
+
+   std::vector<Placement> placements;
+   for (TextureMap const* texture : textures)
+   {
+      if (!Fits(*texture) || m_regions.count(texture) != 0) continue;
+      m_regions[texture] = Region();
+      placements.push_back({texture, AlignRegion(texture->m_width + 2 * PADDING), AlignRegion(texture->m_height + 2 * PADDING), 0, 0, 0});
+   }
+   if (placements.empty()) return;
+
+   // Shelf packing: tallest first, left to right along shelves, each as tall as its first; shelves top to bottom
+   std::stable_sort(placements.begin(), placements.end(), [](Placement const& a, Placement const& b) { return a.height > b.height; });
+   std::vector<std::pair<uint, uint>> pageSizes{{0, 0}}; // used, along either axis
+   uint x = 0, y = 0, shelfHeight = 0;
+   for (auto & placement : placements)
+   {
+      if (x + placement.width > PAGE_SIZE)
+      {
+         x = 0;
+         y += shelfHeight;
+         shelfHeight = 0;
+      }
+      if (y + placement.height > PAGE_SIZE)
+      {
+         pageSizes.push_back({0, 0});
+         x = y = shelfHeight = 0;
+      }
+      if (shelfHeight == 0) shelfHeight = placement.height;
+
+      placement.page = uint(pageSizes.size() - 1);
+      placement.x = x;
+      placement.y = y;
+      x += placement.width;
+      auto & size = pageSizes.back();
+      size.first = std::max(size.first, x);
+      size.second = std::max(size.second, y + placement.height);
+   }
+
+   // Pages are only as large as what they hold
+   std::vector<std::vector<TextureMap::MipLevel>> mips(pageSizes.size());
+   std::vector<TextureMap::PixelBuffer> pixels(pageSizes.size());
+   for (size_t p = 0; p < pageSizes.size(); ++p)
+   {
+      size_t total = 0;
+      for (uint level = 0; level < MIP_COUNT; ++level)
+      {
+         mips[p].push_back({pageSizes[p].first >> level, pageSizes[p].second >> level, total});
+         total += size_t(mips[p].back().width) * mips[p].back().height;
+      }
+      pixels[p].resize(total);
+   }
+
+   // Each level of a region, padding included, is the same level of its texture clamped to its edges, rather than a
+   // filtered copy of the region's level above, so that it samples just like the texture itself, even at its edges
+   for (auto const& placement : placements)
+   {
+      TextureMap const& texture = *placement.texture;
+      for (uint level = 0; level < MIP_COUNT; ++level)
+      {
+         uint const from = std::min(level, texture.MipCount() - 1); // tiny textures have fewer levels
+         int const width = int(texture.Mip(from).width), height = int(texture.Mip(from).height);
+         int const padding = int(PADDING >> level);
+         TextureMap::MipLevel const& pageLevel = mips[placement.page][level];
+         for (uint py = 0; py < placement.height >> level; ++py)
+         {
+            uint const ty = uint(std::min(std::max(int(py) - padding, 0), height - 1));
+            ColorRGB* row = &pixels[placement.page][pageLevel.offset + size_t((placement.y >> level) + py) * pageLevel.width + (placement.x >> level)];
+            for (uint px = 0; px < placement.width >> level; ++px)
+               row[px] = texture.Texel(from, uint(std::min(std::max(int(px) - padding, 0), width - 1)), ty);
+         }
+      }
+   }
+
+   for (size_t p = 0; p < pageSizes.size(); ++p)
+   {
+      m_pages.push_back(TextureMap::MakeFromPixels(pageSizes[p].first, pageSizes[p].second, pixels[p], mips[p], compress));
+   }
+
+   // uv maps 0,0 to the bottom-left corner of a texture; rows go from the top down
+   for (auto const& placement : placements)
+   {
+      float const pageWidth = float(pageSizes[placement.page].first), pageHeight = float(pageSizes[placement.page].second);
+      float const width = float(placement.texture->m_width), height = float(placement.texture->m_height);
+      Region & region = m_regions[placement.texture];
+      region.page = m_pages[placement.page];
+      region.scale = Vector2(width / pageWidth, height / pageHeight);
+      region.offset = Vector2((placement.x + PADDING) / pageWidth, 1.f - (placement.y + PADDING + height) / pageHeight);
+   }
+}
+
+TextureAtlas::Region const* TextureAtlas::Find (TextureMap const* texture) const
+{
+   auto const it = m_regions.find(texture);
+   return it != m_regions.end() ? &it->second : nullptr;
+}
+
+std::shared_ptr<Mesh const> TextureAtlas::MeshFor (std::shared_ptr<Mesh const> const& mesh, TextureMap const* texture)
+{
+   auto const key = std::make_pair(mesh.get(), texture);
+   auto const it = m_meshes.find(key);
+   if (it != m_meshes.end())
+      return it->second;
+
+   Region const* region = Find(texture);
+   std::shared_ptr<Mesh const> pMesh;
+   if (region != nullptr && HasUnitUVs(*mesh))
+      pMesh = mesh->WithUVTransform(region->scale, region->offset);
+   m_meshes[key] = pMesh;
+   return pMesh;
+}
@@ -0,0 +1,75 @@
+#ifndef TextureAtlas_hpp
+#define TextureAtlas_hpp
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Mesh.hpp"
+#include "Texture.hpp"
+
+/**
+ * Packs small textures into shared pages, so that objects using any of them can be drawn from the same, dense page
+ * rather than from many small allocations. Built once, at load time.
+ *
+ * Only suits textures that are clamped and sampled within [0, 1], by meshes whose uvs all lie there; a mesh's uvs are
+ * then rewritten to point into the texture's region of its page, in a copy of the mesh. Every region is surrounded
+ * by copies of its edge texels, so that filtering near an edge never picks up a neighbour's texels. Padding shrinks
+ * by half at every mip level, so pages only have the levels it still covers a texel at.
+ */
+class TextureAtlas
+{
+public:
+   static constexpr uint PAGE_SIZE = 1024;
+   static constexpr uint MAX_TEXTURE_SIZE = 256; // along either axis; larger textures are dense enough on their own
+   static constexpr uint PADDING = 8; // texels of edge copies around every region, at level 0
+   static constexpr uint MIP_COUNT = 4; // levels of every page: the padding is 8, 4, 2, then 1 texel wide
+
+   /**
+    * Where a texture went: uv in the texture maps to uv * scale + offset in the page
+    */
+   struct Region
+   {
+      std::shared_ptr<TextureMap const> page;
+      Vector2 scale, offset;
+   };
+
+   /**
+    * Whether the texture is small enough to be packed
+    */
+   static bool Fits (TextureMap const& texture);
+
+   /**
+    * Whether every uv of the mesh lies within [0, 1], i.e. whether the mesh may sample from a region of a page
+    */
+   static bool HasUnitUVs (Mesh const& mesh);
+
+   /**
+    * Packs every texture that fits, compressing the pages if asked to. Textures are copied, so they need not outlive
+    * the atlas.
+    */
+   TextureAtlas (std::vector<TextureMap const*> const& textures, bool const compress);
+
+   /**
+    * Region of the given texture, or nullptr if it wasn't packed
+    */
+   Region const* Find (TextureMap const* texture) const;
+
+   /**
+    * Copy of the mesh, sampling from the texture's region, or nullptr if the texture wasn't packed or the mesh's uvs
+    * stray out of it. Every object that uses the same mesh with the same texture gets the same copy, so that they can
+    * still be drawn as one batch.
+    */
+   std::shared_ptr<Mesh const> MeshFor (std::shared_ptr<Mesh const> const& mesh, TextureMap const* texture);
+
+   size_t PageCount () const { return m_pages.size(); }
+
+private:
+   std::vector<std::shared_ptr<TextureMap const>> m_pages;
+   std::unordered_map<TextureMap const*, Region> m_regions;
+   std::map<std::pair<Mesh const*, TextureMap const*>, std::shared_ptr<Mesh const>> m_meshes;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "TextureStreamer.hpp"
+
+#include <algorithm>
+
+#include "JobSystem.hpp"
+#include "MemoryTracker.hpp"
+
+TextureStreamer::TextureStreamer (std::shared_ptr<ITextureLoader> pLoader, size_t const budgetBytes)
+   : m_pLoader(std::move(pLoader))
+   , m_budgetBytes(budgetBytes)
+{
+   MEMORY_SCOPE(TEXTURES);
+   m_pPlaceholder = TextureMap::MakeFromPixels(1, 1, TextureMap::PixelBuffer{0x808080FF}, false);
+}
+
+std::shared_ptr<StreamedTexture const> TextureStreamer::Get (std::string const& path)
+{
+   auto & entry = m_paths[path];
+   if (auto pStream = entry.lock())
+      return pStream;
+
+   auto pStream = std::make_shared<StreamedTexture>(path, m_pPlaceholder);
+   entry = pStream;
+   m_streams.push_back(pStream);
+   return pStream;
+}
+
+size_t TextureStreamer::LevelBytes (StreamedTexture const& stream, uint const firstLevel) const
+{
+   size_t texels = 0;
+   for (uint level = firstLevel; level < stream.m_levelCount; ++level)
+      texels += TextureMap::TiledSize(std::max(1u, stream.m_width >> level), std::max(1u, stream.m_height >> level));
+   return m_compressed ? texels / TextureCompression::TEXELS_PER_BLOCK * sizeof(TextureCompression::Block) : texels * sizeof(ColorRGB);
+}
+
+void TextureStreamer::Trim (StreamedTexture & stream, uint const firstLevel)
+{
+   if (firstLevel <= stream.m_firstLevel) return;
+
+   m_residentBytes -= stream.m_pCurrent->SizeInBytes();
+   stream.m_pCurrent = TextureMap::MakeFromLevels(*stream.m_pCurrent, firstLevel - stream.m_firstLevel);
+   stream.m_firstLevel = firstLevel;
+   m_residentBytes += stream.m_pCurrent->SizeInBytes();
+}
+
+void TextureStreamer::Update ()
+{
+   MEMORY_SCOPE(TEXTURES);
+   ++m_frame;
+
+   // Swap in the textures that finished loading
+   for (size_t i = 0; i < m_pendingLoads.size();)
+   {
+      if (!m_pendingLoads[i]->done.load(std::memory_order_acquire))
+      {
+         ++i;
+         continue;
+      }
+      std::shared_ptr<Load> const load = std::move(m_pendingLoads[i]);
+      m_pendingLoads[i] = std::move(m_pendingLoads.back());
+      m_pendingLoads.pop_back();
+
+      StreamedTexture & stream = *load->stream;
+      stream.m_loading = false;
+      if (!load->result)
+      {
+         stream.m_failed = true; // and stays a placeholder
+         continue;
+      }
+
+      TextureMap const& texture = *load->result;
+      uint firstLevel = load->firstLevel;
+      if (!stream.m_loaded)
+      {
+         stream.m_loaded = true;
+         stream.m_width = texture.m_width;
+         stream.m_height = texture.m_height;
+         stream.m_levelCount = texture.MipCount();
+         while (stream.m_tailLevel + 1 < stream.m_levelCount
+            && (texture.Mip(stream.m_tailLevel).width > TAIL_SIZE || texture.Mip(stream.m_tailLevel).height > TAIL_SIZE))
+         {
+            ++stream.m_tailLevel;
+         }
+         m_compressed = texture.IsCompressed();
+
+         // What its faces need isn't known yet, so as much as fits; it's all been decoded anyway
+         firstLevel = 0;
+         while (firstLevel < stream.m_tailLevel && m_residentBytes + LevelBytes(stream, firstLevel) > m_budgetBytes)
+            ++firstLevel;
+         stream.m_neededLevel = firstLevel;
+      }
+      else if (firstLevel >= stream.m_firstLevel)
+      {
+         continue;
+      }
+      else
+      {
+         m_residentBytes -= stream.m_pCurrent->SizeInBytes();
+      }
+
+      if (firstLevel == 0)
+         stream.m_pCurrent = std::move(load->result);
+      else
+         stream.m_pCurrent = TextureMap::MakeFromLevels(texture, firstLevel);
+      stream.m_firstLevel = firstLevel;
+      m_residentBytes += stream.m_pCurrent->SizeInBytes();
+   }
+
+   // Levels asked for by the frame just drawn; textures that nobody refers to anymore, other than this, go away
+   auto const unused = std::remove_if(m_streams.begin(), m_streams.end(), [this] (std::shared_ptr<StreamedTexture> const& pStream) {
+      if (pStream.use_count() > 1) return false;
+      if (pStream->m_pCurrent != m_pPlaceholder) m_residentBytes -= pStream->m_pCurrent->SizeInBytes();
+      m_paths.erase(pStream->m_path);
+      return true;
+   });
+   m_streams.erase(unused, m_streams.end());
+   for (auto & pStream : m_streams)
+   {
+      StreamedTexture & stream = *pStream;
+      int const wanted = stream.m_wantedLevel.exchange(StreamedTexture::NOT_WANTED, std::memory_order_relaxed);
+      if (wanted != StreamedTexture::NOT_WANTED)
+      {
+         stream.m_lastUsedFrame = m_frame;
+         if (wanted != StreamedTexture::UNKNOWN_LEVEL)
+            stream.m_neededLevel = std::min(uint(wanted), stream.m_tailLevel);
+      }
+      else if (m_frame - stream.m_lastUsedFrame > UNUSED_FRAMES)
+      {
+         stream.m_neededLevel = stream.m_tailLevel;
+      }
+   }
+
+   // Over budget: drop the levels that aren't needed, from the textures drawn the longest ago
+   if (m_residentBytes > m_budgetBytes)
+   {
+      m_trimmable.clear();
+      for (auto & pStream : m_streams)
+      {
+         if (pStream->m_loaded && pStream->m_firstLevel < pStream->m_neededLevel)
+            m_trimmable.push_back(pStream.get());
+      }
+      std::sort(m_trimmable.begin(), m_trimmable.end(), [] (StreamedTexture const* a, StreamedTexture const* b) {
+         return a->m_lastUsedFrame < b->m_lastUsedFrame;
+      });
+      for (size_t i = 0; i < m_trimmable.size() && m_residentBytes > m_budgetBytes; ++i)
+         Trim(*m_trimmable[i], m_trimmable[i]->m_neededLevel);
+   }
+
+   // Queue loads: placeholders first, then the textures that lack the most levels, i.e. are the largest on screen
+   // for what they have, then the most recently drawn
+   m_candidates.clear();
+   for (auto & pStream : m_streams)
+   {
+      StreamedTexture const& stream = *pStream;
+      if (!stream.m_loading && !stream.m_failed && (!stream.m_loaded || stream.m_neededLevel < stream.m_firstLevel))
+         m_candidates.push_back(&pStream);
+   }
+   if (m_candidates.empty()) return;
+
+   auto const missingLevels = [] (StreamedTexture const& stream) {
+      return stream.m_loaded ? stream.m_firstLevel - stream.m_neededLevel : ~0u;
+   };
+   std::sort(m_candidates.begin(), m_candidates.end(), [&] (std::shared_ptr<StreamedTexture> const* a, std::shared_ptr<StreamedTexture> const* b) {
+      if (missingLevels(**a) != missingLevels(**b)) return missingLevels(**a) > missingLevels(**b);
+      return (*a)->m_lastUsedFrame > (*b)->m_lastUsedFrame;
+   });
+
+   for (std::shared_ptr<StreamedTexture> const* pCandidate : m_candidates)
+   {
+      StreamedTexture* stream = pCandidate->get();
+      if (m_pendingLoads.size() >= MAX_PENDING_LOADS) break;
+
+      // Only what fits, once loaded; placeholders always do, as they then keep no more than fits
+      if (stream->m_loaded && m_residentBytes - stream->m_pCurrent->SizeInBytes() + LevelBytes(*stream, stream->m_neededLevel) > m_budgetBytes)
+         continue;
+
+      stream->m_loading = true;
+      auto load = std::make_shared<Load>();
+      load->stream = *pCandidate;
+      load->firstLevel = stream->m_neededLevel;
+      m_pendingLoads.push_back(load);
+
+      std::shared_ptr<ITextureLoader> pLoader = m_pLoader;
+      JobSystem::Instance().RunInBackground([load, pLoader] {
+         load->result = pLoader->LoadFromFile(load->stream->m_path);
+         load->done.store(true, std::memory_order_release);
+      });
+   }
+}
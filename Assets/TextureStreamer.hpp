@@ -0,0 +1,93 @@
+#ifndef TextureStreamer_hpp
+#define TextureStreamer_hpp
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ITextureLoader.hpp"
+#include "StreamedTexture.hpp"
+
+/**
+ * Loads textures in the background, so that scenes can be drawn right away, and keeps their resident mip levels
+ * within a memory budget.
+ *
+ * Every texture starts out as a placeholder, and is loaded once, in full, which is as little as image files allow;
+ * then only its finest levels come and go. Each frame, the render stage tells every texture it draws which level
+ * its faces need (cf. StreamedTexture::Request), i.e. the larger on screen, the finer. Between frames, Update():
+ *    - swaps in textures that finished loading, keeping the levels that were asked for,
+ *    - drops levels finer than needed, least recently drawn textures first, for as long as over budget,
+ *    - queues loads of the textures that lack the most levels, for as long as they fit.
+ * Levels from TAIL_SIZE down are never dropped, so that every texture drawn once always has something to show.
+ *
+ * Loads run as background tasks of the job system (cf. JobSystem::RunInBackground), which only ever takes up some
+ * of its workers, so that frames' jobs aren't held up by loads waiting on the disk.
+ */
+class TextureStreamer
+{
+public:
+   static constexpr uint TAIL_SIZE = 32; // along either axis
+   static constexpr uint MAX_PENDING_LOADS = 2; // queued at once, so that priorities are revised every few loads
+   static constexpr uint64_t UNUSED_FRAMES = 60; // after which a texture that wasn't drawn only needs its tail
+
+   /**
+    * The loader is shared with the loads, which may outlive the streamer
+    */
+   TextureStreamer (std::shared_ptr<ITextureLoader> pLoader, size_t const budgetBytes);
+
+   TextureStreamer (TextureStreamer const&) = delete;
+   TextureStreamer & operator= (TextureStreamer const&) = delete;
+
+   /**
+    * The texture of the given file, shared by everyone who asks for it; it's a placeholder until loaded
+    */
+   std::shared_ptr<StreamedTexture const> Get (std::string const& path);
+
+   /**
+    * Must be called between frames, when nothing is being drawn, on the thread that calls Get()
+    */
+   void Update ();
+
+   size_t ResidentBytes () const { return m_residentBytes; }
+   size_t BudgetBytes () const { return m_budgetBytes; }
+
+private:
+   struct Load
+   {
+      std::shared_ptr<StreamedTexture> stream;
+      uint firstLevel; // to keep, if already loaded once
+
+      // Filled in by the background task, and only read by Update() once it's done
+      std::unique_ptr<TextureMap> result; // nullptr if the file couldn't be loaded
+      std::atomic<bool> done{false};
+   };
+
+   /**
+    * Makes the texture start at the given level, if it's resident; levels are only ever dropped by this
+    */
+   void Trim (StreamedTexture & stream, uint const firstLevel);
+
+   /**
+    * Bytes of the full texture's levels from the given one down
+    */
+   size_t LevelBytes (StreamedTexture const& stream, uint const firstLevel) const;
+
+   std::shared_ptr<ITextureLoader> m_pLoader;
+   std::shared_ptr<TextureMap const> m_pPlaceholder;
+   size_t m_budgetBytes;
+   size_t m_residentBytes = 0;
+   bool m_compressed = false; // as far as the loads so far tell
+   uint64_t m_frame = 0;
+
+   std::unordered_map<std::string, std::weak_ptr<StreamedTexture>> m_paths;
+   std::vector<std::shared_ptr<StreamedTexture>> m_streams; // kept for as long as something else refers to them
+   std::vector<std::shared_ptr<Load>> m_pendingLoads; // each shared with its background task
+
+   // Scratch space of Update(), kept from one frame to the next, so that it doesn't allocate
+   std::vector<StreamedTexture*> m_trimmable;
+   std::vector<std::shared_ptr<StreamedTexture> const*> m_candidates;
+};
+
+#endif
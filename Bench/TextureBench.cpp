@@ -0,0 +1,216 @@
+/**
+ * Microbenchmark of texture sampling with texels in row-major order against the 4x4 tiles TextureMap stores them in.
+ * Samples the whole texture at 1:1 scale, rotated by several angles: at 0 degrees spans walk along rows, which is
+ * row-major order's best case, while at 90 degrees every texel of a span is on a different row.
+ * Also checks that both layouts give the same colours, since a fast wrong answer is worth nothing.
+ * Then does the same with the texture compressed, which is lossy, so the loss is reported instead, after checking that
+ * tiles of two colours that 5:6:5 holds exactly come back unchanged.
+ *
+ * Usage: texture_bench [texture] [passes]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "SDL.h"
+#include "Constants.hpp"
+#include "Kernels.hpp"
+#include "SDLTextureLoader.hpp"
+#include "TextureCompression.hpp"
+
+namespace
+{
+   typedef std::chrono::steady_clock Clock;
+
+   uint32_t volatile g_sink; // keeps the optimizer from discarding results
+
+   /**
+    * u, v of every pixel of a square as large as the texture, rotated by the angle about the texture's centre;
+    * pixels out of the texture are clamped to its edges, as when sampling
+    */
+   void RotatedUVs (uint const width, uint const height, float const degrees, std::vector<float> & u, std::vector<float> & v)
+   {
+      float const radians = Constants::Deg2Rad(degrees);
+      float const c = std::cos(radians), s = std::sin(radians);
+      u.resize(size_t(width) * height);
+      v.resize(size_t(width) * height);
+      for (uint y = 0; y < height; ++y)
+      {
+         for (uint x = 0; x < width; ++x)
+         {
+            float const dx = x + 0.5f - 0.5f * width, dy = y + 0.5f - 0.5f * height;
+            u[size_t(y) * width + x] = 0.5f + (c * dx - s * dy) / width;
+            v[size_t(y) * width + x] = 0.5f + (s * dx + c * dy) / height;
+         }
+      }
+   }
+
+   /**
+    * Same as the scalar SampleTexture kernel, from row-major texels
+    */
+   void SampleRowMajor (Kernels::Texels const& t, float const* u, float const* v, size_t const count, uint32_t* colors)
+   {
+      float const xMax = float(t.width - 1), yMax = float(t.height - 1);
+      for (size_t i = 0; i < count; ++i)
+      {
+         float x = u[i] * t.width, y = (1.f - v[i]) * t.height;
+         x = x > 0.f ? x : 0.f; x = x < xMax ? x : xMax;
+         y = y > 0.f ? y : 0.f; y = y < yMax ? y : yMax;
+         colors[i] = t.pixels[uint32_t(y) * t.width + uint32_t(x)];
+      }
+   }
+
+   /**
+    * Encodes and decodes a tile checkered with the two colours, which must come back as they were, whichever way
+    * they differ, e.g. red against green, whose difference is orthogonal to the grey axis
+    */
+   bool CheckerRoundTrips (ColorRGB const a, ColorRGB const b)
+   {
+      ColorRGB tile[TextureCompression::TEXELS_PER_BLOCK], decoded[TextureCompression::TEXELS_PER_BLOCK];
+      for (uint i = 0; i < TextureCompression::TEXELS_PER_BLOCK; ++i)
+         tile[i] = ((i ^ (i >> 2)) & 1) ? b : a;
+      TextureCompression::Decode(TextureCompression::Encode(tile), decoded);
+      return std::equal(tile, tile + TextureCompression::TEXELS_PER_BLOCK, decoded);
+   }
+
+   /**
+    * Millions of texels sampled per second, a row of the texture at a time, as the rasterizer does a span at a time
+    */
+   template <typename Sample>
+   double MegatexelsPerSecond (uint const passes, uint const width, uint const height, std::vector<float> const& u,
+      std::vector<float> const& v, std::vector<uint32_t> & colors, Sample const& sample)
+   {
+      auto const start = Clock::now();
+      uint32_t sum = 0;
+      for (uint pass = 0; pass < passes; ++pass)
+      {
+         for (uint y = 0; y < height; ++y)
+         {
+            size_t const row = size_t(y) * width;
+            sample(&u[row], &v[row], width, &colors[row]);
+         }
+         sum += colors[pass % colors.size()];
+      }
+      auto const elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+      g_sink = sum;
+      return double(passes) * width * height / elapsed / 1e6;
+   }
+}
+
+int main (int argc, char* argv[])
+{
+   std::string const fileName = argc > 1 ? argv[1] : "models/diablo_pose_diffuse.tga";
+   uint const passes = argc > 2 ? std::atoi(argv[2]) : 20;
+
+   SDLTextureLoader loader;
+   std::unique_ptr<TextureMap> const pTexture = loader.LoadFromFile(fileName);
+   if (!pTexture) return 1;
+
+   Kernels::Initialize(nullptr);
+
+   // Level 0 only, in both layouts; the tiled one straight from the texture
+   uint const width = pTexture->Mip(0).width, height = pTexture->Mip(0).height;
+   std::vector<uint32_t> rowMajor(size_t(width) * height);
+   for (uint y = 0; y < height; ++y)
+   {
+      for (uint x = 0; x < width; ++x)
+         rowMajor[size_t(y) * width + x] = pTexture->MipPixels(0)[TextureMap::TexelIndex(x, y, width)];
+   }
+   Kernels::Texels const rowMajorTexels = {rowMajor.data(), width, height};
+   Kernels::Texels const tiledTexels = {pTexture->MipPixels(0), width, height};
+
+   Kernels::Table const& scalar = *Kernels::ScalarTable();
+   Kernels::Table const& active = Kernels::Active();
+
+   std::cout << width << "x" << height << " texels, " << passes << " passes; Mtexels/s" << std::endl;
+   std::cout << "Angle    row-major      tiled   speedup   tiled (" << Kernels::Name(active.level) << ")  mismatches" << std::endl;
+
+   std::vector<float> u, v;
+   std::vector<uint32_t> expected(size_t(width) * height), colors(size_t(width) * height);
+   for (float const degrees : {0.f, 30.f, 45.f, 60.f, 90.f})
+   {
+      RotatedUVs(width, height, degrees, u, v);
+
+      double const rowMajorRate = MegatexelsPerSecond(passes, width, height, u, v, expected,
+         [&](float const* us, float const* vs, size_t n, uint32_t* out) { SampleRowMajor(rowMajorTexels, us, vs, n, out); });
+      double const tiledRate = MegatexelsPerSecond(passes, width, height, u, v, colors,
+         [&](float const* us, float const* vs, size_t n, uint32_t* out) { scalar.SampleTexture(tiledTexels, us, vs, n, out); });
+      size_t mismatches = 0;
+      for (size_t i = 0; i < colors.size(); ++i)
+         mismatches += colors[i] != expected[i];
+
+      double const activeRate = MegatexelsPerSecond(passes, width, height, u, v, colors,
+         [&](float const* us, float const* vs, size_t n, uint32_t* out) { active.SampleTexture(tiledTexels, us, vs, n, out); });
+      for (size_t i = 0; i < colors.size(); ++i)
+         mismatches += colors[i] != expected[i];
+
+      std::cout << std::setw(5) << int(degrees) << std::fixed << std::setprecision(1)
+                << std::setw(13) << rowMajorRate << std::setw(11) << tiledRate
+                << std::setw(9) << std::setprecision(2) << tiledRate / rowMajorRate << "x"
+                << std::setw(18) << std::setprecision(1) << activeRate << std::setw(12) << mismatches << std::endl;
+   }
+
+   // Compressed: tiles of primaries first, then the same level, sampled through a block cache, against its
+   // uncompressed texels
+   ColorRGB const primaries[] = {0xff0000ff, 0x00ff00ff, 0x0000ffff, 0x000000ff, 0xffffffff};
+   uint checkers = 0, roundTrips = 0;
+   for (uint i = 0; i < 5; ++i)
+   {
+      for (uint j = i + 1; j < 5; ++j)
+      {
+         ++checkers;
+         if (CheckerRoundTrips(primaries[i], primaries[j]))
+            ++roundTrips;
+         else
+            std::cout << "Checker of " << std::hex << primaries[i] << " and " << primaries[j] << std::dec << " doesn't round-trip" << std::endl;
+      }
+   }
+   std::cout << std::endl << "Compressed checkers: " << roundTrips << " of " << checkers << " round-trip" << std::endl;
+   if (roundTrips != checkers) return 1;
+
+   std::unique_ptr<TextureMap> const pCompressed = SDLTextureLoader(true).LoadFromFile(fileName);
+   if (!pCompressed) return 1;
+   Kernels::Texels compressedTexels = {nullptr, width, height};
+   compressedTexels.blocks = pCompressed->MipBlocks(0);
+
+   double squaredError = 0.;
+   for (uint y = 0; y < height; ++y)
+   {
+      for (uint x = 0; x < width; ++x)
+      {
+         size_t const index = TextureMap::TexelIndex(x, y, width);
+         ColorRGB const a = pTexture->MipPixels(0)[index];
+         ColorRGB const b = TextureCompression::DecodeTexel(compressedTexels.blocks[index / 16], uint(index % 16));
+         for (uint shift = 8; shift < 32; shift += 8)
+         {
+            double const difference = double((a >> shift) & 0xff) - double((b >> shift) & 0xff);
+            squaredError += difference * difference;
+         }
+      }
+   }
+   double const meanSquaredError = squaredError / (3. * width * height);
+   std::cout << std::endl << "Compressed: " << pCompressed->m_blocks.size() * sizeof(TextureCompression::Block) << " bytes instead of "
+             << pTexture->m_pixels.size() * sizeof(ColorRGB) << ", PSNR " << std::setprecision(1)
+             << 10. * std::log10(255. * 255. / std::max(meanSquaredError, 1e-9)) << " dB" << std::endl;
+   std::cout << "Angle        tiled   compressed   slowdown" << std::endl;
+
+   Kernels::BlockCache cache;
+   for (float const degrees : {0.f, 30.f, 45.f, 60.f, 90.f})
+   {
+      RotatedUVs(width, height, degrees, u, v);
+      double const tiledRate = MegatexelsPerSecond(passes, width, height, u, v, colors,
+         [&](float const* us, float const* vs, size_t n, uint32_t* out) { scalar.SampleTexture(tiledTexels, us, vs, n, out); });
+      double const compressedRate = MegatexelsPerSecond(passes, width, height, u, v, colors,
+         [&](float const* us, float const* vs, size_t n, uint32_t* out) { scalar.SampleBlocks(compressedTexels, cache, us, vs, n, out); });
+      std::cout << std::setw(5) << int(degrees) << std::setprecision(1) << std::setw(13) << tiledRate
+                << std::setw(13) << compressedRate << std::setw(10) << std::setprecision(2) << tiledRate / compressedRate << "x" << std::endl;
+   }
+
+   return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef AssetHandle_hpp
+#define AssetHandle_hpp
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+/**
+ * Asset being loaded in the background; cf. AssetRegistry::LoadMeshAsync and LoadTextureAsync. Get() is nullptr
+ * until the registry swaps the loaded asset in, which it only ever does between frames, so that the asset never
+ * appears while a frame is being drawn. Until then, whoever uses it either skips it or makes do without it.
+ */
+template <typename Asset>
+class AssetHandle
+{
+public:
+   explicit AssetHandle (std::string path) : m_path(std::move(path)) {}
+
+   std::string const& Path () const { return m_path; }
+
+   std::shared_ptr<Asset const> const& Get () const { return m_pAsset; }
+
+   /**
+    * Whether the asset may still show up; once false, Get() stays nullptr if it couldn't be loaded
+    */
+   bool IsLoading () const { return m_loading; }
+
+private:
+   friend class AssetRegistry;
+
+   std::string m_path;
+   std::shared_ptr<Asset const> m_pAsset;
+   bool m_loading = true;
+
+   // Filled in by the background task, and only read by the registry once it's done
+   std::shared_ptr<Asset const> m_pLoaded;
+   std::atomic<bool> m_done{false};
+};
+
+#endif
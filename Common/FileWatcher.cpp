@@ -0,0 +1,107 @@
+#include "FileWatcher.hpp"
+
+#include <filesystem>
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher (std::string const& path)
+   : m_path(path)
+{
+   std::error_code error;
+   fs::path const target = fs::canonical(path, error);
+   if (error)
+   {
+      std::cerr << "Could not watch " << path << ": " << error.message() << std::endl;
+      return;
+   }
+   m_name = target.filename().string();
+
+   m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+   if (m_inotify < 0)
+   {
+      std::cerr << "Could not watch " << path << ": " << std::strerror(errno) << std::endl;
+      return;
+   }
+
+   // Written in place, or replaced by a file moved over it
+   if (inotify_add_watch(m_inotify, target.parent_path().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+   {
+      std::cerr << "Could not watch " << path << ": " << std::strerror(errno) << std::endl;
+      return;
+   }
+   m_watching = true;
+}
+
+FileWatcher::~FileWatcher ()
+{
+   if (m_inotify >= 0)
+      close(m_inotify);
+}
+
+bool FileWatcher::Changed ()
+{
+   if (!m_watching) return false;
+
+   // Every pending event is read, so that a burst of writes only counts once
+   bool changed = false;
+   alignas(inotify_event) char buffer[4096];
+   while (true)
+   {
+      ssize_t const length = read(m_inotify, buffer, sizeof(buffer));
+      if (length <= 0) break;
+
+      for (ssize_t offset = 0; offset < length;)
+      {
+         auto const* event = reinterpret_cast<inotify_event const*>(buffer + offset);
+         if (event->len > 0 && m_name == event->name)
+            changed = true;
+         offset += sizeof(inotify_event) + event->len;
+      }
+   }
+   return changed;
+}
+
+#else
+
+static long long LastWriteTime (std::string const& path)
+{
+   std::error_code error;
+   auto const time = fs::last_write_time(path, error);
+   return error ? 0 : (long long)time.time_since_epoch().count();
+}
+
+FileWatcher::FileWatcher (std::string const& path)
+   : m_path(path)
+   , m_lastWriteTime(LastWriteTime(path))
+{
+   m_watching = m_lastWriteTime != 0;
+   if (!m_watching)
+      std::cerr << "Could not watch " << path << std::endl;
+}
+
+FileWatcher::~FileWatcher ()
+{}
+
+bool FileWatcher::Changed ()
+{
+   if (!m_watching) return false;
+
+   // A file being replaced is briefly missing, which isn't a change yet
+   long long const time = LastWriteTime(m_path);
+   if (time == 0 || time == m_lastWriteTime) return false;
+
+   m_lastWriteTime = time;
+   return true;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef FileWatcher_hpp
+#define FileWatcher_hpp
+
+#include <string>
+
+/**
+ * Tells whether a file has been written to, without blocking, e.g. once per frame. On Linux, the file's directory is
+ * watched with inotify, so that editors that save by renaming a new file over the old one are seen too; symlinks,
+ * e.g. the scripts in the build directory, are followed to the file they point to. Elsewhere, the file's
+ * modification time is polled instead.
+ */
+class FileWatcher
+{
+public:
+   explicit FileWatcher (std::string const& path);
+   ~FileWatcher ();
+
+   FileWatcher (FileWatcher const&) = delete;
+   FileWatcher & operator= (FileWatcher const&) = delete;
+
+   /**
+    * Whether the file changed since the last call, or since the watcher was made. However many times it was written
+    * to in between, this is only true once.
+    */
+   bool Changed ();
+
+   /**
+    * Whether changes can be seen at all, i.e. the file, or its directory, could be found
+    */
+   bool Watching () const { return m_watching; }
+
+private:
+   std::string m_path;
+   bool m_watching = false;
+
+#ifdef __linux__
+   std::string m_name; // of the file within the watched directory
+   int m_inotify = -1;
+#else
+   long long m_lastWriteTime = 0;
+#endif
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "FrameArena.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include "JobSystem.hpp"
+
+FrameArena::FrameArena (size_t const blockSize)
+   : m_blockSize(blockSize)
+{
+   AddBlock(blockSize);
+}
+
+void FrameArena::AddBlock (size_t const minimumSize)
+{
+   // Blocks double in size, so that a frame much larger than the previous ones needs few of them
+   size_t const size = std::max(minimumSize, std::max(m_blockSize, m_capacity));
+   m_blocks.push_back({std::unique_ptr<unsigned char[]>(new unsigned char[size]), size});
+   m_capacity += size;
+   m_offset = 0;
+}
+
+void* FrameArena::Allocate (size_t const size, size_t const alignment)
+{
+   assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+   Block* block = &m_blocks.back();
+   uintptr_t const base = reinterpret_cast<uintptr_t>(block->memory.get());
+   size_t start = ((base + m_offset + alignment - 1) & ~uintptr_t(alignment - 1)) - base;
+   if (start + size > block->size)
+   {
+      // Worst-case padding included, as the new block's alignment isn't known yet
+      AddBlock(size + alignment);
+      block = &m_blocks.back();
+      uintptr_t const newBase = reinterpret_cast<uintptr_t>(block->memory.get());
+      start = ((newBase + alignment - 1) & ~uintptr_t(alignment - 1)) - newBase;
+   }
+
+   m_used += start - m_offset + size;
+   m_offset = start + size;
+   return block->memory.get() + start;
+}
+
+void FrameArena::Reset ()
+{
+   if (m_blocks.size() > 1)
+   {
+      size_t const capacity = m_capacity;
+      m_blocks.clear();
+      m_capacity = 0;
+      AddBlock(capacity);
+   }
+   m_offset = 0;
+   m_used = 0;
+}
+
+FrameArenas::FrameArenas ()
+{
+   uint const workers = JobSystem::Instance().WorkerCount();
+   for (uint i = 0; i < workers; ++i)
+      m_arenas.push_back(std::make_unique<FrameArena>());
+}
+
+FrameArena & FrameArenas::Local ()
+{
+   uint const worker = JobSystem::ThisWorker();
+   if (worker == JobSystem::NOT_A_WORKER)
+   {
+      // Before the job system is initialized, the main thread is the only one around
+      assert(m_arenas.size() == 1);
+      return *m_arenas[0];
+   }
+
+   assert(worker < m_arenas.size() && "Arenas must be created once the job system is initialized");
+   return *m_arenas[worker];
+}
+
+void FrameArenas::Reset ()
+{
+   for (auto & arena : m_arenas)
+      arena->Reset();
+}
+
+size_t FrameArenas::Used () const
+{
+   size_t used = 0;
+   for (auto const& arena : m_arenas)
+      used += arena->Used();
+   return used;
+}
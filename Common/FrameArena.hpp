@@ -0,0 +1,117 @@
+#ifndef FrameArena_hpp
+#define FrameArena_hpp
+
+#include "global.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Bump allocator for data that doesn't outlive a frame. Allocating merely moves a pointer forward; nothing is freed
+ * on its own, but everything at once by Reset(), which must only be called once nothing refers to the memory anymore.
+ *
+ * Memory comes in blocks, which are kept from one frame to the next. Whenever a frame needed more than one block,
+ * Reset() replaces them with a single one as large as all of them, so that once the largest frame has been seen,
+ * frames don't touch the heap at all.
+ *
+ * Not thread-safe: every thread allocates from its own arena; cf. FrameArenas.
+ */
+class FrameArena
+{
+public:
+   explicit FrameArena (size_t const blockSize=64 * 1024);
+
+   FrameArena (FrameArena const&) = delete;
+   FrameArena & operator= (FrameArena const&) = delete;
+
+   void* Allocate (size_t const size, size_t const alignment);
+
+   template <typename T>
+   T* Allocate (size_t const count) { return static_cast<T*>(Allocate(count * sizeof(T), alignof(T))); }
+
+   void Reset ();
+
+   /**
+    * Bytes handed out since the last reset, including alignment padding
+    */
+   size_t Used () const { return m_used; }
+   size_t Capacity () const { return m_capacity; }
+
+private:
+   struct Block
+   {
+      std::unique_ptr<unsigned char[]> memory;
+      size_t size;
+   };
+
+   void AddBlock (size_t const minimumSize);
+
+   std::vector<Block> m_blocks; // the last one is being allocated from
+   size_t m_offset = 0; // into the last block
+   size_t m_used = 0;
+   size_t m_capacity = 0;
+   size_t m_blockSize;
+};
+
+/**
+ * One arena per job system worker, so that jobs can allocate without synchronizing; each one allocates from the
+ * arena of the worker running it. Must be created once the job system is initialized, and reset once all of the
+ * jobs that allocated from it are finished.
+ */
+class FrameArenas
+{
+public:
+   FrameArenas ();
+
+   /**
+    * The calling worker's arena
+    */
+   FrameArena & Local ();
+
+   void Reset ();
+
+   size_t Used () const;
+
+private:
+   std::vector<std::unique_ptr<FrameArena>> m_arenas; // not stored by value, so that workers don't share cache lines
+};
+
+/**
+ * Standard allocator handing out memory from an arena, for standard containers to use; deallocating does nothing.
+ * Containers are bound to their arena for life: moving one moves its arena along, but copies and swaps between
+ * containers of different arenas aren't supported.
+ */
+template <typename T>
+class ArenaAllocator
+{
+public:
+   typedef T value_type;
+   typedef std::true_type propagate_on_container_move_assignment;
+
+   ArenaAllocator (FrameArena & arena) : m_pArena(&arena) {}
+
+   template <typename U>
+   ArenaAllocator (ArenaAllocator<U> const& other) : m_pArena(other.Arena()) {}
+
+   T* allocate (size_t const n) { return m_pArena->Allocate<T>(n); }
+   void deallocate (T*, size_t) {}
+
+   FrameArena* Arena () const { return m_pArena; }
+
+private:
+   FrameArena* m_pArena;
+};
+
+template <typename T, typename U>
+bool operator== (ArenaAllocator<T> const& a, ArenaAllocator<U> const& b) { return a.Arena() == b.Arena(); }
+
+template <typename T, typename U>
+bool operator!= (ArenaAllocator<T> const& a, ArenaAllocator<U> const& b) { return a.Arena() != b.Arena(); }
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif
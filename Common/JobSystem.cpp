@@ -0,0 +1,366 @@
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "Logger.hpp"
+
+static_assert((JobSystem::POOL_SIZE & (JobSystem::POOL_SIZE - 1)) == 0, "Rings are indexed by masking");
+
+namespace
+{
+   thread_local uint t_worker = JobSystem::NOT_A_WORKER;
+}
+
+/**
+ * Fixed-capacity Chase-Lev deque (cf. Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models").
+ * Only its owner pushes and pops, at the bottom; anyone may steal from the top.
+ */
+class JobDeque
+{
+public:
+   static constexpr int64_t CAPACITY = JobSystem::POOL_SIZE;
+
+   /**
+    * Fails when full, in which case the caller should run the job itself
+    */
+   bool Push (JobSystem::Job* job)
+   {
+      int64_t const b = m_bottom.load(std::memory_order_relaxed);
+      int64_t const t = m_top.load(std::memory_order_acquire);
+      if (b - t >= CAPACITY) return false;
+
+      m_jobs[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+      m_bottom.store(b + 1, std::memory_order_release);
+      return true;
+   }
+
+   JobSystem::Job* Pop ()
+   {
+      int64_t const b = m_bottom.load(std::memory_order_relaxed) - 1;
+      m_bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t t = m_top.load(std::memory_order_relaxed);
+
+      if (t > b)
+      {
+         // Empty
+         m_bottom.store(b + 1, std::memory_order_relaxed);
+         return nullptr;
+      }
+
+      JobSystem::Job* job = m_jobs[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+      if (t == b)
+      {
+         // Last one left, which a thief may be taking at the same time
+         if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+         m_bottom.store(b + 1, std::memory_order_relaxed);
+      }
+      return job;
+   }
+
+   JobSystem::Job* Steal ()
+   {
+      int64_t t = m_top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t const b = m_bottom.load(std::memory_order_acquire);
+      if (t >= b) return nullptr;
+
+      JobSystem::Job* job = m_jobs[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+      if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+         return nullptr; // lost the race to the owner or another thief
+      return job;
+   }
+
+   bool Empty () const
+   {
+      return m_top.load() >= m_bottom.load();
+   }
+
+private:
+   alignas(64) std::atomic<int64_t> m_top{0};
+   alignas(64) std::atomic<int64_t> m_bottom{0};
+   std::atomic<JobSystem::Job*> m_jobs[CAPACITY] = {};
+};
+
+struct JobSystem::Worker
+{
+   JobDeque deque;
+   std::unique_ptr<Job[]> pool{new Job[POOL_SIZE]()};
+   uint allocated = 0;
+   uint victim = 0; // where the next steal attempt starts
+};
+
+JobSystem & JobSystem::Instance ()
+{
+   static JobSystem instance;
+   return instance;
+}
+
+JobSystem::JobSystem ()
+{
+}
+
+JobSystem::~JobSystem ()
+{
+   Shutdown();
+}
+
+void JobSystem::Initialize (int backgroundWorkers)
+{
+   assert(m_workers.empty());
+
+   if (backgroundWorkers < 0)
+      backgroundWorkers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+   uint const workers = uint(backgroundWorkers) + 1;
+   for (uint i = 0; i < workers; ++i)
+      m_workers.push_back(std::make_unique<Worker>());
+
+   t_worker = 0;
+   m_stopping = false;
+   for (uint i = 1; i < workers; ++i)
+      m_threads.emplace_back(&JobSystem::WorkerMain, this, i);
+
+   trclog("Job system running on " << workers << " threads");
+}
+
+void JobSystem::Shutdown ()
+{
+   if (m_workers.empty()) return;
+
+   {
+      std::lock_guard<std::mutex> lock(m_sleepMutex);
+      m_stopping = true;
+   }
+   m_wake.notify_all();
+
+   for (auto & thread : m_threads)
+      thread.join();
+   m_threads.clear();
+   m_workers.clear();
+   t_worker = NOT_A_WORKER;
+
+   std::lock_guard<std::mutex> lock(m_backgroundMutex);
+   m_backgroundTasks.clear();
+   m_queuedBackgroundTasks = 0;
+}
+
+uint JobSystem::ThisWorker ()
+{
+   return t_worker;
+}
+
+JobSystem::Job* JobSystem::Allocate (Job* parent)
+{
+   assert(t_worker != NOT_A_WORKER && "Jobs can only be created from worker threads");
+
+   Worker & worker = *m_workers[t_worker];
+   Job* job = &worker.pool[worker.allocated++ & (POOL_SIZE - 1)];
+   assert(job->unfinished.load(std::memory_order_relaxed) == 0 && "Too many jobs in flight; raise POOL_SIZE");
+
+   // A slot still in flight must not be overwritten: try the next ones, and once a whole round of them is busy, help
+   // with other jobs until some finish
+   for (uint busy = 1; job->unfinished.load(std::memory_order_acquire) != 0; ++busy)
+   {
+      if (busy >= POOL_SIZE)
+      {
+         if (Job* next = Take())
+            Execute(next);
+         else
+            std::this_thread::yield();
+      }
+      job = &worker.pool[worker.allocated++ & (POOL_SIZE - 1)];
+   }
+
+   job->parent = parent;
+   job->continuationCount = 0;
+#ifdef TRACK_MEMORY
+   job->memoryTag = MemoryTracker::CurrentTag();
+#endif
+   job->unfinished.store(1, std::memory_order_relaxed);
+   if (parent)
+      parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+   return job;
+}
+
+void JobSystem::AddContinuation (Job* job, Job* continuation)
+{
+   assert(job->continuationCount < Job::MAX_CONTINUATIONS);
+   job->continuations[job->continuationCount++] = continuation;
+}
+
+void JobSystem::Run (Job* job)
+{
+   assert(t_worker != NOT_A_WORKER && "Jobs can only be run from worker threads");
+
+   if (!m_workers[t_worker]->deque.Push(job))
+   {
+      Execute(job);
+      return;
+   }
+
+   // Pairs with the sleeping count being raised before the final look for work in WorkerMain
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   if (m_sleeping.load() > 0)
+   {
+      { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+      m_wake.notify_one();
+   }
+}
+
+void JobSystem::Execute (Job* job)
+{
+#ifdef TRACK_MEMORY
+   MemoryScope memoryScope(job->memoryTag);
+#endif
+   job->function(job->payload);
+   Finish(job);
+}
+
+void JobSystem::Finish (Job* job)
+{
+   // Once finished, the job's slot may be reused at any time, so everything needed afterwards is read first
+   Job* const parent = job->parent;
+   uint const continuationCount = job->continuationCount;
+   Job* continuations[Job::MAX_CONTINUATIONS];
+   for (uint i = 0; i < continuationCount; ++i)
+      continuations[i] = job->continuations[i];
+
+   if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+   for (uint i = 0; i < continuationCount; ++i)
+      Run(continuations[i]);
+
+   if (parent)
+      Finish(parent);
+}
+
+void JobSystem::Wait (Job const* job)
+{
+   while (!IsFinished(job))
+   {
+      if (Job* next = Take())
+         Execute(next);
+      else
+         std::this_thread::yield();
+   }
+}
+
+void JobSystem::RunInBackground (std::function<void ()> task)
+{
+   if (m_threads.empty())
+   {
+      task();
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_backgroundMutex);
+      m_backgroundTasks.push_back(std::move(task));
+      m_queuedBackgroundTasks.fetch_add(1);
+   }
+
+   // Same as in Run(), but whoever wakes up may not be the one who takes it; any idle worker will do
+   if (m_sleeping.load() > 0)
+   {
+      { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+      m_wake.notify_all();
+   }
+}
+
+bool JobSystem::RunBackgroundTask ()
+{
+   if (m_queuedBackgroundTasks.load() == 0) return false;
+
+   // Raised up front, so that two workers can't both take the last free slot
+   if (m_runningBackgroundTasks.fetch_add(1) >= MaxBackgroundTasks())
+   {
+      m_runningBackgroundTasks.fetch_sub(1);
+      return false;
+   }
+
+   std::function<void ()> task;
+   {
+      std::lock_guard<std::mutex> lock(m_backgroundMutex);
+      if (!m_backgroundTasks.empty())
+      {
+         task = std::move(m_backgroundTasks.front());
+         m_backgroundTasks.pop_front();
+         m_queuedBackgroundTasks.fetch_sub(1);
+      }
+   }
+   if (task)
+      task();
+
+   m_runningBackgroundTasks.fetch_sub(1);
+   return bool(task);
+}
+
+JobSystem::Job* JobSystem::Take ()
+{
+   Worker & self = *m_workers[t_worker];
+   if (Job* job = self.deque.Pop())
+      return job;
+
+   uint const count = uint(m_workers.size());
+   for (uint i = 0; i < count; ++i)
+   {
+      uint const victim = (self.victim + i) % count;
+      if (victim == t_worker) continue;
+
+      if (Job* job = m_workers[victim]->deque.Steal())
+      {
+         self.victim = victim; // likely to have more
+         return job;
+      }
+   }
+   return nullptr;
+}
+
+bool JobSystem::AnyWork () const
+{
+   for (auto const& worker : m_workers)
+   {
+      if (!worker->deque.Empty()) return true;
+   }
+   return m_queuedBackgroundTasks.load() > 0 && m_runningBackgroundTasks.load() < MaxBackgroundTasks();
+}
+
+void JobSystem::WorkerMain (uint const index)
+{
+   t_worker = index;
+   m_workers[index]->victim = index + 1;
+
+   uint idle = 0;
+   while (!m_stopping.load(std::memory_order_relaxed))
+   {
+      if (Job* job = Take())
+      {
+         Execute(job);
+         idle = 0;
+         continue;
+      }
+
+      if (RunBackgroundTask())
+      {
+         idle = 0;
+         continue;
+      }
+
+      // Spin for a little while, as more work usually follows shortly within a frame, then sleep
+      if (++idle < 64)
+      {
+         std::this_thread::yield();
+         continue;
+      }
+
+      std::unique_lock<std::mutex> lock(m_sleepMutex);
+      m_sleeping.fetch_add(1);
+      if (!m_stopping && !AnyWork())
+         m_wake.wait(lock);
+      m_sleeping.fetch_sub(1);
+      idle = 0;
+   }
+}
@@ -0,0 +1,206 @@
+#ifndef JobSystem_hpp
+#define JobSystem_hpp
+
+#include "global.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "MemoryTracker.hpp"
+
+/**
+ * Work-stealing scheduler shared by the whole engine, so that no subsystem needs to spin up threads of its own.
+ *
+ * Every thread that runs jobs (the main thread, which is worker 0, and the background workers) owns a pool of jobs
+ * and a deque of jobs that are ready to run. A worker pushes and pops at the bottom of its own deque, while idle
+ * workers steal from the top of the others'. Pools and deques are fixed-size rings allocated by Initialize(), so
+ * creating and running jobs never allocates.
+ *
+ * A job finishes once it has run and all of its children have finished; its continuations are then run. Waiting
+ * for a job runs other jobs in the meantime, instead of blocking.
+ *
+ * Jobs can only be created and run from worker threads, once initialized. ParallelFor() works from anywhere, and
+ * simply runs inline when there is no one to share the work with.
+ *
+ * Background tasks are for work that runs far longer than a frame, e.g. loading assets. They're queued apart from
+ * jobs, and only taken by background workers that are out of jobs, no more than half of them at once, so that frames
+ * always have workers left, and the main thread never picks one up while waiting for a frame.
+ */
+class JobSystem
+{
+public:
+   struct alignas(64) Job
+   {
+      static constexpr uint MAX_CONTINUATIONS = 4;
+      static constexpr size_t PAYLOAD_SIZE = 64;
+
+      void (*function) (void const* payload);
+      Job* parent;
+      std::atomic<int> unfinished; // the job itself, plus its unfinished children
+      uint continuationCount;
+      Job* continuations[MAX_CONTINUATIONS];
+#ifdef TRACK_MEMORY
+      MemoryTracker::Tag memoryTag; // of the thread that created it
+#endif
+      alignas(alignof(std::max_align_t)) unsigned char payload[PAYLOAD_SIZE]; // the callable
+   };
+
+   /**
+    * Jobs each worker can have in flight. Slots are reused in turn, skipping those whose job hasn't finished yet; when
+    * none is free, the worker runs other jobs until one is.
+    */
+   static constexpr uint POOL_SIZE = 4096;
+
+   static JobSystem & Instance ();
+
+   /**
+    * Makes the calling thread worker 0 and starts the given number of background workers; if negative, one per
+    * hardware thread besides the calling one
+    */
+   void Initialize (int backgroundWorkers);
+
+   /**
+    * Stops and joins the background workers. Jobs still queued are dropped.
+    */
+   void Shutdown ();
+
+   /**
+    * Threads running jobs, including the main thread; 1 until initialized
+    */
+   uint WorkerCount () const { return m_workers.empty() ? 1 : uint(m_workers.size()); }
+
+   /**
+    * Index of the calling worker thread in [0, WorkerCount()), or NOT_A_WORKER
+    */
+   static constexpr uint NOT_A_WORKER = ~0u;
+   static uint ThisWorker ();
+
+   /**
+    * Job that calls the given callable, which is copied into the job. Callables must be small and trivially
+    * copyable, e.g. lambdas capturing a few pointers or references. The parent, if any, won't finish before it.
+    */
+   template <typename Function>
+   Job* Create (Function const& function, Job* parent=nullptr);
+
+   /**
+    * The continuation will be run once the job finishes. Must be called before the job is run.
+    */
+   void AddContinuation (Job* job, Job* continuation);
+
+   /**
+    * Queues the job on the calling worker
+    */
+   void Run (Job* job);
+
+   bool IsFinished (Job const* job) const { return job->unfinished.load(std::memory_order_acquire) == 0; }
+
+   /**
+    * Runs other jobs until the given one has finished
+    */
+   void Wait (Job const* job);
+
+   /**
+    * Calls function(begin, end) over subranges of [0, count), in parallel, and returns once all of them have
+    * returned. Ranges are at least `grain` long, except maybe the last one.
+    */
+   template <typename Function>
+   void ParallelFor (uint const count, uint const grain, Function const& function);
+
+   /**
+    * Queues a background task; cf. above. Works from anywhere, and runs the task inline when there are no background
+    * workers. Tasks still queued upon Shutdown() are dropped.
+    */
+   void RunInBackground (std::function<void ()> task);
+
+private:
+   struct Worker;
+
+   JobSystem ();
+   ~JobSystem ();
+
+   Job* Allocate (Job* parent);
+   void Execute (Job* job);
+   void Finish (Job* job);
+
+   /**
+    * A job from the calling worker's own deque, or else stolen from another; nullptr if there are none
+    */
+   Job* Take ();
+
+   /**
+    * Runs a background task, if there's any, and not too many are running already; returns whether it did
+    */
+   bool RunBackgroundTask ();
+   uint MaxBackgroundTasks () const { return std::max(1u, uint(m_threads.size()) / 2); }
+
+   bool AnyWork () const;
+   void WorkerMain (uint const index);
+
+   std::vector<std::unique_ptr<Worker>> m_workers;
+   std::vector<std::thread> m_threads;
+
+   // Idle background workers sleep until a job is queued
+   std::mutex m_sleepMutex;
+   std::condition_variable m_wake;
+   std::atomic<uint> m_sleeping{0};
+   std::atomic<bool> m_stopping{false};
+
+   std::mutex m_backgroundMutex;
+   std::deque<std::function<void ()>> m_backgroundTasks;
+   std::atomic<uint> m_queuedBackgroundTasks{0}; // so that looking for them needn't lock
+   std::atomic<uint> m_runningBackgroundTasks{0};
+};
+
+template <typename Function>
+JobSystem::Job* JobSystem::Create (Function const& function, Job* parent)
+{
+   static_assert(sizeof(Function) <= Job::PAYLOAD_SIZE, "Capture less, e.g. a pointer to the state instead of a copy");
+   static_assert(alignof(Function) <= alignof(std::max_align_t), "Over-aligned callables can't be stored in jobs");
+   static_assert(std::is_trivially_copyable<Function>::value && std::is_trivially_destructible<Function>::value,
+      "Jobs are reused without being destroyed, so their callables must be trivial to copy and destroy");
+
+   Job* job = Allocate(parent);
+   new (job->payload) Function(function);
+   job->function = [] (void const* payload) { (*static_cast<Function const*>(payload))(); };
+   return job;
+}
+
+template <typename Function>
+void JobSystem::ParallelFor (uint const count, uint const grain, Function const& function)
+{
+   if (count == 0) return;
+
+   uint const workers = WorkerCount();
+   if (count <= grain || workers == 1 || ThisWorker() == NOT_A_WORKER)
+   {
+      function(0u, count);
+      return;
+   }
+
+   // A few ranges per worker, so that those finishing early can steal the rest
+   uint ranges = (count + grain - 1) / grain;
+   if (ranges > 4 * workers) ranges = 4 * workers;
+
+   Job* root = Create([] {});
+   for (uint r = 0; r < ranges; ++r)
+   {
+      uint const begin = uint(uint64_t(count) * r / ranges);
+      uint const end = uint(uint64_t(count) * (r + 1) / ranges);
+      Function const* pFunction = &function;
+      Run(Create([pFunction, begin, end] { (*pFunction)(begin, end); }, root));
+   }
+   Run(root);
+   Wait(root);
+}
+
+#endif
@@ -0,0 +1,266 @@
+#include "MemoryTracker.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+namespace
+{
+   constexpr size_t TAG_COUNT = size_t(MemoryTracker::Tag::COUNT);
+
+   struct Counters
+   {
+      std::atomic<int64_t> liveBytes{0};
+      std::atomic<int64_t> peakBytes{0};
+      std::atomic<uint64_t> allocations{0};
+      uint64_t allocationsAtFrameStart = 0; // main thread only
+      uint64_t frameAllocations = 0;
+   };
+
+   // One per tag, then the total
+   Counters s_counters[TAG_COUNT + 1];
+
+   thread_local MemoryTracker::Tag t_tag = MemoryTracker::Tag::UNTAGGED;
+
+   /**
+    * In front of every allocation, when tracking
+    */
+   struct alignas(16) Header
+   {
+      uint64_t size;
+      uint32_t offset; // from the start of the block to the memory handed out
+      MemoryTracker::Tag tag;
+   };
+
+   void Account (Counters & counters, int64_t const bytes)
+   {
+      int64_t const live = counters.liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+      int64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+      while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+   }
+
+   void Account (MemoryTracker::Tag const tag, int64_t const bytes, bool const isNew)
+   {
+      Counters & counters = s_counters[size_t(tag)];
+      Counters & total = s_counters[TAG_COUNT];
+      if (isNew)
+      {
+         counters.allocations.fetch_add(1, std::memory_order_relaxed);
+         total.allocations.fetch_add(1, std::memory_order_relaxed);
+      }
+      if (MemoryTracker::TRACKING && bytes != 0)
+      {
+         Account(counters, bytes);
+         Account(total, bytes);
+      }
+   }
+
+   void* AllocateRaw (size_t const size, size_t const alignment)
+   {
+      if (alignment <= alignof(std::max_align_t))
+         return std::malloc(size);
+#ifdef _MSC_VER
+      return _aligned_malloc(size, alignment);
+#else
+      return std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+#endif
+   }
+
+   void FreeRaw (void* p, size_t const alignment)
+   {
+#ifdef _MSC_VER
+      if (alignment > alignof(std::max_align_t))
+      {
+         _aligned_free(p);
+         return;
+      }
+#else
+      (void)alignment;
+#endif
+      std::free(p);
+   }
+
+   void* Allocate (size_t size, size_t alignment)
+   {
+      if (size == 0) size = 1;
+      if (alignment < alignof(std::max_align_t)) alignment = alignof(std::max_align_t);
+
+      // The header goes right in front of the memory handed out, which stays aligned
+      size_t const prefix = MemoryTracker::TRACKING ? (alignment > sizeof(Header) ? alignment : sizeof(Header)) : 0;
+
+      while (true)
+      {
+         if (void* p = AllocateRaw(prefix + size, alignment))
+         {
+            MemoryTracker::Tag const tag = MemoryTracker::TRACKING ? t_tag : MemoryTracker::Tag::UNTAGGED;
+            if (MemoryTracker::TRACKING)
+            {
+               p = static_cast<char*>(p) + prefix;
+               static_cast<Header*>(p)[-1] = {size, uint32_t(prefix), tag};
+            }
+            Account(tag, int64_t(size), true);
+            return p;
+         }
+
+         // Same as the standard operator new: let the handler make room, if any, or give up
+         std::new_handler const handler = std::get_new_handler();
+         if (handler == nullptr) throw std::bad_alloc();
+         handler();
+      }
+   }
+
+   void Free (void* p, size_t const alignment)
+   {
+      if (p == nullptr) return;
+
+      if (MemoryTracker::TRACKING)
+      {
+         Header const& header = static_cast<Header*>(p)[-1];
+         Account(header.tag, -int64_t(header.size), false);
+         p = static_cast<char*>(p) - header.offset;
+      }
+      FreeRaw(p, alignment);
+   }
+}
+
+char const* MemoryTracker::TagName (Tag const tag)
+{
+   switch (tag)
+   {
+      case Tag::UNTAGGED: return "Untagged";
+      case Tag::MESHES: return "Meshes";
+      case Tag::TEXTURES: return "Textures";
+      case Tag::LUA: return "Lua";
+      case Tag::RENDERER: return "Renderer";
+      case Tag::COUNT: break;
+   }
+   return "?";
+}
+
+static MemoryTracker::Usage GetUsage (Counters const& counters)
+{
+   return {
+      counters.liveBytes.load(std::memory_order_relaxed),
+      counters.peakBytes.load(std::memory_order_relaxed),
+      counters.allocations.load(std::memory_order_relaxed),
+      counters.frameAllocations
+   };
+}
+
+MemoryTracker::Usage MemoryTracker::GetUsage (Tag const tag)
+{
+   return ::GetUsage(s_counters[size_t(tag)]);
+}
+
+MemoryTracker::Usage MemoryTracker::GetTotalUsage ()
+{
+   return ::GetUsage(s_counters[TAG_COUNT]);
+}
+
+uint64_t MemoryTracker::AllocationCount ()
+{
+   return s_counters[TAG_COUNT].allocations.load(std::memory_order_relaxed);
+}
+
+void MemoryTracker::EndFrame ()
+{
+   for (auto & counters : s_counters)
+   {
+      uint64_t const allocations = counters.allocations.load(std::memory_order_relaxed);
+      counters.frameAllocations = allocations - counters.allocationsAtFrameStart;
+      counters.allocationsAtFrameStart = allocations;
+   }
+}
+
+bool MemoryTracker::Dump (char const* filename)
+{
+   FILE* file = std::fopen(filename, "w");
+   if (file == nullptr) return false;
+
+   if (!TRACKING)
+      std::fprintf(file, "Built without TRACK_MEMORY: bytes aren't tracked, and allocations by operator new aren't tagged\n\n");
+
+   std::fprintf(file, "%-10s %14s %14s %14s %12s\n", "Tag", "Live bytes", "Peak bytes", "Allocations", "Last frame");
+   auto const dumpLine = [file] (char const* name, Usage const& usage) {
+      std::fprintf(file, "%-10s %14lld %14lld %14llu %12llu\n", name, (long long)usage.liveBytes, (long long)usage.peakBytes,
+         (unsigned long long)usage.allocations, (unsigned long long)usage.frameAllocations);
+   };
+   for (size_t t = 0; t < TAG_COUNT; ++t)
+   {
+      dumpLine(TagName(Tag(t)), GetUsage(Tag(t)));
+   }
+   dumpLine("Total", GetTotalUsage());
+
+   return std::fclose(file) == 0;
+}
+
+void* MemoryTracker::LuaAllocate (void*, void* p, size_t oldSize, size_t const newSize)
+{
+   // When allocating anew, Lua passes the type of the object instead of a size
+   if (p == nullptr) oldSize = 0;
+
+   if (newSize == 0)
+   {
+      std::free(p);
+      Account(Tag::LUA, -int64_t(oldSize), false);
+      return nullptr;
+   }
+
+   void* const q = std::realloc(p, newSize);
+   if (q != nullptr)
+      Account(Tag::LUA, int64_t(newSize) - int64_t(oldSize), p == nullptr);
+   return q;
+}
+
+MemoryTracker::Tag MemoryTracker::CurrentTag ()
+{
+   return t_tag;
+}
+
+void MemoryTracker::SetCurrentTag (Tag const tag)
+{
+   t_tag = tag;
+}
+
+void* operator new (size_t size) { return Allocate(size, 0); }
+void* operator new[] (size_t size) { return Allocate(size, 0); }
+void* operator new (size_t size, std::align_val_t alignment) { return Allocate(size, size_t(alignment)); }
+void* operator new[] (size_t size, std::align_val_t alignment) { return Allocate(size, size_t(alignment)); }
+
+void* operator new (size_t size, std::nothrow_t const&) noexcept
+{
+   try { return Allocate(size, 0); } catch (std::bad_alloc const&) { return nullptr; }
+}
+
+void* operator new[] (size_t size, std::nothrow_t const&) noexcept
+{
+   try { return Allocate(size, 0); } catch (std::bad_alloc const&) { return nullptr; }
+}
+
+void* operator new (size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept
+{
+   try { return Allocate(size, size_t(alignment)); } catch (std::bad_alloc const&) { return nullptr; }
+}
+
+void* operator new[] (size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept
+{
+   try { return Allocate(size, size_t(alignment)); } catch (std::bad_alloc const&) { return nullptr; }
+}
+
+void operator delete (void* p) noexcept { Free(p, 0); }
+void operator delete[] (void* p) noexcept { Free(p, 0); }
+void operator delete (void* p, size_t) noexcept { Free(p, 0); }
+void operator delete[] (void* p, size_t) noexcept { Free(p, 0); }
+void operator delete (void* p, std::nothrow_t const&) noexcept { Free(p, 0); }
+void operator delete[] (void* p, std::nothrow_t const&) noexcept { Free(p, 0); }
+void operator delete (void* p, std::align_val_t alignment) noexcept { Free(p, size_t(alignment)); }
+void operator delete[] (void* p, std::align_val_t alignment) noexcept { Free(p, size_t(alignment)); }
+void operator delete (void* p, size_t, std::align_val_t alignment) noexcept { Free(p, size_t(alignment)); }
+void operator delete[] (void* p, size_t, std::align_val_t alignment) noexcept { Free(p, size_t(alignment)); }
+void operator delete (void* p, std::align_val_t alignment, std::nothrow_t const&) noexcept { Free(p, size_t(alignment)); }
+void operator delete[] (void* p, std::align_val_t alignment, std::nothrow_t const&) noexcept { Free(p, size_t(alignment)); }
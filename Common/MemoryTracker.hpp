@@ -0,0 +1,97 @@
+#ifndef MemoryTracker_hpp
+#define MemoryTracker_hpp
+
+#include "global.hpp"
+
+#include <cstddef>
+
+/**
+ * Accounts for the heap, by replacing the global operator new and delete (cf. MemoryTracker.cpp), from any thread.
+ *
+ * Allocations are always counted. Building with TRACK_MEMORY also tracks bytes, per subsystem: every allocation
+ * then carries a small header with its size and the tag of the innermost MEMORY_SCOPE on the allocating thread,
+ * so that freeing it is accounted to the same tag, wherever that happens. Jobs inherit the tag of the thread that
+ * created them. Lua states, whose heap doesn't go through operator new, account for it via LuaAllocate().
+ *
+ * Libraries calling malloc() directly (e.g. SDL, for surfaces and textures) aren't seen either way.
+ */
+class MemoryTracker
+{
+public:
+   enum class Tag : uint8_t
+   {
+      UNTAGGED,
+      MESHES,
+      TEXTURES,
+      LUA,
+      RENDERER,
+      COUNT
+   };
+
+#ifdef TRACK_MEMORY
+   static constexpr bool TRACKING = true;
+#else
+   static constexpr bool TRACKING = false;
+#endif
+
+   struct Usage
+   {
+      int64_t liveBytes;
+      int64_t peakBytes;
+      uint64_t allocations; // since startup
+      uint64_t frameAllocations; // over the last frame
+   };
+
+   static char const* TagName (Tag const tag);
+
+   /**
+    * Bytes are only known when tracking; allocations per tag, too
+    */
+   static Usage GetUsage (Tag const tag);
+   static Usage GetTotalUsage ();
+
+   /**
+    * Allocations since startup, of every tag; known even when not tracking
+    */
+   static uint64_t AllocationCount ();
+
+   /**
+    * Ends the frame over which frameAllocations are counted. Main thread only.
+    */
+   static void EndFrame ();
+
+   /**
+    * Writes the usage of every tag to the given file, as a table. Returns whether it could be written.
+    */
+   static bool Dump (char const* filename);
+
+   /**
+    * Allocator for Lua states (cf. lua_Alloc), accounting for them under the LUA tag
+    */
+   static void* LuaAllocate (void* userData, void* p, size_t oldSize, size_t newSize);
+
+   static Tag CurrentTag ();
+   static void SetCurrentTag (Tag const tag);
+};
+
+/**
+ * Tags the allocations made by the calling thread until its destruction
+ */
+class MemoryScope
+{
+   MemoryTracker::Tag m_previous;
+
+public:
+   explicit MemoryScope (MemoryTracker::Tag const tag) : m_previous(MemoryTracker::CurrentTag()) { MemoryTracker::SetCurrentTag(tag); }
+   ~MemoryScope () { MemoryTracker::SetCurrentTag(m_previous); }
+};
+
+#ifdef TRACK_MEMORY
+#define MEMORY_CONCAT_IMPL(a, b) a##b
+#define MEMORY_CONCAT(a, b) MEMORY_CONCAT_IMPL(a, b)
+#define MEMORY_SCOPE(tag) MemoryScope MEMORY_CONCAT(memoryScope_, __LINE__)(MemoryTracker::Tag::tag)
+#else
+#define MEMORY_SCOPE(tag)
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+#include "Profiler.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+Profiler & Profiler::Instance ()
+{
+   static Profiler instance;
+   return instance;
+}
+
+void Profiler::Record (char const* name, double milliseconds)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   for (auto & accumulator : m_current)
+   {
+      if (accumulator.name == name || strcmp(accumulator.name, name) == 0)
+      {
+         accumulator.milliseconds += milliseconds;
+         ++accumulator.calls;
+         return;
+      }
+   }
+   m_current.push_back({name, milliseconds, 1});
+}
+
+void Profiler::EndFrame ()
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   for (auto & sample : m_published)
+   {
+      ++sample.framesAgo;
+   }
+
+   for (auto & accumulator : m_current)
+   {
+      if (accumulator.calls == 0) continue;
+
+      auto it = std::find_if(m_published.begin(), m_published.end(), [&accumulator](Sample const& sample) {
+         return strcmp(sample.name, accumulator.name) == 0;
+      });
+      if (it == m_published.end())
+      {
+         m_published.push_back(Sample());
+         it = m_published.end() - 1;
+      }
+      *it = {accumulator.name, accumulator.milliseconds, accumulator.calls, 0};
+
+      // Keep the entry (and thus the vector's capacity) around for the next frame
+      accumulator.milliseconds = 0;
+      accumulator.calls = 0;
+   }
+}
@@ -0,0 +1,75 @@
+#ifndef Profiler_hpp
+#define Profiler_hpp
+
+#include "global.hpp"
+
+#include <vector>
+#include <mutex>
+
+#include "Chrono.hpp"
+
+/**
+ * Collects named timings over the course of a frame. Every name keeps the values from the last frame in
+ * which it was recorded, so that rare events (e.g. a rebuild) remain visible in the overlay.
+ * Safe to record from any thread.
+ */
+class Profiler
+{
+public:
+   struct Sample
+   {
+      char const* name; // expected to be a string literal
+      double milliseconds; // total over the last frame in which it was recorded
+      uint calls;
+      uint framesAgo; // how many frames ago the values above were recorded
+   };
+
+   static Profiler & Instance ();
+
+   void Record (char const* name, double milliseconds);
+
+   /**
+    * Publishes the timings recorded since the previous call
+    */
+   void EndFrame ();
+
+   std::vector<Sample> const& Samples () const { return m_published; }
+
+private:
+   struct Accumulator
+   {
+      char const* name;
+      double milliseconds;
+      uint calls;
+   };
+
+   Profiler () {}
+
+   std::mutex m_mutex;
+   std::vector<Accumulator> m_current;
+   std::vector<Sample> m_published;
+};
+
+/**
+ * Records the time between its construction and destruction
+ */
+class ProfileScope
+{
+   char const* m_name;
+   Chrono::TimePoint m_start;
+
+public:
+   explicit ProfileScope (char const* name) : m_name(name), m_start(Chrono::Clock::now()) {}
+
+   ~ProfileScope ()
+   {
+      std::chrono::duration<double, std::milli> elapsed = Chrono::Clock::now() - m_start;
+      Profiler::Instance().Record(m_name, elapsed.count());
+   }
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef SIMD_hpp
+#define SIMD_hpp
+
+/**
+ * Compile-time detection of the SIMD instruction sets that hand-vectorized code may use. SSE2 is part of
+ * the x86-64 baseline, so it is available on every 64-bit x86 build; MSVC doesn't define __SSE2__ though.
+ * Code using these must always keep a scalar fallback.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#endif
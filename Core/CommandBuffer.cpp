@@ -0,0 +1,53 @@
+#include "CommandBuffer.hpp"
+
+#include <cassert>
+
+Matrix4 CommandBuffer::Viewport::ToMatrix () const
+{
+   // x, y -> Convert from [-1, 1] to [0, 1], then scale by the viewport's dimensions and move it to its corner
+   // z -> leave as-is
+   float const v_x = 0.5f * width, v_y = 0.5f * height;
+   return Matrix4(Matrix4::elements_array_type{
+      v_x,   0, 0, x + v_x,
+        0, v_y, 0, y + v_y,
+        0,   0, 1,       0,
+        0,   0, 0,       1,
+   });
+}
+
+void CommandBuffer::SetViewport (Viewport const& viewport)
+{
+   m_commands.push_back({Type::SET_VIEWPORT, uint(m_viewports.size())});
+   m_viewports.push_back(viewport);
+}
+
+void CommandBuffer::SetMaterial (Material const* material)
+{
+   m_commands.push_back({Type::SET_MATERIAL, uint(m_materials.size())});
+   m_materials.push_back(material);
+}
+
+void CommandBuffer::DrawMesh (Mesh const& mesh, Matrix4 const& modelMatrix, Matrix4 const& modelMatrixInverse, Matrix4 const& normalMatrix)
+{
+   m_commands.push_back({Type::DRAW_MESH, uint(m_meshDraws.size())});
+   m_meshDraws.push_back({&mesh, modelMatrix, modelMatrixInverse, normalMatrix});
+}
+
+void CommandBuffer::DrawLines (Vector3 const* points, size_t const count, ColorRGB const color)
+{
+   assert(count % 2 == 0);
+
+   m_commands.push_back({Type::DRAW_LINES, uint(m_lineDraws.size())});
+   m_lineDraws.push_back({uint(m_linePoints.size()), uint(count), color});
+   m_linePoints.insert(m_linePoints.end(), points, points + count);
+}
+
+void CommandBuffer::Clear ()
+{
+   m_commands.clear();
+   m_viewports.clear();
+   m_materials.clear();
+   m_meshDraws.clear();
+   m_lineDraws.clear();
+   m_linePoints.clear();
+}
@@ -0,0 +1,100 @@
+#ifndef CommandBuffer_hpp
+#define CommandBuffer_hpp
+
+#include "global.hpp"
+
+#include <vector>
+
+#include "Color.hpp"
+#include "Vector.hpp"
+#include "Matrix.hpp"
+
+class Mesh;
+class Material;
+
+/**
+ * Draw commands recorded now, to be executed by the renderer later. Any number of buffers can be recorded at the
+ * same time, e.g. one per thread or per part of the scene; the renderer then executes them one after the other in
+ * the order it's given them, so what gets drawn doesn't depend on which thread recorded what, or when.
+ *
+ * State doesn't carry over from one buffer to the next: every buffer starts out with no material and the whole
+ * screen as its viewport. Meshes and materials are referred to by pointer, and must outlive the execution.
+ *
+ * Clearing a buffer keeps its memory, so recording into the same buffers every frame doesn't allocate.
+ */
+class CommandBuffer
+{
+public:
+   enum class Type : uint8_t
+   {
+      SET_VIEWPORT,
+      SET_MATERIAL,
+      DRAW_MESH,
+      DRAW_LINES
+   };
+
+   /**
+    * Each command's arguments are in the list for its type, at the given index
+    */
+   struct Command
+   {
+      Type type;
+      uint index;
+   };
+
+   /**
+    * Rectangle of the screen, in pixels from its bottom-left corner, onto which NDC are mapped
+    */
+   struct Viewport
+   {
+      float x, y, width, height;
+
+      Matrix4 ToMatrix () const;
+   };
+
+   struct MeshDraw
+   {
+      Mesh const* mesh;
+      Matrix4 modelMatrix;
+      Matrix4 modelMatrixInverse;
+      Matrix4 normalMatrix;
+   };
+
+   /**
+    * Segments between points [firstPoint, firstPoint + pointCount) taken two at a time
+    */
+   struct LineDraw
+   {
+      uint firstPoint, pointCount;
+      ColorRGB color;
+   };
+
+   void SetViewport (Viewport const& viewport);
+   void SetMaterial (Material const* material);
+   void DrawMesh (Mesh const& mesh, Matrix4 const& modelMatrix, Matrix4 const& modelMatrixInverse, Matrix4 const& normalMatrix);
+
+   /**
+    * Draws a segment between each pair of world-space points; a pair of identical points draws a single pixel
+    */
+   void DrawLines (Vector3 const* points, size_t const count, ColorRGB const color);
+
+   void Clear ();
+   bool Empty () const { return m_commands.empty(); }
+
+   std::vector<Command> const& Commands () const { return m_commands; }
+   std::vector<Viewport> const& Viewports () const { return m_viewports; }
+   std::vector<Material const*> const& Materials () const { return m_materials; }
+   std::vector<MeshDraw> const& MeshDraws () const { return m_meshDraws; }
+   std::vector<LineDraw> const& LineDraws () const { return m_lineDraws; }
+   std::vector<Vector3> const& LinePoints () const { return m_linePoints; }
+
+private:
+   std::vector<Command> m_commands;
+   std::vector<Viewport> m_viewports;
+   std::vector<Material const*> m_materials;
+   std::vector<MeshDraw> m_meshDraws;
+   std::vector<LineDraw> m_lineDraws;
+   std::vector<Vector3> m_linePoints;
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include "Kernels.hpp"
+
+#include <cstring>
+#include <iostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "Logger.hpp"
+
+namespace
+{
+   Kernels::Table s_active = {};
+   Kernels::Table const* s_pActive = nullptr;
+
+   struct CPUID
+   {
+      uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+   };
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+   CPUID QueryCPUID (uint32_t const leaf, uint32_t const subleaf=0)
+   {
+      int registers[4];
+      __cpuidex(registers, leaf, subleaf);
+
+      CPUID result;
+      result.eax = registers[0]; result.ebx = registers[1]; result.ecx = registers[2]; result.edx = registers[3];
+      return result;
+   }
+
+   uint64_t QueryXCR0 () { return _xgetbv(0); }
+#elif defined(__x86_64__) || defined(__i386__)
+   CPUID QueryCPUID (uint32_t const leaf, uint32_t const subleaf=0)
+   {
+      CPUID result;
+      __cpuid_count(leaf, subleaf, result.eax, result.ebx, result.ecx, result.edx);
+      return result;
+   }
+
+   // Spelled out, as _xgetbv() would require building this file with -mxsave
+   uint64_t QueryXCR0 ()
+   {
+      uint32_t eax, edx;
+      __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+      return (uint64_t(edx) << 32) | eax;
+   }
+#else
+   CPUID QueryCPUID (uint32_t const, uint32_t const=0) { return CPUID(); }
+   uint64_t QueryXCR0 () { return 0; }
+#endif
+
+   bool Bit (uint32_t const value, unsigned const bit) { return (value >> bit) & 1; }
+
+   Kernels::Table const* TableFor (Kernels::Level const level)
+   {
+      switch (level)
+      {
+         case Kernels::Level::AVX512: return Kernels::AVX512Table();
+         case Kernels::Level::AVX2: return Kernels::AVX2Table();
+         case Kernels::Level::SSE42: return Kernels::SSE42Table();
+         default: return Kernels::ScalarTable();
+      }
+   }
+
+   bool Parse (char const* name, Kernels::Level & level)
+   {
+      for (auto candidate : { Kernels::Level::SCALAR, Kernels::Level::SSE42, Kernels::Level::AVX2, Kernels::Level::AVX512 })
+      {
+         if (strcmp(name, Kernels::Name(candidate)) == 0)
+         {
+            level = candidate;
+            return true;
+         }
+      }
+      return false;
+   }
+}
+
+namespace Kernels
+{
+   Level Detect ()
+   {
+      uint32_t const maxLeaf = QueryCPUID(0).eax;
+      if (maxLeaf < 1) return Level::SCALAR;
+
+      CPUID const features = QueryCPUID(1);
+      CPUID const extended = maxLeaf >= 7 ? QueryCPUID(7) : CPUID();
+
+      bool const sse42 = Bit(features.ecx, 20);
+      if (!sse42) return Level::SCALAR;
+
+      // The wider registers are only usable if the OS saves them on context switches, as reported in XCR0
+      bool const osxsave = Bit(features.ecx, 27);
+      uint64_t const xcr0 = osxsave ? QueryXCR0() : 0;
+      bool const osAVX = (xcr0 & 0x6) == 0x6; // SSE and AVX state
+      bool const osAVX512 = (xcr0 & 0xe6) == 0xe6; // ... as well as opmask and the upper halves of zmm0-31
+
+      bool const avx2 = osAVX && Bit(features.ecx, 28) && Bit(features.ecx, 12) && Bit(extended.ebx, 5); // AVX, FMA, AVX2
+      if (!avx2) return Level::SSE42;
+
+      bool const avx512 = osAVX512 && Bit(extended.ebx, 16); // AVX-512F
+      return avx512 ? Level::AVX512 : Level::AVX2;
+   }
+
+   Level Initialize (char const* forcedLevel)
+   {
+      Level const detected = Detect();
+      Level level = detected;
+
+      if (forcedLevel && *forcedLevel)
+      {
+         Level forced;
+         if (!Parse(forcedLevel, forced))
+         {
+            trclog("Unknown CPU level \"" << forcedLevel << "\"; expected one of scalar, sse4.2, avx2 or avx512");
+         }
+         else if (forced > detected)
+         {
+            trclog("CPU level " << forcedLevel << " is not supported by this CPU");
+         }
+         else
+         {
+            level = forced;
+         }
+      }
+
+      // Fall back on narrower kernels for any instruction set the compiler couldn't target
+      while (!TableFor(level))
+         level = Level(int(level) - 1);
+
+      // Kernels the level doesn't have (yet) are the scalar ones
+      Table const& scalar = *ScalarTable();
+      s_active = *TableFor(level);
+      if (!s_active.Fill) s_active.Fill = scalar.Fill;
+      if (!s_active.TransformPoints) s_active.TransformPoints = scalar.TransformPoints;
+      if (!s_active.RasterizeSpan) s_active.RasterizeSpan = scalar.RasterizeSpan;
+      if (!s_active.SampleTexture) s_active.SampleTexture = scalar.SampleTexture;
+      if (!s_active.SampleTextureBilinear) s_active.SampleTextureBilinear = scalar.SampleTextureBilinear;
+      if (!s_active.SampleBlocks) s_active.SampleBlocks = scalar.SampleBlocks;
+      if (!s_active.SampleBlocksBilinear) s_active.SampleBlocksBilinear = scalar.SampleBlocksBilinear;
+      if (!s_active.BlendColors) s_active.BlendColors = scalar.BlendColors;
+      if (!s_active.PackColors) s_active.PackColors = scalar.PackColors;
+      s_pActive = &s_active;
+
+      trclog("CPU supports " << Name(detected) << "; using " << Name(level) << " kernels");
+      return level;
+   }
+
+   Table const& Active ()
+   {
+      return s_pActive ? *s_pActive : *ScalarTable();
+   }
+
+   char const* Name (Level const level)
+   {
+      switch (level)
+      {
+         case Level::SSE42: return "sse4.2";
+         case Level::AVX2: return "avx2";
+         case Level::AVX512: return "avx512";
+         default: return "scalar";
+      }
+   }
+}
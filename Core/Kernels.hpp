@@ -0,0 +1,177 @@
+#ifndef Kernels_hpp
+#define Kernels_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The renderer's innermost loops, each implemented for several instruction sets: scalar, SSE4.2, AVX2 and
+ * AVX-512. The CPU is queried once at startup and the widest set it (and the OS) supports is used, so that a
+ * single binary runs everywhere while still making the most of newer hosts.
+ *
+ * Every instruction set lives in its own translation unit, compiled with the matching flags. Those units must only
+ * include this header and intrinsics headers: any inline function they instantiate would be compiled for the wider
+ * instruction set, and the linker may then pick that copy for callers running on hosts that lack it.
+ */
+namespace Kernels
+{
+   enum class Level
+   {
+      SCALAR,
+      SSE42,
+      AVX2,
+      AVX512
+   };
+
+   /**
+    * One row of a triangle's bounding box. Every attribute is affine along the row: it is given at the first pixel,
+    * along with its step from one pixel to the next.
+    */
+   struct Span
+   {
+      float l0, l1, l2; // barycentric coordinates; the pixel is inside the triangle when all are non-negative
+      float z; // NDC depth, from -1 (near) to 1 (far)
+      float u, v;
+      float intensity;
+
+      float dl0, dl1, dl2;
+      float dz;
+      float du, dv;
+      float dintensity;
+
+      uint32_t count; // pixels in the row
+   };
+
+   /**
+    * Pixels of a span that passed the depth test, in SoA form. Every array needs room for a whole span.
+    */
+   struct Fragments
+   {
+      uint32_t* offsets; // from the first pixel of the span
+      float* u;
+      float* v;
+      float* intensities;
+   };
+
+   /**
+    * What texel coordinates outside of a texture map to, along one of its axes. Sizes that are powers of 2 take a
+    * faster path, masking coordinates rather than dividing them.
+    */
+   enum class Address : uint32_t
+   {
+      CLAMP, // the nearest texel on the edge
+      REPEAT, // the texture, over and over
+      MIRROR // the texture, over and over, with every other copy flipped
+   };
+
+   /**
+    * Texel coordinates are clamped to [-limit, limit] before being rounded to integers; that far out, floats can't
+    * tell neighbouring texels apart anyway
+    */
+   constexpr float TEXEL_COORDINATE_LIMIT = 8388608.f; // 2^23
+
+   /**
+    * Read-only view of a texture's pixels, as laid out by TextureMap: in 4x4 tiles of 64 bytes, i.e. a cache line,
+    * with tiles in row-major order and texels in row-major order within each tile. Rows of tiles are padded to a
+    * whole number of tiles.
+    */
+   struct Texels
+   {
+      uint32_t const* pixels;
+      uint32_t width, height;
+      Address addressU = Address::CLAMP, addressV = Address::CLAMP;
+      uint64_t const* blocks = nullptr; // instead of the pixels, if compressed: a block per tile; cf. TextureCompression
+   };
+
+   /**
+    * Compressed tiles decoded lately, direct-mapped by their bits. As those are all that decoding depends on, entries
+    * never go stale, whichever texture they came from. Every lookup may write to it, so each thread needs its own.
+    */
+   struct BlockCache
+   {
+      static constexpr uint32_t SIZE = 64; // 4 KB of texels, so as to stay in L1 along with everything else
+
+      BlockCache ();
+
+      uint64_t blocks[SIZE];
+      uint32_t texels[SIZE][16];
+   };
+
+   struct Table
+   {
+      Level level;
+
+      /**
+       * Sets count 32-bit values, such as pixels or (the bits of) depths
+       */
+      void (*Fill) (uint32_t* dst, uint32_t value, size_t count);
+
+      /**
+       * clip[4i, 4i+4) = matrix * (x, y, z, 1), where (x, y, z) are the 3 floats found i * stride bytes after points.
+       * The matrix is 16 floats, row-major; clip must be 16-byte aligned.
+       */
+      void (*TransformPoints) (float const* matrix, void const* points, size_t stride, size_t count, float* clip);
+
+      /**
+       * Depth-tests the pixels of a span that are inside the triangle and within the depth range. Those nearer than
+       * depth[offset] overwrite it and are appended to fragments. Returns how many were.
+       */
+      uint32_t (*RasterizeSpan) (Span const& span, float* depth, Fragments const& fragments);
+
+      /**
+       * Nearest texel at each (u, v), addressed as the texture says; the v axis points up, while rows are stored top
+       * to bottom
+       */
+      void (*SampleTexture) (Texels const& texture, float const* u, float const* v, size_t count, uint32_t* colors);
+
+      /**
+       * The 4 texels around each (u, v), addressed as the texture says, and weighted by how close their centres are.
+       * Weights are rounded to multiples of 1/256, as GPUs do, so that every instruction set gives the same colours.
+       */
+      void (*SampleTextureBilinear) (Texels const& texture, float const* u, float const* v, size_t count, uint32_t* colors);
+
+      /**
+       * SampleTexture and SampleTextureBilinear for compressed textures, decoding their tiles through the cache
+       */
+      void (*SampleBlocks) (Texels const& texture, BlockCache & cache, float const* u, float const* v, size_t count, uint32_t* colors);
+      void (*SampleBlocksBilinear) (Texels const& texture, BlockCache & cache, float const* u, float const* v, size_t count, uint32_t* colors);
+
+      /**
+       * Blends two arrays of colours, channel by channel: out = a + (b - a) * weight, with the weight rounded to a
+       * multiple of 1/256. out may be either of them.
+       */
+      void (*BlendColors) (uint32_t const* a, uint32_t const* b, float weight, size_t count, uint32_t* out);
+
+      /**
+       * Batched Color::Intensify: scales the channels of each colour by its gamma-corrected intensity, clamped to
+       * [0, 1], and packs them back. colors and out may be the same array. The vector levels approximate the gamma
+       * curve, so a channel may be one step off the scalar result; every other kernel matches it exactly.
+       */
+      void (*PackColors) (uint32_t const* colors, float const* intensities, size_t count, uint32_t* out);
+   };
+
+   /**
+    * Widest level supported by both the CPU and the OS
+    */
+   Level Detect ();
+
+   /**
+    * Selects the kernels to use from now on: those of the detected level, or of the given one (e.g. "sse4.2") if
+    * it's lower. Any kernel the level's table leaves null is taken from the scalar table instead. Logs the outcome and
+    * returns the selected level.
+    */
+   Level Initialize (char const* forcedLevel=nullptr);
+
+   Table const& Active ();
+
+   char const* Name (Level const level);
+
+   /// Implementations, one per translation unit; null when the compiler couldn't target the instruction set
+
+   Table const* ScalarTable ();
+   Table const* SSE42Table ();
+   Table const* AVX2Table ();
+   Table const* AVX512Table ();
+}
+
+#endif
@@ -0,0 +1,357 @@
+#include "Kernels.hpp"
+
+/**
+ * 8-wide kernels. Only this header and intrinsics may be included; cf. Kernels.hpp.
+ */
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER)) // MSVC has no macro for FMA, which /arch:AVX2 implies
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+   constexpr int WIDTH = 8;
+
+   int LowestBit (unsigned const mask)
+   {
+#ifdef _MSC_VER
+      unsigned long index;
+      _BitScanForward(&index, mask);
+      return int(index);
+#else
+      return __builtin_ctz(mask);
+#endif
+   }
+
+   /**
+    * Lanes [0, remaining) set, for the last, partial, group of elements
+    */
+   __m256i TailMask (size_t const remaining)
+   {
+      return _mm256_cmpgt_epi32(_mm256_set1_epi32(int(remaining < WIDTH ? remaining : WIDTH)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+   }
+
+   /**
+    * start + k * step, for the 8 pixels from the k-th one on
+    */
+   __m256 Affine (float const start, float const step, __m256 const k)
+   {
+      return _mm256_add_ps(_mm256_set1_ps(start), _mm256_mul_ps(k, _mm256_set1_ps(step)));
+   }
+
+   __m256 Log2 (__m256 const x)
+   {
+      __m256i const bits = _mm256_castps_si256(x);
+      __m256 const exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+      __m256 const mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+
+      // Minimax polynomial for log2(m) / (m - 1) over [1, 2); cf. J. Fonseca, "Fast SSE2 pow"
+      __m256 p = _mm256_set1_ps(0.0596515482674574969533f);
+      p = _mm256_fmadd_ps(p, mantissa, _mm256_set1_ps(-0.465725644288844778798f));
+      p = _mm256_fmadd_ps(p, mantissa, _mm256_set1_ps(1.48116647521213171641f));
+      p = _mm256_fmadd_ps(p, mantissa, _mm256_set1_ps(-2.52074962577807006663f));
+      p = _mm256_fmadd_ps(p, mantissa, _mm256_set1_ps(2.8882704548164776201f));
+      return _mm256_fmadd_ps(p, _mm256_sub_ps(mantissa, _mm256_set1_ps(1.f)), exponent);
+   }
+
+   __m256 Exp2 (__m256 x)
+   {
+      x = _mm256_max_ps(_mm256_min_ps(x, _mm256_set1_ps(127.99999f)), _mm256_set1_ps(-126.99999f));
+      __m256 const whole = _mm256_floor_ps(x);
+      __m256 const fraction = _mm256_sub_ps(x, whole);
+      __m256 const scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23));
+
+      // Minimax polynomial for 2^f over [0, 1)
+      __m256 p = _mm256_set1_ps(1.8775767e-3f);
+      p = _mm256_fmadd_ps(p, fraction, _mm256_set1_ps(8.9893397e-3f));
+      p = _mm256_fmadd_ps(p, fraction, _mm256_set1_ps(5.5826318e-2f));
+      p = _mm256_fmadd_ps(p, fraction, _mm256_set1_ps(2.4015361e-1f));
+      p = _mm256_fmadd_ps(p, fraction, _mm256_set1_ps(6.9315308e-1f));
+      p = _mm256_fmadd_ps(p, fraction, _mm256_set1_ps(9.9999994e-1f));
+      return _mm256_mul_ps(p, scale);
+   }
+
+   /**
+    * i^2.2 for i in [0, 1]
+    */
+   __m256 Gamma (__m256 const i)
+   {
+      __m256 const c = Exp2(_mm256_mul_ps(Log2(i), _mm256_set1_ps(2.2f)));
+      return _mm256_and_ps(c, _mm256_cmp_ps(i, _mm256_setzero_ps(), _CMP_GT_OQ));
+   }
+
+   void Fill (uint32_t* dst, uint32_t const value, size_t const count)
+   {
+      __m256i const v = _mm256_set1_epi32(int(value));
+      size_t i = 0;
+      for (; i + WIDTH <= count; i += WIDTH)
+         _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+      if (i < count)
+         _mm256_maskstore_epi32(reinterpret_cast<int*>(dst + i), TailMask(count - i), v);
+   }
+
+   void TransformPoints (float const* m, void const* points, size_t const stride, size_t const count, float* clip)
+   {
+      // Columns of the matrix, to be weighted by each coordinate
+      __m128 c0 = _mm_loadu_ps(m), c1 = _mm_loadu_ps(m + 4), c2 = _mm_loadu_ps(m + 8), c3 = _mm_loadu_ps(m + 12);
+      _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+      // Two points at a time, one per 128-bit lane
+      __m256 const C0 = _mm256_set_m128(c0, c0), C1 = _mm256_set_m128(c1, c1);
+      __m256 const C2 = _mm256_set_m128(c2, c2), C3 = _mm256_set_m128(c3, c3);
+
+      char const* point = static_cast<char const*>(points);
+      size_t i = 0;
+      for (; i + 2 <= count; i += 2, point += 2 * stride, clip += 8)
+      {
+         float const* p = reinterpret_cast<float const*>(point);
+         float const* q = reinterpret_cast<float const*>(point + stride);
+         __m256 r = _mm256_add_ps(_mm256_mul_ps(C0, _mm256_set_m128(_mm_set1_ps(q[0]), _mm_set1_ps(p[0]))),
+            _mm256_mul_ps(C1, _mm256_set_m128(_mm_set1_ps(q[1]), _mm_set1_ps(p[1]))));
+         r = _mm256_add_ps(r, _mm256_mul_ps(C2, _mm256_set_m128(_mm_set1_ps(q[2]), _mm_set1_ps(p[2]))));
+         r = _mm256_add_ps(r, C3);
+         _mm256_storeu_ps(clip, r);
+      }
+      if (i < count)
+      {
+         float const* p = reinterpret_cast<float const*>(point);
+         __m128 r = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p[0])), _mm_mul_ps(c1, _mm_set1_ps(p[1])));
+         r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(p[2])));
+         r = _mm_add_ps(r, c3);
+         _mm_store_ps(clip, r);
+      }
+   }
+
+   uint32_t RasterizeSpan (Kernels::Span const& s, float* depth, Kernels::Fragments const& out)
+   {
+      __m256 const lanes = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+      __m256 const zero = _mm256_setzero_ps(), nearest = _mm256_set1_ps(-1.f), farthest = _mm256_set1_ps(1.f);
+
+      alignas(32) float us[WIDTH], vs[WIDTH], is[WIDTH];
+
+      uint32_t n = 0;
+      for (uint32_t x = 0; x < s.count; x += WIDTH)
+      {
+         __m256 const k = _mm256_add_ps(_mm256_set1_ps(float(x)), lanes);
+         __m256 const inside = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(Affine(s.l0, s.dl0, k), zero, _CMP_GE_OQ), _mm256_cmp_ps(Affine(s.l1, s.dl1, k), zero, _CMP_GE_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(Affine(s.l2, s.dl2, k), zero, _CMP_GE_OQ), _mm256_castsi256_ps(TailMask(s.count - x)))
+         );
+         if (!_mm256_movemask_ps(inside)) continue;
+
+         // Masked loads and stores leave the pixels past the end of the span alone
+         __m256 const z = Affine(s.z, s.dz, k);
+         __m256 const old = _mm256_maskload_ps(depth + x, _mm256_castps_si256(inside));
+         __m256 const pass = _mm256_and_ps(
+            _mm256_and_ps(inside, _mm256_cmp_ps(z, old, _CMP_LE_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(z, nearest, _CMP_GE_OQ), _mm256_cmp_ps(z, farthest, _CMP_LE_OQ))
+         );
+         unsigned mask = unsigned(_mm256_movemask_ps(pass));
+         if (!mask) continue;
+
+         _mm256_maskstore_ps(depth + x, _mm256_castps_si256(pass), z);
+
+         _mm256_store_ps(us, Affine(s.u, s.du, k));
+         _mm256_store_ps(vs, Affine(s.v, s.dv, k));
+         _mm256_store_ps(is, Affine(s.intensity, s.dintensity, k));
+         for (; mask; mask &= mask - 1, ++n)
+         {
+            int const j = LowestBit(mask);
+            out.offsets[n] = x + j;
+            out.u[n] = us[j];
+            out.v[n] = vs[j];
+            out.intensities[n] = is[j];
+         }
+      }
+      return n;
+   }
+
+   /**
+    * Index of texel (x, y) in 4x4 tiles; cf. Kernels::Texels
+    */
+   __m256i TexelIndex (__m256i const x, __m256i const y, __m256i const tilesPerRow)
+   {
+      __m256i const three = _mm256_set1_epi32(3);
+      __m256i const tile = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(y, 2), tilesPerRow), _mm256_srli_epi32(x, 2));
+      __m256i const within = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(y, three), 2), _mm256_and_si256(x, three));
+      return _mm256_or_si256(_mm256_slli_epi32(tile, 4), within);
+   }
+
+   /**
+    * Texel coordinates clamped to Kernels::TEXEL_COORDINATE_LIMIT; NaNs end up at -limit
+    */
+   __m256 ClampCoordinate (__m256 const x)
+   {
+      return _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-Kernels::TEXEL_COORDINATE_LIMIT)), _mm256_set1_ps(Kernels::TEXEL_COORDINATE_LIMIT));
+   }
+
+   /**
+    * Wraps texel coordinates into [0, size) along one axis of a texture, as its addressing mode says
+    */
+   struct Axis
+   {
+      Kernels::Address address;
+      bool powerOfTwo;
+      __m256i last; // size - 1
+      __m256i period, periodLast; // the texture repeats every size texels, or every 2 * size when mirrored
+      __m256 inversePeriod;
+
+      Axis (Kernels::Address const mode, uint32_t const size)
+         : address(mode), powerOfTwo((size & (size - 1)) == 0), last(_mm256_set1_epi32(int(size - 1)))
+      {
+         int const p = int(mode == Kernels::Address::MIRROR ? 2 * size : size);
+         period = _mm256_set1_epi32(p);
+         periodLast = _mm256_set1_epi32(p - 1);
+         inversePeriod = _mm256_set1_ps(1.f / float(p));
+      }
+
+      __m256i Wrap (__m256i const i) const
+      {
+         __m256i const zero = _mm256_setzero_si256();
+         if (address == Kernels::Address::CLAMP)
+            return _mm256_min_epi32(_mm256_max_epi32(i, zero), last);
+
+         __m256i m;
+         if (powerOfTwo)
+         {
+            m = _mm256_and_si256(i, periodLast);
+         }
+         else
+         {
+            // No integer division: the quotient comes from floats, and may be off by one, which the remainder then
+            // gives away by being out of [0, period)
+            __m256i const q = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(i), inversePeriod)));
+            m = _mm256_sub_epi32(i, _mm256_mullo_epi32(q, period));
+            m = _mm256_add_epi32(m, _mm256_and_si256(_mm256_cmpgt_epi32(zero, m), period));
+            m = _mm256_sub_epi32(m, _mm256_andnot_si256(_mm256_cmpgt_epi32(period, m), period));
+         }
+         return address == Kernels::Address::MIRROR ? _mm256_min_epi32(m, _mm256_sub_epi32(periodLast, m)) : m;
+      }
+   };
+
+   /**
+    * a + (b - a) * weight / 256, for every channel, with weights in [0, 256]; cf. the scalar Lerp
+    */
+   __m256i Lerp (__m256i const a, __m256i const b, __m256i const weight)
+   {
+      __m256i const channels = _mm256_set1_epi32(0x00ff00ff), half = _mm256_set1_epi32(0x00800080);
+      __m256i const inverse = _mm256_sub_epi32(_mm256_set1_epi32(256), weight);
+      __m256i const even = _mm256_add_epi32(_mm256_add_epi32(
+         _mm256_mullo_epi32(_mm256_and_si256(a, channels), inverse), _mm256_mullo_epi32(_mm256_and_si256(b, channels), weight)), half);
+      __m256i const odd = _mm256_add_epi32(_mm256_add_epi32(
+         _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(a, 8), channels), inverse),
+         _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(b, 8), channels), weight)), half);
+      return _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(even, 8), channels), _mm256_andnot_si256(channels, odd));
+   }
+
+   void SampleTexture (Kernels::Texels const& t, float const* u, float const* v, size_t const count, uint32_t* colors)
+   {
+      __m256 const width = _mm256_set1_ps(float(t.width)), height = _mm256_set1_ps(float(t.height));
+      __m256 const one = _mm256_set1_ps(1.f);
+      __m256i const tilesPerRow = _mm256_set1_epi32(int((t.width + 3) / 4));
+      Axis const axisU(t.addressU, t.width), axisV(t.addressV, t.height);
+      int const* pixels = reinterpret_cast<int const*>(t.pixels);
+
+      for (size_t i = 0; i < count; i += WIDTH)
+      {
+         __m256i const mask = TailMask(count - i);
+         __m256 const x = _mm256_floor_ps(ClampCoordinate(_mm256_mul_ps(_mm256_maskload_ps(u + i, mask), width)));
+         __m256 const y = _mm256_floor_ps(ClampCoordinate(_mm256_mul_ps(_mm256_sub_ps(one, _mm256_maskload_ps(v + i, mask)), height)));
+         __m256i const index = TexelIndex(axisU.Wrap(_mm256_cvttps_epi32(x)), axisV.Wrap(_mm256_cvttps_epi32(y)), tilesPerRow);
+         __m256i const texels = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), pixels, index, mask, 4);
+         _mm256_maskstore_epi32(reinterpret_cast<int*>(colors + i), mask, texels);
+      }
+   }
+
+   void SampleTextureBilinear (Kernels::Texels const& t, float const* u, float const* v, size_t const count, uint32_t* colors)
+   {
+      // Half a texel's offset, applied to uv before scaling; cf. the scalar kernel
+      __m256 const width = _mm256_set1_ps(float(t.width)), height = _mm256_set1_ps(float(t.height));
+      __m256 const uOffset = _mm256_set1_ps(0.5f / t.width), vOffset = _mm256_set1_ps(1.f - 0.5f / t.height);
+      __m256 const scale = _mm256_set1_ps(256.f), half = _mm256_set1_ps(0.5f);
+      __m256i const one = _mm256_set1_epi32(1), zero = _mm256_setzero_si256();
+      __m256i const tilesPerRow = _mm256_set1_epi32(int((t.width + 3) / 4));
+      Axis const axisU(t.addressU, t.width), axisV(t.addressV, t.height);
+      int const* pixels = reinterpret_cast<int const*>(t.pixels);
+
+      for (size_t i = 0; i < count; i += WIDTH)
+      {
+         __m256i const mask = TailMask(count - i);
+         __m256 const x = ClampCoordinate(_mm256_mul_ps(_mm256_sub_ps(_mm256_maskload_ps(u + i, mask), uOffset), width));
+         __m256 const y = ClampCoordinate(_mm256_mul_ps(_mm256_sub_ps(vOffset, _mm256_maskload_ps(v + i, mask)), height));
+         __m256 const left = _mm256_floor_ps(x), top = _mm256_floor_ps(y);
+         __m256i const wx = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(x, left), scale), half));
+         __m256i const wy = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(y, top), scale), half));
+
+         __m256i const x0 = _mm256_cvttps_epi32(left), y0 = _mm256_cvttps_epi32(top);
+         __m256i const x1 = axisU.Wrap(_mm256_add_epi32(x0, one)), y1 = axisV.Wrap(_mm256_add_epi32(y0, one));
+         __m256i const wrappedX0 = axisU.Wrap(x0), wrappedY0 = axisV.Wrap(y0);
+         __m256i const c00 = _mm256_mask_i32gather_epi32(zero, pixels, TexelIndex(wrappedX0, wrappedY0, tilesPerRow), mask, 4);
+         __m256i const c10 = _mm256_mask_i32gather_epi32(zero, pixels, TexelIndex(x1, wrappedY0, tilesPerRow), mask, 4);
+         __m256i const c01 = _mm256_mask_i32gather_epi32(zero, pixels, TexelIndex(wrappedX0, y1, tilesPerRow), mask, 4);
+         __m256i const c11 = _mm256_mask_i32gather_epi32(zero, pixels, TexelIndex(x1, y1, tilesPerRow), mask, 4);
+         _mm256_maskstore_epi32(reinterpret_cast<int*>(colors + i), mask, Lerp(Lerp(c00, c10, wx), Lerp(c01, c11, wx), wy));
+      }
+   }
+
+   void BlendColors (uint32_t const* a, uint32_t const* b, float const weight, size_t const count, uint32_t* out)
+   {
+      __m256i const w = _mm256_set1_epi32(int(weight * 256.f + 0.5f));
+      for (size_t i = 0; i < count; i += WIDTH)
+      {
+         __m256i const mask = TailMask(count - i);
+         __m256i const blended = Lerp(_mm256_maskload_epi32(reinterpret_cast<int const*>(a + i), mask),
+            _mm256_maskload_epi32(reinterpret_cast<int const*>(b + i), mask), w);
+         _mm256_maskstore_epi32(reinterpret_cast<int*>(out + i), mask, blended);
+      }
+   }
+
+   void PackColors (uint32_t const* colors, float const* intensities, size_t const count, uint32_t* out)
+   {
+      __m256i const byte = _mm256_set1_epi32(0xff);
+      __m256 const zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f), half = _mm256_set1_ps(0.5f);
+
+      for (size_t i = 0; i < count; i += WIDTH)
+      {
+         __m256i const mask = TailMask(count - i);
+         __m256 const c = Gamma(_mm256_min_ps(_mm256_max_ps(_mm256_maskload_ps(intensities + i, mask), zero), one));
+         __m256i const color = _mm256_maskload_epi32(reinterpret_cast<int const*>(colors + i), mask);
+
+         // Rounded to nearest, like roundf(), by truncating after adding one half
+         __m256i const r = _mm256_cvttps_epi32(_mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(color, 24)), c, half));
+         __m256i const g = _mm256_cvttps_epi32(_mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(color, 16), byte)), c, half));
+         __m256i const b = _mm256_cvttps_epi32(_mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(color, 8), byte)), c, half));
+
+         __m256i const result = _mm256_or_si256(
+            _mm256_or_si256(_mm256_slli_epi32(_mm256_min_epi32(r, byte), 24), _mm256_slli_epi32(_mm256_min_epi32(g, byte), 16)),
+            _mm256_or_si256(_mm256_slli_epi32(_mm256_min_epi32(b, byte), 8), byte)
+         );
+         _mm256_maskstore_epi32(reinterpret_cast<int*>(out + i), mask, result);
+      }
+   }
+
+   Kernels::Table const TABLE = {
+      Kernels::Level::AVX2,
+      Fill,
+      TransformPoints,
+      RasterizeSpan,
+      SampleTexture,
+      SampleTextureBilinear,
+      nullptr, // SampleBlocks
+      nullptr, // SampleBlocksBilinear
+      BlendColors,
+      PackColors
+   };
+}
+
+Kernels::Table const* Kernels::AVX2Table () { return &TABLE; }
+
+#else
+
+Kernels::Table const* Kernels::AVX2Table () { return nullptr; }
+
+#endif
@@ -0,0 +1,327 @@
+#include "Kernels.hpp"
+
+/**
+ * 16-wide kernels, using AVX-512F only. Only this header and intrinsics may be included; cf. Kernels.hpp.
+ */
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+
+namespace
+{
+   constexpr int WIDTH = 16;
+
+   /**
+    * Lanes [0, remaining) set, for the last, partial, group of elements
+    */
+   __mmask16 TailMask (size_t const remaining)
+   {
+      return remaining < WIDTH ? __mmask16((1u << remaining) - 1) : __mmask16(0xffff);
+   }
+
+   /**
+    * start + k * step, for the 16 pixels from the k-th one on
+    */
+   __m512 Affine (float const start, float const step, __m512 const k)
+   {
+      return _mm512_add_ps(_mm512_set1_ps(start), _mm512_mul_ps(k, _mm512_set1_ps(step)));
+   }
+
+   /**
+    * i^2.2 for i in [0, 1]. getexp/getmant split a float into exponent and mantissa without any bit twiddling.
+    */
+   __m512 Gamma (__m512 const i)
+   {
+      __m512 const exponent = _mm512_getexp_ps(i);
+      __m512 const mantissa = _mm512_getmant_ps(i, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero);
+
+      // Minimax polynomial for log2(m) / (m - 1) over [1, 2); cf. J. Fonseca, "Fast SSE2 pow"
+      __m512 p = _mm512_set1_ps(0.0596515482674574969533f);
+      p = _mm512_fmadd_ps(p, mantissa, _mm512_set1_ps(-0.465725644288844778798f));
+      p = _mm512_fmadd_ps(p, mantissa, _mm512_set1_ps(1.48116647521213171641f));
+      p = _mm512_fmadd_ps(p, mantissa, _mm512_set1_ps(-2.52074962577807006663f));
+      p = _mm512_fmadd_ps(p, mantissa, _mm512_set1_ps(2.8882704548164776201f));
+      __m512 x = _mm512_mul_ps(_mm512_fmadd_ps(p, _mm512_sub_ps(mantissa, _mm512_set1_ps(1.f)), exponent), _mm512_set1_ps(2.2f));
+
+      // 2^x, with a minimax polynomial for 2^f over [0, 1), and scalef for the whole part
+      x = _mm512_max_ps(x, _mm512_set1_ps(-126.99999f));
+      __m512 const whole = _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+      __m512 const fraction = _mm512_sub_ps(x, whole);
+      p = _mm512_set1_ps(1.8775767e-3f);
+      p = _mm512_fmadd_ps(p, fraction, _mm512_set1_ps(8.9893397e-3f));
+      p = _mm512_fmadd_ps(p, fraction, _mm512_set1_ps(5.5826318e-2f));
+      p = _mm512_fmadd_ps(p, fraction, _mm512_set1_ps(2.4015361e-1f));
+      p = _mm512_fmadd_ps(p, fraction, _mm512_set1_ps(6.9315308e-1f));
+      p = _mm512_fmadd_ps(p, fraction, _mm512_set1_ps(9.9999994e-1f));
+
+      __mmask16 const positive = _mm512_cmp_ps_mask(i, _mm512_setzero_ps(), _CMP_GT_OQ);
+      return _mm512_maskz_scalef_ps(positive, p, whole);
+   }
+
+   void Fill (uint32_t* dst, uint32_t const value, size_t const count)
+   {
+      __m512i const v = _mm512_set1_epi32(int(value));
+      size_t i = 0;
+      for (; i + WIDTH <= count; i += WIDTH)
+         _mm512_storeu_si512(dst + i, v);
+      if (i < count)
+         _mm512_mask_storeu_epi32(dst + i, TailMask(count - i), v);
+   }
+
+   void TransformPoints (float const* m, void const* points, size_t const stride, size_t const count, float* clip)
+   {
+      // Columns of the matrix, to be weighted by each coordinate
+      __m128 c0 = _mm_loadu_ps(m), c1 = _mm_loadu_ps(m + 4), c2 = _mm_loadu_ps(m + 8), c3 = _mm_loadu_ps(m + 12);
+      _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+      // Four points at a time, one per 128-bit lane
+      __m512 const C0 = _mm512_broadcast_f32x4(c0), C1 = _mm512_broadcast_f32x4(c1);
+      __m512 const C2 = _mm512_broadcast_f32x4(c2), C3 = _mm512_broadcast_f32x4(c3);
+      __m512i const lanes = _mm512_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+
+      char const* point = static_cast<char const*>(points);
+      for (size_t i = 0; i < count; i += 4, point += 4 * stride, clip += 16)
+      {
+         // The last, partial, group repeats its last point, and only stores the points that exist
+         size_t const remaining = count - i < 4 ? count - i : 4;
+         float const* p[4];
+         for (size_t j = 0; j < 4; ++j)
+            p[j] = reinterpret_cast<float const*>(point + (j < remaining ? j : remaining - 1) * stride);
+
+         __m512 const x = _mm512_permutexvar_ps(lanes, _mm512_castps128_ps512(_mm_setr_ps(p[0][0], p[1][0], p[2][0], p[3][0])));
+         __m512 const y = _mm512_permutexvar_ps(lanes, _mm512_castps128_ps512(_mm_setr_ps(p[0][1], p[1][1], p[2][1], p[3][1])));
+         __m512 const z = _mm512_permutexvar_ps(lanes, _mm512_castps128_ps512(_mm_setr_ps(p[0][2], p[1][2], p[2][2], p[3][2])));
+         __m512 r = _mm512_add_ps(_mm512_mul_ps(C0, x), _mm512_mul_ps(C1, y));
+         r = _mm512_add_ps(r, _mm512_mul_ps(C2, z));
+         r = _mm512_add_ps(r, C3);
+         _mm512_mask_storeu_ps(clip, TailMask(4 * remaining), r);
+      }
+   }
+
+   uint32_t RasterizeSpan (Kernels::Span const& s, float* depth, Kernels::Fragments const& out)
+   {
+      __m512 const lanes = _mm512_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f, 10.f, 11.f, 12.f, 13.f, 14.f, 15.f);
+      __m512 const zero = _mm512_setzero_ps(), nearest = _mm512_set1_ps(-1.f), farthest = _mm512_set1_ps(1.f);
+
+      uint32_t n = 0;
+      for (uint32_t x = 0; x < s.count; x += WIDTH)
+      {
+         __m512 const k = _mm512_add_ps(_mm512_set1_ps(float(x)), lanes);
+         __mmask16 inside = TailMask(s.count - x);
+         inside = _mm512_mask_cmp_ps_mask(inside, Affine(s.l0, s.dl0, k), zero, _CMP_GE_OQ);
+         inside = _mm512_mask_cmp_ps_mask(inside, Affine(s.l1, s.dl1, k), zero, _CMP_GE_OQ);
+         inside = _mm512_mask_cmp_ps_mask(inside, Affine(s.l2, s.dl2, k), zero, _CMP_GE_OQ);
+         if (!inside) continue;
+
+         __m512 const z = Affine(s.z, s.dz, k);
+         __mmask16 pass = _mm512_mask_cmp_ps_mask(inside, z, _mm512_maskz_loadu_ps(inside, depth + x), _CMP_LE_OQ);
+         pass = _mm512_mask_cmp_ps_mask(pass, z, nearest, _CMP_GE_OQ);
+         pass = _mm512_mask_cmp_ps_mask(pass, z, farthest, _CMP_LE_OQ);
+         if (!pass) continue;
+
+         _mm512_mask_storeu_ps(depth + x, pass, z);
+
+         // Passing pixels are packed together as they're stored
+         __m512i const offsets = _mm512_add_epi32(_mm512_set1_epi32(int(x)), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+         _mm512_mask_compressstoreu_epi32(out.offsets + n, pass, offsets);
+         _mm512_mask_compressstoreu_ps(out.u + n, pass, Affine(s.u, s.du, k));
+         _mm512_mask_compressstoreu_ps(out.v + n, pass, Affine(s.v, s.dv, k));
+         _mm512_mask_compressstoreu_ps(out.intensities + n, pass, Affine(s.intensity, s.dintensity, k));
+
+#ifdef _MSC_VER
+         n += __popcnt(pass);
+#else
+         n += __builtin_popcount(pass);
+#endif
+      }
+      return n;
+   }
+
+   /**
+    * Index of texel (x, y) in 4x4 tiles; cf. Kernels::Texels
+    */
+   __m512i TexelIndex (__m512i const x, __m512i const y, __m512i const tilesPerRow)
+   {
+      __m512i const three = _mm512_set1_epi32(3);
+      __m512i const tile = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_srli_epi32(y, 2), tilesPerRow), _mm512_srli_epi32(x, 2));
+      __m512i const within = _mm512_or_si512(_mm512_slli_epi32(_mm512_and_si512(y, three), 2), _mm512_and_si512(x, three));
+      return _mm512_or_si512(_mm512_slli_epi32(tile, 4), within);
+   }
+
+   /**
+    * Texel coordinates clamped to Kernels::TEXEL_COORDINATE_LIMIT; NaNs end up at -limit
+    */
+   __m512 ClampCoordinate (__m512 const x)
+   {
+      return _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(-Kernels::TEXEL_COORDINATE_LIMIT)), _mm512_set1_ps(Kernels::TEXEL_COORDINATE_LIMIT));
+   }
+
+   __m512 Floor (__m512 const x)
+   {
+      return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+   }
+
+   /**
+    * Wraps texel coordinates into [0, size) along one axis of a texture, as its addressing mode says
+    */
+   struct Axis
+   {
+      Kernels::Address address;
+      bool powerOfTwo;
+      __m512i last; // size - 1
+      __m512i period, periodLast; // the texture repeats every size texels, or every 2 * size when mirrored
+      __m512 inversePeriod;
+
+      Axis (Kernels::Address const mode, uint32_t const size)
+         : address(mode), powerOfTwo((size & (size - 1)) == 0), last(_mm512_set1_epi32(int(size - 1)))
+      {
+         int const p = int(mode == Kernels::Address::MIRROR ? 2 * size : size);
+         period = _mm512_set1_epi32(p);
+         periodLast = _mm512_set1_epi32(p - 1);
+         inversePeriod = _mm512_set1_ps(1.f / float(p));
+      }
+
+      __m512i Wrap (__m512i const i) const
+      {
+         __m512i const zero = _mm512_setzero_si512();
+         if (address == Kernels::Address::CLAMP)
+            return _mm512_min_epi32(_mm512_max_epi32(i, zero), last);
+
+         __m512i m;
+         if (powerOfTwo)
+         {
+            m = _mm512_and_si512(i, periodLast);
+         }
+         else
+         {
+            // No integer division: the quotient comes from floats, and may be off by one, which the remainder then
+            // gives away by being out of [0, period)
+            __m512i const q = _mm512_cvttps_epi32(Floor(_mm512_mul_ps(_mm512_cvtepi32_ps(i), inversePeriod)));
+            m = _mm512_sub_epi32(i, _mm512_mullo_epi32(q, period));
+            m = _mm512_mask_add_epi32(m, _mm512_cmplt_epi32_mask(m, zero), m, period);
+            m = _mm512_mask_sub_epi32(m, _mm512_cmpge_epi32_mask(m, period), m, period);
+         }
+         return address == Kernels::Address::MIRROR ? _mm512_min_epi32(m, _mm512_sub_epi32(periodLast, m)) : m;
+      }
+   };
+
+   /**
+    * a + (b - a) * weight / 256, for every channel, with weights in [0, 256]; cf. the scalar Lerp
+    */
+   __m512i Lerp (__m512i const a, __m512i const b, __m512i const weight)
+   {
+      __m512i const channels = _mm512_set1_epi32(0x00ff00ff), half = _mm512_set1_epi32(0x00800080);
+      __m512i const inverse = _mm512_sub_epi32(_mm512_set1_epi32(256), weight);
+      __m512i const even = _mm512_add_epi32(_mm512_add_epi32(
+         _mm512_mullo_epi32(_mm512_and_si512(a, channels), inverse), _mm512_mullo_epi32(_mm512_and_si512(b, channels), weight)), half);
+      __m512i const odd = _mm512_add_epi32(_mm512_add_epi32(
+         _mm512_mullo_epi32(_mm512_and_si512(_mm512_srli_epi32(a, 8), channels), inverse),
+         _mm512_mullo_epi32(_mm512_and_si512(_mm512_srli_epi32(b, 8), channels), weight)), half);
+      return _mm512_or_si512(_mm512_and_si512(_mm512_srli_epi32(even, 8), channels), _mm512_andnot_si512(channels, odd));
+   }
+
+   void SampleTexture (Kernels::Texels const& t, float const* u, float const* v, size_t const count, uint32_t* colors)
+   {
+      __m512 const width = _mm512_set1_ps(float(t.width)), height = _mm512_set1_ps(float(t.height));
+      __m512 const one = _mm512_set1_ps(1.f);
+      __m512i const tilesPerRow = _mm512_set1_epi32(int((t.width + 3) / 4));
+      Axis const axisU(t.addressU, t.width), axisV(t.addressV, t.height);
+
+      for (size_t i = 0; i < count; i += WIDTH)
+      {
+         __mmask16 const mask = TailMask(count - i);
+         __m512 const x = Floor(ClampCoordinate(_mm512_mul_ps(_mm512_maskz_loadu_ps(mask, u + i), width)));
+         __m512 const y = Floor(ClampCoordinate(_mm512_mul_ps(_mm512_sub_ps(one, _mm512_maskz_loadu_ps(mask, v + i)), height)));
+         __m512i const index = TexelIndex(axisU.Wrap(_mm512_cvttps_epi32(x)), axisV.Wrap(_mm512_cvttps_epi32(y)), tilesPerRow);
+         __m512i const texels = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), mask, index, t.pixels, 4);
+         _mm512_mask_storeu_epi32(colors + i, mask, texels);
+      }
+   }
+
+   void SampleTextureBilinear (Kernels::Texels const& t, float const* u, float const* v, size_t const count, uint32_t* colors)
+   {
+      // Half a texel's offset, applied to uv before scaling; cf. the scalar kernel
+      __m512 const width = _mm512_set1_ps(float(t.width)), height = _mm512_set1_ps(float(t.height));
+      __m512 const uOffset = _mm512_set1_ps(0.5f / t.width), vOffset = _mm512_set1_ps(1.f - 0.5f / t.height);
+      __m512 const scale = _mm512_set1_ps(256.f), half = _mm512_set1_ps(0.5f);
+      __m512i const one = _mm512_set1_epi32(1), zero = _mm512_setzero_si512();
+      __m512i const tilesPerRow = _mm512_set1_epi32(int((t.width + 3) / 4));
+      Axis const axisU(t.addressU, t.width), axisV(t.addressV, t.height);
+
+      for (size_t i = 0; i < count; i += WIDTH)
+      {
+         __mmask16 const mask = TailMask(count - i);
+         __m512 const x = ClampCoordinate(_mm512_mul_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, u + i), uOffset), width));
+         __m512 const y = ClampCoordinate(_mm512_mul_ps(_mm512_sub_ps(vOffset, _mm512_maskz_loadu_ps(mask, v + i)), height));
+         __m512 const left = Floor(x), top = Floor(y);
+         __m512i const wx = _mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(_mm512_sub_ps(x, left), scale), half));
+         __m512i const wy = _mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(_mm512_sub_ps(y, top), scale), half));
+
+         __m512i const x0 = _mm512_cvttps_epi32(left), y0 = _mm512_cvttps_epi32(top);
+         __m512i const x1 = axisU.Wrap(_mm512_add_epi32(x0, one)), y1 = axisV.Wrap(_mm512_add_epi32(y0, one));
+         __m512i const wrappedX0 = axisU.Wrap(x0), wrappedY0 = axisV.Wrap(y0);
+         __m512i const c00 = _mm512_mask_i32gather_epi32(zero, mask, TexelIndex(wrappedX0, wrappedY0, tilesPerRow), t.pixels, 4);
+         __m512i const c10 = _mm512_mask_i32gather_epi32(zero, mask, TexelIndex(x1, wrappedY0, tilesPerRow), t.pixels, 4);
+         __m512i const c01 = _mm512_mask_i32gather_epi32(zero, mask, TexelIndex(wrappedX0, y1, tilesPerRow), t.pixels, 4);
+         __m512i const c11 = _mm512_mask_i32gather_epi32(zero, mask, TexelIndex(x1, y1, tilesPerRow), t.pixels, 4);
+         _mm512_mask_storeu_epi32(colors + i, mask, Lerp(Lerp(c00, c10, wx), Lerp(c01, c11, wx), wy));
+      }
+   }
+
+   void BlendColors (uint32_t const* a, uint32_t const* b, float const weight, size_t const count, uint32_t* out)
+   {
+      __m512i const w = _mm512_set1_epi32(int(weight * 256.f + 0.5f));
+      for (size_t i = 0; i < count; i += WIDTH)
+      {
+         __mmask16 const mask = TailMask(count - i);
+         __m512i const blended = Lerp(_mm512_maskz_loadu_epi32(mask, a + i), _mm512_maskz_loadu_epi32(mask, b + i), w);
+         _mm512_mask_storeu_epi32(out + i, mask, blended);
+      }
+   }
+
+   void PackColors (uint32_t const* colors, float const* intensities, size_t const count, uint32_t* out)
+   {
+      __m512i const byte = _mm512_set1_epi32(0xff);
+      __m512 const zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1.f), half = _mm512_set1_ps(0.5f);
+
+      for (size_t i = 0; i < count; i += WIDTH)
+      {
+         __mmask16 const mask = TailMask(count - i);
+         __m512 const c = Gamma(_mm512_min_ps(_mm512_max_ps(_mm512_maskz_loadu_ps(mask, intensities + i), zero), one));
+         __m512i const color = _mm512_maskz_loadu_epi32(mask, colors + i);
+
+         // Rounded to nearest, like roundf(), by truncating after adding one half
+         __m512i const r = _mm512_cvttps_epi32(_mm512_fmadd_ps(_mm512_cvtepi32_ps(_mm512_srli_epi32(color, 24)), c, half));
+         __m512i const g = _mm512_cvttps_epi32(_mm512_fmadd_ps(_mm512_cvtepi32_ps(_mm512_and_si512(_mm512_srli_epi32(color, 16), byte)), c, half));
+         __m512i const b = _mm512_cvttps_epi32(_mm512_fmadd_ps(_mm512_cvtepi32_ps(_mm512_and_si512(_mm512_srli_epi32(color, 8), byte)), c, half));
+
+         __m512i const result = _mm512_or_si512(
+            _mm512_or_si512(_mm512_slli_epi32(_mm512_min_epi32(r, byte), 24), _mm512_slli_epi32(_mm512_min_epi32(g, byte), 16)),
+            _mm512_or_si512(_mm512_slli_epi32(_mm512_min_epi32(b, byte), 8), byte)
+         );
+         _mm512_mask_storeu_epi32(out + i, mask, result);
+      }
+   }
+
+   Kernels::Table const TABLE = {
+      Kernels::Level::AVX512,
+      Fill,
+      TransformPoints,
+      RasterizeSpan,
+      SampleTexture,
+      SampleTextureBilinear,
+      nullptr, // SampleBlocks
+      nullptr, // SampleBlocksBilinear
+      BlendColors,
+      PackColors
+   };
+}
+
+Kernels::Table const* Kernels::AVX512Table () { return &TABLE; }
+
+#else
+
+Kernels::Table const* Kernels::AVX512Table () { return nullptr; }
+
+#endif
@@ -0,0 +1,443 @@
+#include "Kernels.hpp"
+
+/**
+ * 4-wide kernels. Only this header and intrinsics may be included; cf. Kernels.hpp.
+ */
+
+#if defined(__SSE4_2__) || (defined(_MSC_VER) && (defined(_M_X64) || _M_IX86_FP >= 2))
+
+#include <nmmintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+   constexpr int WIDTH = 4;
+
+   int LowestBit (unsigned const mask)
+   {
+#ifdef _MSC_VER
+      unsigned long index;
+      _BitScanForward(&index, mask);
+      return int(index);
+#else
+      return __builtin_ctz(mask);
+#endif
+   }
+
+   /**
+    * start + k * step, for the 4 pixels from the k-th one on
+    */
+   __m128 Affine (float const start, float const step, __m128 const k)
+   {
+      return _mm_add_ps(_mm_set1_ps(start), _mm_mul_ps(k, _mm_set1_ps(step)));
+   }
+
+   __m128 Log2 (__m128 const x)
+   {
+      __m128i const bits = _mm_castps_si128(x);
+      __m128 const exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+      __m128 const mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+
+      // Minimax polynomial for log2(m) / (m - 1) over [1, 2); cf. J. Fonseca, "Fast SSE2 pow"
+      __m128 p = _mm_set1_ps(0.0596515482674574969533f);
+      p = _mm_add_ps(_mm_mul_ps(p, mantissa), _mm_set1_ps(-0.465725644288844778798f));
+      p = _mm_add_ps(_mm_mul_ps(p, mantissa), _mm_set1_ps(1.48116647521213171641f));
+      p = _mm_add_ps(_mm_mul_ps(p, mantissa), _mm_set1_ps(-2.52074962577807006663f));
+      p = _mm_add_ps(_mm_mul_ps(p, mantissa), _mm_set1_ps(2.8882704548164776201f));
+      return _mm_add_ps(_mm_mul_ps(p, _mm_sub_ps(mantissa, _mm_set1_ps(1.f))), exponent);
+   }
+
+   __m128 Exp2 (__m128 x)
+   {
+      x = _mm_max_ps(_mm_min_ps(x, _mm_set1_ps(127.99999f)), _mm_set1_ps(-126.99999f));
+      __m128 const whole = _mm_floor_ps(x);
+      __m128 const fraction = _mm_sub_ps(x, whole);
+      __m128 const scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(whole), _mm_set1_epi32(127)), 23));
+
+      // Minimax polynomial for 2^f over [0, 1)
+      __m128 p = _mm_set1_ps(1.8775767e-3f);
+      p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(8.9893397e-3f));
+      p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(5.5826318e-2f));
+      p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(2.4015361e-1f));
+      p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(6.9315308e-1f));
+      p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(9.9999994e-1f));
+      return _mm_mul_ps(p, scale);
+   }
+
+   /**
+    * i^2.2 for i in [0, 1]
+    */
+   __m128 Gamma (__m128 const i)
+   {
+      __m128 const c = Exp2(_mm_mul_ps(Log2(i), _mm_set1_ps(2.2f)));
+      return _mm_and_ps(c, _mm_cmpgt_ps(i, _mm_setzero_ps()));
+   }
+
+   void Fill (uint32_t* dst, uint32_t const value, size_t const count)
+   {
+      __m128i const v = _mm_set1_epi32(int(value));
+      size_t i = 0;
+      for (; i + WIDTH <= count; i += WIDTH)
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+      for (; i < count; ++i)
+         dst[i] = value;
+   }
+
+   void TransformPoints (float const* m, void const* points, size_t const stride, size_t const count, float* clip)
+   {
+      // Columns of the matrix, to be weighted by each coordinate
+      __m128 c0 = _mm_loadu_ps(m), c1 = _mm_loadu_ps(m + 4), c2 = _mm_loadu_ps(m + 8), c3 = _mm_loadu_ps(m + 12);
+      _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+      char const* point = static_cast<char const*>(points);
+      for (size_t i = 0; i < count; ++i, point += stride, clip += 4)
+      {
+         float const* p = reinterpret_cast<float const*>(point);
+         __m128 r = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p[0])), _mm_mul_ps(c1, _mm_set1_ps(p[1])));
+         r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(p[2])));
+         r = _mm_add_ps(r, c3);
+         _mm_store_ps(clip, r);
+      }
+   }
+
+   uint32_t RasterizeSpan (Kernels::Span const& s, float* depth, Kernels::Fragments const& out)
+   {
+      __m128 const lanes = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+      __m128 const zero = _mm_setzero_ps(), nearest = _mm_set1_ps(-1.f), farthest = _mm_set1_ps(1.f);
+
+      alignas(16) float us[WIDTH], vs[WIDTH], is[WIDTH];
+      alignas(16) float padding[WIDTH];
+
+      uint32_t n = 0;
+      for (uint32_t x = 0; x < s.count; x += WIDTH)
+      {
+         // The last pixels work on a copy of the depths, padded with values that no pixel can pass
+         uint32_t const remaining = s.count - x;
+         float* d = depth + x;
+         if (remaining < WIDTH)
+         {
+            for (uint32_t j = 0; j < WIDTH; ++j)
+               padding[j] = j < remaining ? d[j] : -2.f;
+            d = padding;
+         }
+
+         __m128 const k = _mm_add_ps(_mm_set1_ps(float(x)), lanes);
+         __m128 const inside = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(Affine(s.l0, s.dl0, k), zero), _mm_cmpge_ps(Affine(s.l1, s.dl1, k), zero)),
+            _mm_cmpge_ps(Affine(s.l2, s.dl2, k), zero)
+         );
+         if (!_mm_movemask_ps(inside)) continue;
+
+         __m128 const z = Affine(s.z, s.dz, k);
+         __m128 const old = _mm_loadu_ps(d);
+         __m128 const pass = _mm_and_ps(
+            _mm_and_ps(inside, _mm_cmple_ps(z, old)),
+            _mm_and_ps(_mm_cmpge_ps(z, nearest), _mm_cmple_ps(z, farthest))
+         );
+         unsigned mask = unsigned(_mm_movemask_ps(pass));
+         if (!mask) continue;
+
+         _mm_storeu_ps(d, _mm_blendv_ps(old, z, pass));
+         if (d == padding)
+         {
+            for (uint32_t j = 0; j < remaining; ++j)
+               depth[x + j] = padding[j];
+         }
+
+         _mm_store_ps(us, Affine(s.u, s.du, k));
+         _mm_store_ps(vs, Affine(s.v, s.dv, k));
+         _mm_store_ps(is, Affine(s.intensity, s.dintensity, k));
+         for (; mask; mask &= mask - 1, ++n)
+         {
+            int const j = LowestBit(mask);
+            out.offsets[n] = x + j;
+            out.u[n] = us[j];
+            out.v[n] = vs[j];
+            out.intensities[n] = is[j];
+         }
+      }
+      return n;
+   }
+
+   /**
+    * Index of texel (x, y) in 4x4 tiles; cf. Kernels::Texels
+    */
+   __m128i TexelIndex (__m128i const x, __m128i const y, __m128i const tilesPerRow)
+   {
+      __m128i const three = _mm_set1_epi32(3);
+      __m128i const tile = _mm_add_epi32(_mm_mullo_epi32(_mm_srli_epi32(y, 2), tilesPerRow), _mm_srli_epi32(x, 2));
+      __m128i const within = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(y, three), 2), _mm_and_si128(x, three));
+      return _mm_or_si128(_mm_slli_epi32(tile, 4), within);
+   }
+
+   /**
+    * pixels[index] for each lane; there's no gather instruction before AVX2
+    */
+   __m128i Gather (uint32_t const* pixels, __m128i const index)
+   {
+      return _mm_setr_epi32(int(pixels[_mm_extract_epi32(index, 0)]), int(pixels[_mm_extract_epi32(index, 1)]),
+         int(pixels[_mm_extract_epi32(index, 2)]), int(pixels[_mm_extract_epi32(index, 3)]));
+   }
+
+   /**
+    * Texel coordinates clamped to Kernels::TEXEL_COORDINATE_LIMIT; NaNs end up at -limit
+    */
+   __m128 ClampCoordinate (__m128 const x)
+   {
+      return _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-Kernels::TEXEL_COORDINATE_LIMIT)), _mm_set1_ps(Kernels::TEXEL_COORDINATE_LIMIT));
+   }
+
+   /**
+    * Wraps texel coordinates into [0, size) along one axis of a texture, as its addressing mode says
+    */
+   struct Axis
+   {
+      Kernels::Address address;
+      bool powerOfTwo;
+      __m128i last; // size - 1
+      __m128i period, periodLast; // the texture repeats every size texels, or every 2 * size when mirrored
+      __m128 inversePeriod;
+
+      Axis (Kernels::Address const mode, uint32_t const size)
+         : address(mode), powerOfTwo((size & (size - 1)) == 0), last(_mm_set1_epi32(int(size - 1)))
+      {
+         int const p = int(mode == Kernels::Address::MIRROR ? 2 * size : size);
+         period = _mm_set1_epi32(p);
+         periodLast = _mm_set1_epi32(p - 1);
+         inversePeriod = _mm_set1_ps(1.f / float(p));
+      }
+
+      __m128i Wrap (__m128i const i) const
+      {
+         __m128i const zero = _mm_setzero_si128();
+         if (address == Kernels::Address::CLAMP)
+            return _mm_min_epi32(_mm_max_epi32(i, zero), last);
+
+         __m128i m;
+         if (powerOfTwo)
+         {
+            m = _mm_and_si128(i, periodLast);
+         }
+         else
+         {
+            // No integer division: the quotient comes from floats, and may be off by one, which the remainder then
+            // gives away by being out of [0, period)
+            __m128i const q = _mm_cvttps_epi32(_mm_floor_ps(_mm_mul_ps(_mm_cvtepi32_ps(i), inversePeriod)));
+            m = _mm_sub_epi32(i, _mm_mullo_epi32(q, period));
+            m = _mm_add_epi32(m, _mm_and_si128(_mm_cmplt_epi32(m, zero), period));
+            m = _mm_sub_epi32(m, _mm_andnot_si128(_mm_cmplt_epi32(m, period), period));
+         }
+         return address == Kernels::Address::MIRROR ? _mm_min_epi32(m, _mm_sub_epi32(periodLast, m)) : m;
+      }
+   };
+
+   /**
+    * a + (b - a) * weight / 256, for every channel, with weights in [0, 256]; cf. the scalar Lerp
+    */
+   __m128i Lerp (__m128i const a, __m128i const b, __m128i const weight)
+   {
+      __m128i const channels = _mm_set1_epi32(0x00ff00ff), half = _mm_set1_epi32(0x00800080);
+      __m128i const inverse = _mm_sub_epi32(_mm_set1_epi32(256), weight);
+      __m128i const even = _mm_add_epi32(_mm_add_epi32(
+         _mm_mullo_epi32(_mm_and_si128(a, channels), inverse), _mm_mullo_epi32(_mm_and_si128(b, channels), weight)), half);
+      __m128i const odd = _mm_add_epi32(_mm_add_epi32(
+         _mm_mullo_epi32(_mm_and_si128(_mm_srli_epi32(a, 8), channels), inverse),
+         _mm_mullo_epi32(_mm_and_si128(_mm_srli_epi32(b, 8), channels), weight)), half);
+      return _mm_or_si128(_mm_and_si128(_mm_srli_epi32(even, 8), channels), _mm_andnot_si128(channels, odd));
+   }
+
+   /**
+    * Stores the first `count` lanes, up to all of them
+    */
+   void Store (uint32_t* out, __m128i const values, size_t const count)
+   {
+      if (count >= WIDTH)
+      {
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(out), values);
+         return;
+      }
+
+      alignas(16) uint32_t lanes[WIDTH];
+      _mm_store_si128(reinterpret_cast<__m128i*>(lanes), values);
+      for (size_t j = 0; j < count; ++j)
+         out[j] = lanes[j];
+   }
+
+   void SampleTexture (Kernels::Texels const& t, float const* u, float const* v, size_t const count, uint32_t* colors)
+   {
+      __m128 const width = _mm_set1_ps(float(t.width)), height = _mm_set1_ps(float(t.height));
+      __m128 const one = _mm_set1_ps(1.f);
+      __m128i const tilesPerRow = _mm_set1_epi32(int((t.width + 3) / 4));
+      Axis const axisU(t.addressU, t.width), axisV(t.addressV, t.height);
+
+      alignas(16) float paddedU[WIDTH], paddedV[WIDTH];
+
+      for (size_t i = 0; i < count; i += WIDTH)
+      {
+         size_t const remaining = count - i;
+         float const* pu = u + i;
+         float const* pv = v + i;
+         if (remaining < WIDTH)
+         {
+            for (size_t j = 0; j < WIDTH; ++j)
+            {
+               paddedU[j] = j < remaining ? pu[j] : 0.f;
+               paddedV[j] = j < remaining ? pv[j] : 0.f;
+            }
+            pu = paddedU;
+            pv = paddedV;
+         }
+
+         __m128 const x = _mm_floor_ps(ClampCoordinate(_mm_mul_ps(_mm_loadu_ps(pu), width)));
+         __m128 const y = _mm_floor_ps(ClampCoordinate(_mm_mul_ps(_mm_sub_ps(one, _mm_loadu_ps(pv)), height)));
+         __m128i const index = TexelIndex(axisU.Wrap(_mm_cvttps_epi32(x)), axisV.Wrap(_mm_cvttps_epi32(y)), tilesPerRow);
+         Store(colors + i, Gather(t.pixels, index), remaining);
+      }
+   }
+
+   void SampleTextureBilinear (Kernels::Texels const& t, float const* u, float const* v, size_t const count, uint32_t* colors)
+   {
+      // Half a texel's offset, applied to uv before scaling; cf. the scalar kernel
+      __m128 const width = _mm_set1_ps(float(t.width)), height = _mm_set1_ps(float(t.height));
+      __m128 const uOffset = _mm_set1_ps(0.5f / t.width), vOffset = _mm_set1_ps(1.f - 0.5f / t.height);
+      __m128 const scale = _mm_set1_ps(256.f), half = _mm_set1_ps(0.5f);
+      __m128i const one = _mm_set1_epi32(1);
+      __m128i const tilesPerRow = _mm_set1_epi32(int((t.width + 3) / 4));
+      Axis const axisU(t.addressU, t.width), axisV(t.addressV, t.height);
+
+      alignas(16) float paddedU[WIDTH], paddedV[WIDTH];
+
+      for (size_t i = 0; i < count; i += WIDTH)
+      {
+         size_t const remaining = count - i;
+         float const* pu = u + i;
+         float const* pv = v + i;
+         if (remaining < WIDTH)
+         {
+            for (size_t j = 0; j < WIDTH; ++j)
+            {
+               paddedU[j] = j < remaining ? pu[j] : 0.f;
+               paddedV[j] = j < remaining ? pv[j] : 0.f;
+            }
+            pu = paddedU;
+            pv = paddedV;
+         }
+
+         __m128 const x = ClampCoordinate(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pu), uOffset), width));
+         __m128 const y = ClampCoordinate(_mm_mul_ps(_mm_sub_ps(vOffset, _mm_loadu_ps(pv)), height));
+         __m128 const left = _mm_floor_ps(x), top = _mm_floor_ps(y);
+         __m128i const wx = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(x, left), scale), half));
+         __m128i const wy = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(y, top), scale), half));
+
+         __m128i const x0 = _mm_cvttps_epi32(left), y0 = _mm_cvttps_epi32(top);
+         __m128i const x1 = axisU.Wrap(_mm_add_epi32(x0, one)), y1 = axisV.Wrap(_mm_add_epi32(y0, one));
+         __m128i const wrappedX0 = axisU.Wrap(x0), wrappedY0 = axisV.Wrap(y0);
+         __m128i const c00 = Gather(t.pixels, TexelIndex(wrappedX0, wrappedY0, tilesPerRow));
+         __m128i const c10 = Gather(t.pixels, TexelIndex(x1, wrappedY0, tilesPerRow));
+         __m128i const c01 = Gather(t.pixels, TexelIndex(wrappedX0, y1, tilesPerRow));
+         __m128i const c11 = Gather(t.pixels, TexelIndex(x1, y1, tilesPerRow));
+         Store(colors + i, Lerp(Lerp(c00, c10, wx), Lerp(c01, c11, wx), wy), remaining);
+      }
+   }
+
+   void BlendColors (uint32_t const* a, uint32_t const* b, float const weight, size_t const count, uint32_t* out)
+   {
+      __m128i const w = _mm_set1_epi32(int(weight * 256.f + 0.5f));
+
+      alignas(16) uint32_t paddedA[WIDTH], paddedB[WIDTH];
+
+      for (size_t i = 0; i < count; i += WIDTH)
+      {
+         size_t const remaining = count - i;
+         uint32_t const* pa = a + i;
+         uint32_t const* pb = b + i;
+         if (remaining < WIDTH)
+         {
+            for (size_t j = 0; j < WIDTH; ++j)
+            {
+               paddedA[j] = j < remaining ? pa[j] : 0;
+               paddedB[j] = j < remaining ? pb[j] : 0;
+            }
+            pa = paddedA;
+            pb = paddedB;
+         }
+
+         __m128i const blended = Lerp(_mm_loadu_si128(reinterpret_cast<__m128i const*>(pa)), _mm_loadu_si128(reinterpret_cast<__m128i const*>(pb)), w);
+         Store(out + i, blended, remaining);
+      }
+   }
+
+   void PackColors (uint32_t const* colors, float const* intensities, size_t const count, uint32_t* out)
+   {
+      __m128i const byte = _mm_set1_epi32(0xff);
+      __m128 const zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), half = _mm_set1_ps(0.5f);
+
+      alignas(16) uint32_t paddedColors[WIDTH], packed[WIDTH];
+      alignas(16) float paddedIntensities[WIDTH];
+
+      for (size_t i = 0; i < count; i += WIDTH)
+      {
+         size_t const remaining = count - i;
+         uint32_t const* pc = colors + i;
+         float const* pi = intensities + i;
+         if (remaining < WIDTH)
+         {
+            for (size_t j = 0; j < WIDTH; ++j)
+            {
+               paddedColors[j] = j < remaining ? pc[j] : 0;
+               paddedIntensities[j] = j < remaining ? pi[j] : 0.f;
+            }
+            pc = paddedColors;
+            pi = paddedIntensities;
+         }
+
+         __m128 const c = Gamma(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(pi), zero), one));
+         __m128i const color = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pc));
+
+         // Rounded to nearest, like roundf(), by truncating after adding one half
+         __m128i const r = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(color, 24)), c), half));
+         __m128i const g = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(color, 16), byte)), c), half));
+         __m128i const b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(color, 8), byte)), c), half));
+
+         __m128i const result = _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi32(_mm_min_epi32(r, byte), 24), _mm_slli_epi32(_mm_min_epi32(g, byte), 16)),
+            _mm_or_si128(_mm_slli_epi32(_mm_min_epi32(b, byte), 8), byte)
+         );
+
+         if (remaining < WIDTH)
+         {
+            _mm_store_si128(reinterpret_cast<__m128i*>(packed), result);
+            for (size_t j = 0; j < remaining; ++j)
+               out[i + j] = packed[j];
+         }
+         else
+         {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), result);
+         }
+      }
+   }
+
+   Kernels::Table const TABLE = {
+      Kernels::Level::SSE42,
+      Fill,
+      TransformPoints,
+      RasterizeSpan,
+      SampleTexture,
+      SampleTextureBilinear,
+      nullptr, // SampleBlocks
+      nullptr, // SampleBlocksBilinear
+      BlendColors,
+      PackColors
+   };
+}
+
+Kernels::Table const* Kernels::SSE42Table () { return &TABLE; }
+
+#else
+
+Kernels::Table const* Kernels::SSE42Table () { return nullptr; }
+
+#endif
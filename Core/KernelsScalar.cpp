@@ -0,0 +1,212 @@
+#include "Kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "global.hpp"
+#include "Color.hpp"
+#include "TextureCompression.hpp"
+
+/**
+ * Reference implementations, which the others must agree with. Built with the default flags, so, unlike the other
+ * instruction sets, this file may use any header.
+ */
+
+namespace
+{
+   void Fill (uint32_t* dst, uint32_t const value, size_t const count)
+   {
+      std::fill_n(dst, count, value);
+   }
+
+   void TransformPoints (float const* m, void const* points, size_t const stride, size_t const count, float* clip)
+   {
+      for (size_t i = 0; i < count; ++i, clip += 4)
+      {
+         float const* p = reinterpret_cast<float const*>(static_cast<char const*>(points) + i * stride);
+         for (uint r = 0; r < 4; ++r)
+            clip[r] = m[4*r] * p[0] + m[4*r + 1] * p[1] + m[4*r + 2] * p[2] + m[4*r + 3];
+      }
+   }
+
+   uint32_t RasterizeSpan (Kernels::Span const& s, float* depth, Kernels::Fragments const& out)
+   {
+      uint32_t n = 0;
+      for (uint32_t x = 0; x < s.count; ++x)
+      {
+         // Evaluated afresh at every pixel rather than accumulated, so that errors don't build up along the row
+         float const k = float(x);
+         if (s.l0 + k * s.dl0 < 0 || s.l1 + k * s.dl1 < 0 || s.l2 + k * s.dl2 < 0) continue;
+
+         float const z = s.z + k * s.dz;
+         if (z < -1 || z > 1 || z > depth[x]) continue;
+
+         depth[x] = z;
+         out.offsets[n] = x;
+         out.u[n] = s.u + k * s.du;
+         out.v[n] = s.v + k * s.dv;
+         out.intensities[n] = s.intensity + k * s.dintensity;
+         ++n;
+      }
+      return n;
+   }
+
+   /**
+    * Index of texel (x, y) in 4x4 tiles; cf. Kernels::Texels
+    */
+   uint32_t TexelIndex (Kernels::Texels const& t, uint32_t const x, uint32_t const y)
+   {
+      uint32_t const tilesPerRow = (t.width + 3) / 4;
+      return (((y >> 2) * tilesPerRow + (x >> 2)) << 4) | ((y & 3) << 2) | (x & 3);
+   }
+
+   /**
+    * Texel coordinate clamped to Kernels::TEXEL_COORDINATE_LIMIT. Written so that NaNs end up at -limit, just like
+    * with the SIMD min/max instructions.
+    */
+   float ClampCoordinate (float x)
+   {
+      float const limit = Kernels::TEXEL_COORDINATE_LIMIT;
+      x = x > -limit ? x : -limit;
+      return x < limit ? x : limit;
+   }
+
+   /**
+    * Texel coordinate i wrapped into [0, size), as the addressing mode says
+    */
+   uint32_t Wrap (int32_t const i, uint32_t const size, Kernels::Address const address)
+   {
+      int32_t const n = int32_t(size);
+      if (address == Kernels::Address::CLAMP)
+         return uint32_t(std::min(std::max(i, 0), n - 1));
+
+      // The texture repeats every size texels, or every 2 * size when mirrored
+      int32_t const period = address == Kernels::Address::MIRROR ? 2 * n : n;
+      int32_t const m = (size & (size - 1)) == 0 ? i & (period - 1) : ((i % period) + period) % period;
+      return uint32_t(address == Kernels::Address::MIRROR ? std::min(m, period - 1 - m) : m);
+   }
+
+   /**
+    * Texel at a tiled index, from a block of a compressed texture, decoded through the cache
+    */
+   uint32_t FetchBlockTexel (Kernels::Texels const& t, Kernels::BlockCache & cache, uint32_t const index)
+   {
+      uint64_t const block = t.blocks[index >> 4];
+      // Fibonacci hashing: the top bits of the product depend on all of the block's
+      uint32_t const slot = uint32_t((block * 0x9E3779B97F4A7C15ull) >> 58);
+      static_assert(Kernels::BlockCache::SIZE == 64, "The hash must have as many values as the cache has slots");
+      if (cache.blocks[slot] != block)
+      {
+         TextureCompression::Decode(block, cache.texels[slot]);
+         cache.blocks[slot] = block;
+      }
+      return cache.texels[slot][index & 15];
+   }
+
+   template <typename Fetch>
+   void SampleNearest (Kernels::Texels const& t, float const* u, float const* v, size_t const count, uint32_t* colors,
+      Fetch const& fetch)
+   {
+      for (size_t i = 0; i < count; ++i)
+      {
+         uint32_t const x = Wrap(int32_t(std::floor(ClampCoordinate(u[i] * t.width))), t.width, t.addressU);
+         uint32_t const y = Wrap(int32_t(std::floor(ClampCoordinate((1.f - v[i]) * t.height))), t.height, t.addressV);
+         colors[i] = fetch(TexelIndex(t, x, y));
+      }
+   }
+
+   void SampleTexture (Kernels::Texels const& t, float const* u, float const* v, size_t const count, uint32_t* colors)
+   {
+      SampleNearest(t, u, v, count, colors, [&t](uint32_t const index) { return t.pixels[index]; });
+   }
+
+   void SampleBlocks (Kernels::Texels const& t, Kernels::BlockCache & cache, float const* u, float const* v,
+      size_t const count, uint32_t* colors)
+   {
+      SampleNearest(t, u, v, count, colors, [&](uint32_t const index) { return FetchBlockTexel(t, cache, index); });
+   }
+
+   /**
+    * a + (b - a) * weight / 256, for every channel, rounded to nearest, with weight in [0, 256]. Works on two channels
+    * at a time, one per 16 bits, which can't carry into each other as a * (256 - weight) + b * weight < 2^16.
+    */
+   uint32_t Lerp (uint32_t const a, uint32_t const b, uint32_t const weight)
+   {
+      uint32_t const channels = 0x00ff00ff, half = 0x00800080;
+      uint32_t const even = (a & channels) * (256 - weight) + (b & channels) * weight + half;
+      uint32_t const odd = ((a >> 8) & channels) * (256 - weight) + ((b >> 8) & channels) * weight + half;
+      return ((even >> 8) & channels) | (odd & ~channels);
+   }
+
+   template <typename Fetch>
+   void SampleBilinear (Kernels::Texels const& t, float const* u, float const* v, size_t const count, uint32_t* colors,
+      Fetch const& fetch)
+   {
+      // Texel centres are at half-integer coordinates. Offsetting uv by half a texel before scaling it, rather than
+      // the coordinates after, leaves no multiply-add for the compiler to fuse, so every instruction set rounds alike.
+      float const uOffset = 0.5f / t.width, vOffset = 1.f - 0.5f / t.height;
+      for (size_t i = 0; i < count; ++i)
+      {
+         float const x = ClampCoordinate((u[i] - uOffset) * t.width), y = ClampCoordinate((vOffset - v[i]) * t.height);
+         float const left = std::floor(x), top = std::floor(y);
+         uint32_t const wx = uint32_t((x - left) * 256.f + 0.5f), wy = uint32_t((y - top) * 256.f + 0.5f);
+
+         uint32_t const x0 = Wrap(int32_t(left), t.width, t.addressU), x1 = Wrap(int32_t(left) + 1, t.width, t.addressU);
+         uint32_t const y0 = Wrap(int32_t(top), t.height, t.addressV), y1 = Wrap(int32_t(top) + 1, t.height, t.addressV);
+         uint32_t const c00 = fetch(TexelIndex(t, x0, y0)), c10 = fetch(TexelIndex(t, x1, y0));
+         uint32_t const c01 = fetch(TexelIndex(t, x0, y1)), c11 = fetch(TexelIndex(t, x1, y1));
+         colors[i] = Lerp(Lerp(c00, c10, wx), Lerp(c01, c11, wx), wy);
+      }
+   }
+
+   void SampleTextureBilinear (Kernels::Texels const& t, float const* u, float const* v, size_t const count, uint32_t* colors)
+   {
+      SampleBilinear(t, u, v, count, colors, [&t](uint32_t const index) { return t.pixels[index]; });
+   }
+
+   void SampleBlocksBilinear (Kernels::Texels const& t, Kernels::BlockCache & cache, float const* u, float const* v,
+      size_t const count, uint32_t* colors)
+   {
+      SampleBilinear(t, u, v, count, colors, [&](uint32_t const index) { return FetchBlockTexel(t, cache, index); });
+   }
+
+   void BlendColors (uint32_t const* a, uint32_t const* b, float const weight, size_t const count, uint32_t* out)
+   {
+      uint32_t const w = uint32_t(weight * 256.f + 0.5f);
+      for (size_t i = 0; i < count; ++i)
+         out[i] = Lerp(a[i], b[i], w);
+   }
+
+   void PackColors (uint32_t const* colors, float const* intensities, size_t const count, uint32_t* out)
+   {
+      for (size_t i = 0; i < count; ++i)
+         out[i] = Color::Intensify(colors[i], std::min(std::max(intensities[i], 0.f), 1.f));
+   }
+
+   Kernels::Table const TABLE = {
+      Kernels::Level::SCALAR,
+      Fill,
+      TransformPoints,
+      RasterizeSpan,
+      SampleTexture,
+      SampleTextureBilinear,
+      SampleBlocks,
+      SampleBlocksBilinear,
+      BlendColors,
+      PackColors
+   };
+}
+
+Kernels::BlockCache::BlockCache ()
+{
+   // Every slot holds block 0, decoded, so that no lookup can match a slot that was never filled
+   uint32_t zero[16];
+   TextureCompression::Decode(0, zero);
+   for (uint32_t slot = 0; slot < SIZE; ++slot)
+   {
+      blocks[slot] = 0;
+      std::copy_n(zero, 16, texels[slot]);
+   }
+}
+
+Kernels::Table const* Kernels::ScalarTable () { return &TABLE; }
@@ -0,0 +1,225 @@
+#include "OcclusionBuffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "SIMD.hpp"
+#include "Kernels.hpp"
+
+static_assert(OcclusionBuffer::WIDTH % 4 == 0, "Rows are processed 4 pixels at a time");
+
+namespace
+{
+   constexpr float EMPTY_DEPTH = std::numeric_limits<float>::max();
+
+   /**
+    * Edge function E(x, y) = a*x + b*y + c, which is positive to the left of the directed edge from p to q
+    */
+   struct Edge
+   {
+      float a, b, c;
+
+      Edge (Vector3 const& p, Vector3 const& q)
+         : a(p.y - q.y)
+         , b(q.x - p.x)
+         , c(p.x * q.y - p.y * q.x)
+      {}
+
+      float operator() (float const x, float const y) const { return a * x + b * y + c; }
+   };
+
+   /**
+    * Clip space to buffer space: x and y in pixels, z in NDC
+    */
+   Vector3 ToBuffer (Vector4 const& clip)
+   {
+      float const w = 1.f / clip.w;
+      return Vector3(
+         (clip.x * w * 0.5f + 0.5f) * OcclusionBuffer::WIDTH,
+         (clip.y * w * 0.5f + 0.5f) * OcclusionBuffer::HEIGHT,
+         clip.z * w
+      );
+   }
+}
+
+OcclusionBuffer::OcclusionBuffer ()
+   : m_depth(WIDTH * HEIGHT, EMPTY_DEPTH)
+{}
+
+void OcclusionBuffer::Clear ()
+{
+   if (m_empty) return;
+
+   uint32_t emptyBits;
+   memcpy(&emptyBits, &EMPTY_DEPTH, sizeof(emptyBits));
+   Kernels::Active().Fill(reinterpret_cast<uint32_t*>(m_depth.data()), emptyBits, m_depth.size());
+   m_empty = true;
+}
+
+void OcclusionBuffer::DrawOccluder (Mesh const& mesh, Matrix4 const& projectionViewModelMatrix)
+{
+   auto const TransformPoints = Kernels::Active().TransformPoints;
+   Vector4 clip[3];
+   for (auto const& face : mesh.GetFaces())
+   {
+      TransformPoints(&projectionViewModelMatrix.Row(0).x, &face[0].xyz().x, sizeof(Mesh::Triangle::Vertex), 3, &clip[0].x);
+      DrawTriangle(clip[0], clip[1], clip[2]);
+   }
+}
+
+void OcclusionBuffer::DrawTriangle (Vector4 const& c0, Vector4 const& c1, Vector4 const& c2)
+{
+   // Anything in front of the near plane would need clipping; simply not occluding with it is the conservative choice
+   if (c0.z < -c0.w || c1.z < -c1.w || c2.z < -c2.w) return;
+
+   Vector3 v0 = ToBuffer(c0), v1 = ToBuffer(c1), v2 = ToBuffer(c2);
+
+   // Occluders are drawn from both sides, which lets single-sided geometry such as walls occlude too
+   float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+   if (area == 0.f || area != area) return;
+   if (area < 0.f)
+   {
+      std::swap(v1, v2);
+      area = -area;
+   }
+
+   int const xMin = std::max(0, int(std::floor(std::min({v0.x, v1.x, v2.x}))));
+   int const xMax = std::min(int(WIDTH) - 1, int(std::ceil(std::max({v0.x, v1.x, v2.x}))));
+   int const yMin = std::max(0, int(std::floor(std::min({v0.y, v1.y, v2.y}))));
+   int const yMax = std::min(int(HEIGHT) - 1, int(std::ceil(std::max({v0.y, v1.y, v2.y}))));
+   if (xMin > xMax || yMin > yMax) return;
+
+   // Edge i is opposite vertex i, so that E_i / area is the barycentric coordinate of vertex i
+   Edge e0(v1, v2), e1(v2, v0), e2(v0, v1);
+
+   // Depth is affine in screen space; its farthest value within a pixel is half a pixel's worth of slope away from the center
+   float const invArea = 1.f / area;
+   float const dzdx = (e0.a * v0.z + e1.a * v1.z + e2.a * v2.z) * invArea;
+   float const dzdy = (e0.b * v0.z + e1.b * v1.z + e2.b * v2.z) * invArea;
+   float const z_c = (e0.c * v0.z + e1.c * v1.z + e2.c * v2.z) * invArea + 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+   float const zFarthest = std::max({v0.z, v1.z, v2.z});
+
+   // A pixel is entirely covered iff its center is inside every edge by at least half its extent along the edge normal
+   e0.c -= 0.5f * (std::fabs(e0.a) + std::fabs(e0.b));
+   e1.c -= 0.5f * (std::fabs(e1.a) + std::fabs(e1.b));
+   e2.c -= 0.5f * (std::fabs(e2.a) + std::fabs(e2.b));
+
+   int const xStart = xMin & ~3; // rows are always processed in aligned groups of 4 pixels
+
+#ifdef SIMD_SSE2
+   __m128 const lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f); // pixel centers
+   __m128 const e0a = _mm_set1_ps(e0.a), e1a = _mm_set1_ps(e1.a), e2a = _mm_set1_ps(e2.a);
+   __m128 const e0Step = _mm_set1_ps(4 * e0.a), e1Step = _mm_set1_ps(4 * e1.a), e2Step = _mm_set1_ps(4 * e2.a);
+   __m128 const zStep = _mm_set1_ps(4 * dzdx);
+   __m128 const zFar = _mm_set1_ps(zFarthest);
+   __m128 const zero = _mm_setzero_ps();
+
+   for (int y = yMin; y <= yMax; ++y)
+   {
+      float const cy = y + 0.5f, x0 = float(xStart);
+      __m128 const xs = _mm_add_ps(_mm_set1_ps(x0), lanes);
+      __m128 w0 = _mm_add_ps(_mm_mul_ps(e0a, xs), _mm_set1_ps(e0.b * cy + e0.c));
+      __m128 w1 = _mm_add_ps(_mm_mul_ps(e1a, xs), _mm_set1_ps(e1.b * cy + e1.c));
+      __m128 w2 = _mm_add_ps(_mm_mul_ps(e2a, xs), _mm_set1_ps(e2.b * cy + e2.c));
+      __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), xs), _mm_set1_ps(dzdy * cy + z_c));
+
+      float* row = &m_depth[y * WIDTH];
+      for (int x = xStart; x <= xMax; x += 4)
+      {
+         __m128 const inside = _mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_and_ps(_mm_cmpge_ps(w1, zero), _mm_cmpge_ps(w2, zero)));
+         if (_mm_movemask_ps(inside))
+         {
+            __m128 const old = _mm_loadu_ps(row + x);
+            __m128 const candidate = _mm_min_ps(old, _mm_min_ps(z, zFar));
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, candidate), _mm_andnot_ps(inside, old)));
+         }
+
+         w0 = _mm_add_ps(w0, e0Step);
+         w1 = _mm_add_ps(w1, e1Step);
+         w2 = _mm_add_ps(w2, e2Step);
+         z = _mm_add_ps(z, zStep);
+      }
+   }
+#else
+   for (int y = yMin; y <= yMax; ++y)
+   {
+      float const cy = y + 0.5f;
+      float* row = &m_depth[y * WIDTH];
+      for (int x = xStart; x <= xMax; ++x)
+      {
+         float const cx = x + 0.5f;
+         if (e0(cx, cy) >= 0 && e1(cx, cy) >= 0 && e2(cx, cy) >= 0)
+         {
+            float const z = std::min(dzdx * cx + dzdy * cy + z_c, zFarthest);
+            row[x] = std::min(row[x], z);
+         }
+      }
+   }
+#endif
+
+   m_empty = false;
+}
+
+bool OcclusionBuffer::IsOccluded (AABB const& worldBounds, Matrix4 const& projectionViewMatrix) const
+{
+   if (m_empty || worldBounds.Empty()) return false;
+
+   // Screen-space rectangle and nearest depth of the box's 8 corners
+   float xMinF = std::numeric_limits<float>::max(), yMinF = xMinF, zNearest = xMinF;
+   float xMaxF = std::numeric_limits<float>::lowest(), yMaxF = xMaxF;
+   for (uint i = 0; i < 8; ++i)
+   {
+      Vector3 const corner(
+         (i & 1) ? worldBounds.max.x : worldBounds.min.x,
+         (i & 2) ? worldBounds.max.y : worldBounds.min.y,
+         (i & 4) ? worldBounds.max.z : worldBounds.min.z
+      );
+      Vector4 const clip = projectionViewMatrix * HomoVector(corner);
+
+      // Boxes crossing the near plane cover a good part of the screen, and can't be projected anyway
+      if (clip.z < -clip.w) return false;
+
+      Vector3 const p = ToBuffer(clip);
+      xMinF = std::min(xMinF, p.x); xMaxF = std::max(xMaxF, p.x);
+      yMinF = std::min(yMinF, p.y); yMaxF = std::max(yMaxF, p.y);
+      zNearest = std::min(zNearest, p.z);
+   }
+
+   // Every pixel the rectangle touches, even partially, must be covered by something nearer
+   int const xMin = std::max(0, int(std::floor(xMinF)));
+   int const xMax = std::min(int(WIDTH) - 1, int(std::floor(xMaxF)));
+   int const yMin = std::max(0, int(std::floor(yMinF)));
+   int const yMax = std::min(int(HEIGHT) - 1, int(std::floor(yMaxF)));
+   if (xMin > xMax || yMin > yMax) return false; // off-screen; for frustum culling to decide
+
+#ifdef SIMD_SSE2
+   __m128 const nearest = _mm_set1_ps(zNearest);
+   __m128i const lanes = _mm_setr_epi32(0, 1, 2, 3);
+   int const xStart = xMin & ~3;
+   for (int y = yMin; y <= yMax; ++y)
+   {
+      float const* row = &m_depth[y * WIDTH];
+      for (int x = xStart; x <= xMax; x += 4)
+      {
+         // Lanes outside [xMin, xMax] are masked out
+         __m128i const xs = _mm_add_epi32(_mm_set1_epi32(x), lanes);
+         __m128i const outside = _mm_or_si128(_mm_cmplt_epi32(xs, _mm_set1_epi32(xMin)), _mm_cmpgt_epi32(xs, _mm_set1_epi32(xMax)));
+         __m128 const visible = _mm_andnot_ps(_mm_castsi128_ps(outside), _mm_cmpge_ps(_mm_loadu_ps(row + x), nearest));
+         if (_mm_movemask_ps(visible)) return false;
+      }
+   }
+#else
+   for (int y = yMin; y <= yMax; ++y)
+   {
+      float const* row = &m_depth[y * WIDTH];
+      for (int x = xMin; x <= xMax; ++x)
+      {
+         if (row[x] >= zNearest) return false;
+      }
+   }
+#endif
+
+   return true;
+}
@@ -0,0 +1,55 @@
+#ifndef OcclusionBuffer_hpp
+#define OcclusionBuffer_hpp
+
+#include "global.hpp"
+
+#include <vector>
+
+#include "Vector.hpp"
+#include "Matrix.hpp"
+#include "Bounds.hpp"
+#include "Mesh.hpp"
+
+/**
+ * Small, screen-aligned depth buffer into which a few large occluders are rasterized, so that objects
+ * hidden entirely behind them can be skipped before any of their faces are transformed.
+ *
+ * Both halves are conservative, such that an object is never wrongly reported as occluded:
+ *    - Occluders only write to pixels they cover entirely, and write the farthest depth they reach within each pixel.
+ *    - Objects are tested with the nearest depth of their bounds over their whole screen-space rectangle.
+ *
+ * Depths are NDC z values, i.e. -1 at the near plane and 1 at the far plane.
+ */
+class OcclusionBuffer
+{
+public:
+   static constexpr uint WIDTH = 256;
+   static constexpr uint HEIGHT = 128;
+
+   OcclusionBuffer ();
+
+   /**
+    * Forgets every occluder; must be called whenever the camera changes, i.e. once per frame
+    */
+   void Clear ();
+
+   /**
+    * Rasterizes every face of the mesh. Faces crossing the near plane are skipped rather than clipped.
+    */
+   void DrawOccluder (Mesh const& mesh, Matrix4 const& projectionViewModelMatrix);
+
+   /**
+    * Whether the given world-space box is entirely hidden behind the occluders drawn so far
+    */
+   bool IsOccluded (AABB const& worldBounds, Matrix4 const& projectionViewMatrix) const;
+
+   bool Empty () const { return m_empty; }
+
+private:
+   void DrawTriangle (Vector4 const& c0, Vector4 const& c1, Vector4 const& c2);
+
+   std::vector<float> m_depth; // row-major, row 0 at the bottom of the screen
+   bool m_empty = true;
+};
+
+#endif
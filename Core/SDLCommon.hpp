@@ -2,6 +2,7 @@
 #define SDLCommon_hpp
 
 #include <cassert>
+#include <utility>
 
 #include "SDL.h"
 
@@ -27,14 +28,35 @@ private:
 
 struct SDLTexture
 {
+   SDLTexture() : m_resource(nullptr)
+   {
+      /* do nothing */
+   }
+
    SDLTexture(SDL_Texture* p) : m_resource(p)
    {
       assert(p != nullptr);
    }
 
+   // Handed around by value, rather than shared through the heap
+   SDLTexture(SDLTexture && other) : m_resource(other.m_resource)
+   {
+      other.m_resource = nullptr;
+   }
+
+   SDLTexture & operator=(SDLTexture && other)
+   {
+      std::swap(m_resource, other.m_resource);
+      return *this;
+   }
+
+   SDLTexture(SDLTexture const&) = delete;
+   SDLTexture & operator=(SDLTexture const&) = delete;
+
    ~SDLTexture()
    {
-      SDL_DestroyTexture(m_resource);
+      if (m_resource != nullptr)
+         SDL_DestroyTexture(m_resource);
    }
 
    SDL_Texture* get() const { return m_resource; }
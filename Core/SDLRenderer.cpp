@@ -6,6 +6,8 @@
 #include "SDL_image.h"
 
 #include "Logger.hpp"
+#include "Kernels.hpp"
+#include "MemoryTracker.hpp"
 #include "LerpLineRasterizer.hpp"
 #include "BresenhamsLineRasterizer.hpp"
 #include "LerpTriangleRasterizer.hpp"
@@ -28,6 +30,8 @@ static void DumpSDLVersion ()
 
 void SDLRenderer::Initialize (std::string windowTitle, uint width, uint height, int windowFlags)
 {
+    MEMORY_SCOPE(RENDERER);
+
     // TODO: Doesn't show the version, not sure why
     // DumpSDLVersion();
 
@@ -119,18 +123,12 @@ void SDLRenderer::RenderFrame ()
     SDL_RenderPresent(m_pRenderer);
 
     // Reset all pixels to black
-    memset(m_pixels.data(), 0, m_WIDTH * m_HEIGHT * sizeof(ColorRGB));
+    FillScreenBackground(Color::Black);
 }
 
 void SDLRenderer::FillScreenBackground (ColorRGB color)
 {
-    for (uint w = 0; w < m_WIDTH; ++w)
-    {
-        for (uint h = 0; h < m_HEIGHT; ++h)
-        {
-            SetPixel(w, h, color);
-        }
-    }
+    Kernels::Active().Fill(m_pixels.data(), color, m_pixels.size());
 }
 
 void SDLRenderer::FlipFrameVertically ()
@@ -1,6 +1,8 @@
 #include "SDLTextFactory.hpp"
 
 #include <cassert>
+#include <fstream>
+#include <iterator>
 
 #include "Logger.hpp"
 
@@ -45,18 +47,41 @@ SDLTextFactory::~SDLTextFactory()
    TTF_Quit();
 }
 
-void SDLTextFactory::Initialize()
+void SDLTextFactory::Initialize(std::shared_ptr<AssetPack const> pPack)
 {
-   // Load up all font assets
-   // TODO: Reading and loading the font file every time when we want to use it is bad. We should optimize by loading the file blob into memory, then using SDL_RWops to create a stream from memory that can then be consumed by TTF_OpenFontRW
-   m_baseFonts.insert(std::make_pair(FontType::MONOSPACE, "fonts/monospace/monofont/MONOFONT.ttf"));
+   m_pPack = std::move(pPack);
+
+   // Load up all font assets. Fonts are opened at every size they're asked for, from memory rather than from their
+   // files every time.
+   m_baseFonts[FontType::MONOSPACE].path = "fonts/monospace/monofont/MONOFONT.TTF";
+
+   for (auto & entry : m_baseFonts)
+   {
+      FontFile & font = entry.second;
+      if (AssetPack::Asset const asset = m_pPack ? m_pPack->Find(font.path) : AssetPack::Asset())
+      {
+         font.data = asset.data;
+         font.size = asset.size;
+         continue;
+      }
+
+      std::ifstream file(font.path, std::ios::binary);
+      if (!file)
+      {
+         trclog("Could not read font at " << font.path << "!");
+         continue;
+      }
+      font.contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+      font.data = font.contents.data();
+      font.size = font.contents.size();
+   }
 }
 
 
-std::shared_ptr<SDLTexture> SDLTextFactory::DrawText(std::string const& text, int fontSize, FontStyle style)
+SDLTexture SDLTextFactory::DrawText(char const* text, int fontSize, FontStyle style)
 {
    if (!ready)
-      return nullptr;
+      return SDLTexture();
 
    // Prepare TTF_Font style flags
    int styleFlags = TTF_STYLE_NORMAL;
@@ -74,25 +99,27 @@ std::shared_ptr<SDLTexture> SDLTextFactory::DrawText(std::string const& text, in
    if (it == m_baseFonts.end())
    {
       trclog("Could not identify a font asset for type " << style.type << "!");
-      return nullptr;
+      return SDLTexture();
    }
-   std::string const& path = it->second;
-   TTFFont font(TTF_OpenFont(path.c_str(), fontSize));
+   FontFile const& file = it->second;
+   if (file.data == nullptr)
+      return SDLTexture();
+   TTFFont font(TTF_OpenFontRW(SDL_RWFromConstMem(file.data, int(file.size)), 1, fontSize));
    if (font.get() == nullptr)
    {
-      trclog("Failed to load font at " << path << "! TTF_OpenFont error: " << TTF_GetError());
-      return nullptr;
+      trclog("Failed to load font at " << file.path << "! TTF_OpenFontRW error: " << TTF_GetError());
+      return SDLTexture();
    }
    TTF_SetFontStyle(font.get(), styleFlags);
    
    // Render the given text with this font
-   SDLSurface surface(TTF_RenderText_Solid(font.get(), text.c_str(), SDLUtil::MakeSDLColor(style.color)));
+   SDLSurface surface(TTF_RenderText_Solid(font.get(), text, SDLUtil::MakeSDLColor(style.color)));
    
    // Return the ready-to-use texture
-   return std::make_shared<SDLTexture>(SDL_CreateTextureFromSurface(m_pRenderer, surface.get()));
+   return SDLTexture(SDL_CreateTextureFromSurface(m_pRenderer, surface.get()));
 }
 
-std::shared_ptr<SDLTexture> SDLTextFactory::DrawTextNormal(std::string const& text, int fontSize, ColorRGB color)
+SDLTexture SDLTextFactory::DrawTextNormal(char const* text, int fontSize, ColorRGB color)
 {
    return DrawText(text, fontSize, {
       FontType::MONOSPACE,
@@ -104,7 +131,7 @@ std::shared_ptr<SDLTexture> SDLTextFactory::DrawTextNormal(std::string const& te
    });
 }
 
-std::shared_ptr<SDLTexture> SDLTextFactory::DrawTextBold(std::string const& text, int fontSize, ColorRGB color)
+SDLTexture SDLTextFactory::DrawTextBold(char const* text, int fontSize, ColorRGB color)
 {
    return DrawText(text, fontSize, {
       FontType::MONOSPACE,
@@ -116,7 +143,7 @@ std::shared_ptr<SDLTexture> SDLTextFactory::DrawTextBold(std::string const& text
    });
 }
 
-std::shared_ptr<SDLTexture> SDLTextFactory::DrawTextItalic(std::string const& text, int fontSize, ColorRGB color)
+SDLTexture SDLTextFactory::DrawTextItalic(char const* text, int fontSize, ColorRGB color)
 {
    return DrawText(text, fontSize, {
       FontType::MONOSPACE,
@@ -128,7 +155,7 @@ std::shared_ptr<SDLTexture> SDLTextFactory::DrawTextItalic(std::string const& te
    });
 }
 
-std::shared_ptr<SDLTexture> SDLTextFactory::DrawTextBoldItalic(std::string const& text, int fontSize, ColorRGB color)
+SDLTexture SDLTextFactory::DrawTextBoldItalic(char const* text, int fontSize, ColorRGB color)
 {
    return DrawText(text, fontSize, {
       FontType::MONOSPACE,
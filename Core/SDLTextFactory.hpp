@@ -4,7 +4,9 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "AssetPack.hpp"
 #include "Color.hpp"
 #include "SDLCommon.hpp"
 
@@ -32,20 +34,40 @@ public:
 
    SDLTextFactory(SDL_Renderer* p);
    ~SDLTextFactory();
-   void Initialize();
+
+   /**
+    * Reads the fonts, from the pack if they're in it, or else from their files, once and for all
+    */
+   void Initialize(std::shared_ptr<AssetPack const> pPack=nullptr);
    
-   std::shared_ptr<SDLTexture> DrawText(std::string const& text, int fontSize, FontStyle style);
+   /**
+    * Renders the text into a new texture, owned by the caller; empty upon failure. Text is taken as a C string so
+    * that callers can format it into a buffer of their own instead of a heap-allocated string.
+    */
+   SDLTexture DrawText(char const* text, int fontSize, FontStyle style);
 
    // Sugar
-   std::shared_ptr<SDLTexture> DrawTextNormal(std::string const& text, int fontSize, ColorRGB color);
-   std::shared_ptr<SDLTexture> DrawTextBold(std::string const& text, int fontSize, ColorRGB color);
-   std::shared_ptr<SDLTexture> DrawTextItalic(std::string const& text, int fontSize, ColorRGB color);
-   std::shared_ptr<SDLTexture> DrawTextBoldItalic(std::string const& text, int fontSize, ColorRGB color);
+   SDLTexture DrawTextNormal(char const* text, int fontSize, ColorRGB color);
+   SDLTexture DrawTextBold(char const* text, int fontSize, ColorRGB color);
+   SDLTexture DrawTextItalic(char const* text, int fontSize, ColorRGB color);
+   SDLTexture DrawTextBoldItalic(char const* text, int fontSize, ColorRGB color);
 
 private:
    SDL_Renderer* m_pRenderer = nullptr;
 
-   std::unordered_map<FontType, std::string> m_baseFonts; // these are the assets loaded upon initialization
+   /**
+    * Contents of a font file, in memory, which every font made from it is opened from
+    */
+   struct FontFile
+   {
+      std::string path;
+      void const* data = nullptr; // in the pack, or else in `contents`
+      size_t size = 0;
+      std::vector<char> contents;
+   };
+
+   std::shared_ptr<AssetPack const> m_pPack;
+   std::unordered_map<FontType, FontFile> m_baseFonts; // these are the assets loaded upon initialization
 };
 
 #endif
\ No newline at end of file
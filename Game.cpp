@@ -6,11 +6,15 @@
 #include <iostream>
 #include <cstdlib>
 #include <ctime>
+#include <algorithm>
+#include <tuple>
+#include <cstring>
+#include <cstdio>
+#include <cassert>
 
 #ifdef WIN32
 #define NOMINMAX
 #include "Windows.h"
-#include <sstream>
 #endif
 
 #include "SDL.h"
@@ -29,9 +33,18 @@
 #include "LuaCameraFactory.hpp"
 #include "IObject3DFactory.hpp"
 #include "LuaObject3DFactory.hpp"
+#include "LuaCommandRecorder.hpp"
+#include "LuaSceneLoader.hpp"
+
+#include "Kernels.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include "MemoryTracker.hpp"
+#include "Logger.hpp"
 
 constexpr uint MAX_FPS = 240;
 constexpr uint MIN_FPS = 15;
+constexpr char const* MEMORY_DUMP_FILE = "memory.txt";
 
 Game::Game ()
     : m_targetFrameRate(60)
@@ -74,28 +87,37 @@ void Game::SetScreenHeight (float const height)
 
 void Game::RecreateZBuffer()
 {
+    MEMORY_SCOPE(RENDERER);
+
     // TODO: I don't like the Z-Buffer data structure being defined in this class...
     m_zBuffer = std::vector<float>(m_screenWidth * m_screenHeight); 
     ResetZBuffer();
+
+    // A row of a face can't be any wider than the screen
+    size_t const width = m_screenWidth;
+    m_rasterScratch.resize((uint(m_screenHeight) + BAND_HEIGHT - 1) / BAND_HEIGHT);
+    for (auto & scratch : m_rasterScratch)
+    {
+        scratch.fragmentOffsets.resize(width);
+        scratch.fragmentU.resize(width);
+        scratch.fragmentV.resize(width);
+        scratch.fragmentIntensities.resize(width);
+        scratch.fragmentColors.resize(width);
+        scratch.fragmentCoarseColors.resize(width);
+    }
 }
 
 void Game::ResetZBuffer ()
 {
-    // TODO: Investigate whether memset actually is more efficient than std::fill or not
-    // memset(m_zBuffer.data(), 0, sizeof(float) * m_zBuffer.size());
-    std::fill(m_zBuffer.begin(), m_zBuffer.end(), std::numeric_limits<float>::max()); // don't use `min()`, as it doesn't work as expected for floating-point type; cf. https://en.cppreference.com/w/cpp/types/numeric_limits/lowest);
+    float const farthest = std::numeric_limits<float>::max(); // don't use `min()`, as it doesn't work as expected for floating-point type; cf. https://en.cppreference.com/w/cpp/types/numeric_limits/lowest);
+    uint32_t farthestBits;
+    memcpy(&farthestBits, &farthest, sizeof(farthestBits));
+    Kernels::Active().Fill(reinterpret_cast<uint32_t*>(m_zBuffer.data()), farthestBits, m_zBuffer.size());
 }
 
-void Game::DrawReferenceCube (Vector3 const& center, float const s)
+void Game::DrawReferenceCube (CommandBuffer & commands, Vector3 const& center, float const s)
 {
-    Matrix4 const& viewMatrix = m_camera.ViewMatrix();
-    Matrix4 const& projectionMatrix = m_camera.ProjectionMatrix();
-    Matrix4 const& viewportMatrix = m_viewportMatrix;
-
     // Draw reference cube
-    std::array<Vector3, 9> pointsV;
-    std::array<Vector4, 9> pointsNDC;
-    std::array<Vector4, 9> pointsClip;
     std::array<Vector3, 9> points{
         center + Vector3(s, s, s),
         center + Vector3(s, s, -s),
@@ -107,45 +129,59 @@ void Game::DrawReferenceCube (Vector3 const& center, float const s)
         center + Vector3(-s, -s, -s),
         center
     };
-    for (int i = 0; i < 9; ++i)
-    {
-        pointsV[i] = viewMatrix * points[i];
-        pointsNDC[i] = projectionMatrix * HomoVector(pointsV[i]);
-        // Perspective divide    
-        points[i] = ProjectToHyperspace(pointsNDC[i]);
-        points[i] = viewportMatrix * points[i];
-    }
-
-    // Render
-    ColorRGB c = Color::White;
-    m_pRenderer->DrawLine(points[0], points[1], c);
-    m_pRenderer->DrawLine(points[1], points[2], c);
-    m_pRenderer->DrawLine(points[2], points[3], c);
-    m_pRenderer->DrawLine(points[3], points[0], c);
-    m_pRenderer->DrawLine(points[4], points[5], c);
-    m_pRenderer->DrawLine(points[5], points[6], c);
-    m_pRenderer->DrawLine(points[6], points[7], c);
-    m_pRenderer->DrawLine(points[7], points[4], c);
-    m_pRenderer->DrawLine(points[3], points[4], c);
-    m_pRenderer->DrawLine(points[0], points[5], c);
-    m_pRenderer->DrawLine(points[1], points[6], c);
-    m_pRenderer->DrawLine(points[2], points[7], c);
-    m_pRenderer->SetPixel(points[8].x, points[8].y, c);
+
+    // Edges, then the center as a single pixel
+    std::array<Vector3, 26> const lines{
+        points[0], points[1],
+        points[1], points[2],
+        points[2], points[3],
+        points[3], points[0],
+        points[4], points[5],
+        points[5], points[6],
+        points[6], points[7],
+        points[7], points[4],
+        points[3], points[4],
+        points[0], points[5],
+        points[1], points[6],
+        points[2], points[7],
+        points[8], points[8]
+    };
+    commands.DrawLines(lines.data(), lines.size(), Color::White);
 }
 
 int Game::Run ()
 {   
     //// Load Scene ////
 
-    std::unique_ptr<ICameraFactory> pCameraFactory = std::make_unique<LuaCameraFactory>();
+    // The script runs once; every factory builds its part from the same description of the scene
+    if (!m_pScriptContext)
+    {
+        m_pScriptContext = std::make_shared<LuaContext>();
+    }
+    m_pSceneLoader = std::make_unique<LuaSceneLoader>(m_pScriptContext);
+
+    std::unique_ptr<ICameraFactory> pCameraFactory = std::make_unique<LuaCameraFactory>(*m_pSceneLoader);
     auto pCamera = pCameraFactory->MakeFromFile("scene.lua");
     if (pCamera)
     {
         m_camera = *pCamera;
     }
 
-    std::unique_ptr<IObject3DFactory> pObjectFactory = std::make_unique<LuaObject3DFactory>();
-    m_objects = std::move(pObjectFactory->MakeFromFile("scene.lua"));
+    // How many objects each of the script's objects was made into is kept, so that reloads can tell them apart
+    if (SceneDescription const* pScene = m_pSceneLoader->Load("scene.lua"))
+    {
+        m_objects = LuaObject3DFactory(*m_pSceneLoader, m_assets, m_transforms).MakeFromDescription(*pScene, &m_sceneObjectCounts);
+    }
+    m_transforms.Update();
+    m_bvh.Build(m_objects);
+    UpdateDrawOrder();
+
+    LuaCommandRecorder(*m_pSceneLoader).RecordFromFile("scene.lua", m_sceneCommands);
+
+    if (m_hotReload)
+    {
+        m_pSceneWatcher = std::make_unique<FileWatcher>("scene.lua");
+    }
     
     //// Create some test objects ////
 
@@ -157,8 +193,15 @@ int Game::Run ()
     // m_objects[0]->Rotate(0, Constants::Deg2Rad(0), 0);
     // m_objects[1]->Translate(Vector3(0.5f, 0, 0));
 
-    // Setup lights
-    m_lights.push_back(Normalized(Vector3::Backward));
+    // Setup lights: the scene's, if it has any
+    if (SceneDescription const* pScene = m_pSceneLoader->Load("scene.lua"))
+    {
+        m_lights = pScene->lights;
+    }
+    if (m_lights.empty())
+    {
+        m_lights.push_back(Normalized(Vector3::Backward));
+    }
     // m_lights.push_back(Normalized(Vector3(0, -2, -2)));
     // m_lights.push_back(Normalized(Vector3(20, 0, -3)));
     // m_lights.push_back(Normalized(Vector3::Forward));
@@ -183,9 +226,9 @@ int Game::Run ()
         lag += elapsed;
         previous = current;
         #if defined(WIN32)
-        std::stringstream ss;
-        ss << "elapsed = " << elapsed << ", lag = " << lag << std::endl;
-        OutputDebugStringA(ss.str().c_str());
+        char timing[64];
+        snprintf(timing, sizeof(timing), "elapsed = %zu, lag = %zu\n", elapsed, lag);
+        OutputDebugStringA(timing);
         #else
         // std::cout << "elapsed = " << elapsed << ", lag = " << lag << std::endl;
         #endif
@@ -199,26 +242,22 @@ int Game::Run ()
             lag -= m_fixedUpdateTimeStep;
         }
 
-        // Render the scene using the normalized lag
+        // Update and cull this frame using the normalized lag, while the render stage is still drawing the previous one
         DrawWorld(float(lag)/float(m_fixedUpdateTimeStep));
-        // Submit the frame
-        m_pRenderer->RenderFrame();
-        // Render all UI text on top of the scene
-        if (m_pTF != nullptr)
+        if (FinishRender())
         {
-            size_t fps = 1.f / (float(elapsed) / 1000.f);
-            std::stringstream ss;
-            ss << elapsed << " ms (" << fps << " FPS)";
-            auto pTexture = m_pTF->DrawTextNormal(ss.str(), 16, Color::Orange);
-            if (pTexture->get() != nullptr)
-            {
-                int w, h;
-                SDL_QueryTexture(pTexture->get(), nullptr, nullptr, &w, &h);
-                SDL_Rect dstrect = {0, 0, w, h};
-                SDL_RenderCopy(m_pRenderer->GetRenderer(), pTexture->get(), nullptr, &dstrect); // blit the whole text on the top-left corner of the screen
-                SDL_RenderPresent(m_pRenderer->GetRenderer());
-            }
+            // Submit the previous frame
+            m_pRenderer->RenderFrame();
+            // Render all UI text on top of the scene
+            Profiler::Instance().EndFrame();
+            MemoryTracker::EndFrame();
+            DrawOverlay(elapsed);
         }
+        // Nothing is being drawn in between, so textures may change resolution, and assets may show up
+        m_assets.UpdateStreaming();
+        ReloadScene();
+        SwapInLoadedAssets();
+        BeginRender();
 
         #ifdef NDEBUG
         // Consider sleeping a bit after a cycle to save power/energy on the host platform
@@ -226,6 +265,14 @@ int Game::Run ()
         #endif
     }
 
+    // The frame in flight draws into the renderer, so it mustn't outlive the loop
+    FinishRender();
+
+    if (MemoryTracker::TRACKING)
+    {
+        DumpMemoryUsage();
+    }
+
     return rc;
 }
 
@@ -290,6 +337,11 @@ bool Game::ProcessEvents ()
                     m_camera.Translate(Vector3::Up * movement);
                 }
 
+                if (event.type == SDL_KEYUP && event.key.keysym.sym == SDLK_m)
+                {
+                    DumpMemoryUsage();
+                }
+
                 if (event.key.keysym.sym == SDLK_COMMA || event.key.keysym.sym == SDLK_PERIOD)
                 {
                     float delta = 2.f;
@@ -301,8 +353,13 @@ bool Game::ProcessEvents ()
                     m_camera.Fov(next);
                 }
                 break;
-            case SDL_MOUSEMOTION:
             case SDL_MOUSEBUTTONDOWN:
+                if (event.button.button == SDL_BUTTON_LEFT)
+                {
+                    PickObject(event.button.x, event.button.y);
+                }
+                break;
+            case SDL_MOUSEMOTION:
             case SDL_MOUSEBUTTONUP:
             case SDL_MOUSEWHEEL:
                 // TODO: Handle input
@@ -315,118 +372,704 @@ bool Game::ProcessEvents ()
 
 void Game::UpdateViewportMatrix ()
 {
-    // x, y -> Convert from [-1, 1] to [0, 1], then scale by screen dimensions    
-    // z -> leave as-is
-    float v_x = 0.5f * m_screenWidth, v_y = 0.5f * m_screenHeight;
-    m_viewportMatrix = Matrix4(Matrix4::elements_array_type{
-       v_x,   0, 0, v_x, 
-         0, v_y, 0, v_y, 
-         0,   0, 1,   0,
-         0,   0, 0,   1, 
+    // The whole screen, which is also where every command buffer starts out drawing to
+    m_viewportMatrix = CommandBuffer::Viewport{0, 0, m_screenWidth, m_screenHeight}.ToMatrix();
+}
+
+void Game::UpdateDrawOrder ()
+{
+    m_drawOrder.clear();
+    m_drawOrder.reserve(m_objects.size());
+    for (uint i = 0; i < m_objects.size(); ++i)
+    {
+        if (m_objects[i].Mesh() != nullptr)
+            m_drawOrder.push_back(i);
+    }
+
+    // Make objects that share both a mesh and a material adjacent, so that they can be drawn as one batch, and
+    // objects that share a texture, e.g. an atlas page, adjacent too, so that they sample it one after the other
+    auto const drawKey = [this](uint const index) {
+        Object3D const& obj = m_objects[index];
+        Material const* material = obj.Material();
+        // Streamed textures' maps come and go, but their streams stay
+        uintptr_t texture = 0;
+        if (material)
+            texture = material->DiffuseStream() ? uintptr_t(material->DiffuseStream()) : uintptr_t(material->DiffuseMap());
+        return std::make_tuple(texture, uintptr_t(obj.Mesh()), uintptr_t(material));
+    };
+    std::stable_sort(m_drawOrder.begin(), m_drawOrder.end(), [&drawKey](uint const a, uint const b) {
+        return drawKey(a) < drawKey(b);
     });
+
+    m_drawRank.assign(m_objects.size(), 0);
+    for (uint rank = 0; rank < m_drawOrder.size(); ++rank)
+    {
+        m_drawRank[m_drawOrder[rank]] = rank;
+    }
+}
+
+void Game::SwapInLoadedAssets ()
+{
+    if (!m_assets.UpdateLoads()) return;
+
+    // Textures show up through their materials on their own; meshes are taken on by the objects using them
+    for (auto & object : m_objects)
+    {
+        object.SwapInMesh();
+    }
+
+    // Objects that got a mesh have bounds now, and either may be drawn in another batch
+    m_bvh.Build(m_objects);
+    UpdateDrawOrder();
+}
+
+void Game::ReloadScene ()
+{
+    m_removedObjects.clear();
+    if (!m_pSceneWatcher || !m_pSceneWatcher->Changed()) return;
+
+    // A script saved halfway through an edit is reported, and the scene stays as it was until the next save
+    auto pPrevious = m_pSceneLoader->Reload("scene.lua");
+    if (!pPrevious) return;
+    SceneDescription const& scene = *m_pSceneLoader->Load("scene.lua");
+
+    // The BVH listens to the objects' transforms, which move about as those of removed objects are dropped
+    m_bvh.Clear();
+    LuaObject3DFactory(*m_pSceneLoader, m_assets, m_transforms).Reload(*pPrevious, scene, m_objects, m_sceneObjectCounts, m_removedObjects);
+    m_transforms.Update();
+
+    // Meshes that were resident already are there right away; the others show up through SwapInLoadedAssets()
+    for (auto & object : m_objects)
+    {
+        object.SwapInMesh();
+    }
+    m_bvh.Build(m_objects);
+    UpdateDrawOrder();
+
+    m_lights = scene.lights;
+    if (m_lights.empty())
+    {
+        m_lights.push_back(Normalized(Vector3::Backward));
+    }
+
+    m_sceneCommands.Clear();
+    LuaCommandRecorder(*m_pSceneLoader).RecordFromFile("scene.lua", m_sceneCommands);
 }
 
 void Game::DrawWorld (float dt)
 {
-    ResetZBuffer();    
+    FrameSnapshot & frame = m_frames[m_updateFrame];
+    frame.camera = m_camera;
+    frame.lights = m_lights;
+
+    // Bring the model matrices of moved objects up to date, then the BVH around them
+    m_transforms.Update();
+    m_bvh.Refit();
+
+    // Only objects whose bounds intersect the view frustum are drawn at all
+    m_visibleObjects.clear();
+    m_bvh.QueryFrustum(m_camera.ViewFrustum(), m_visibleObjects);
+
+    CullOccludedObjects();
+
+    // Restore the batching order, which the BVH's traversal order knows nothing about
+    std::sort(m_visibleObjects.begin(), m_visibleObjects.end(), [this](uint const a, uint const b) {
+        return m_drawRank[a] < m_drawRank[b];
+    });
+
+    // Record the visible objects in parallel, one partition per command buffer
+    uint const visibleCount = uint(m_visibleObjects.size());
+    uint const partitions = (visibleCount + OBJECTS_PER_PARTITION - 1) / OBJECTS_PER_PARTITION;
+    if (frame.objectCommands.size() < partitions)
+        frame.objectCommands.resize(partitions);
+    FrameSnapshot* pFrame = &frame;
+    JobSystem::Instance().ParallelFor(partitions, 1, [this, pFrame, visibleCount](uint const begin, uint const end) {
+        for (uint p = begin; p < end; ++p)
+        {
+            uint const first = p * OBJECTS_PER_PARTITION;
+            RecordObjects(&m_visibleObjects[first], std::min(OBJECTS_PER_PARTITION, visibleCount - first), pFrame->objectCommands[p]);
+        }
+    });
+
+    frame.debugCommands.Clear();
+    // DrawReferenceCube(frame.debugCommands);
+
+    // Objects first, then the scene script's drawings, then debug drawings on top of everything
+    frame.submissions.clear();
+    for (uint p = 0; p < partitions; ++p)
+    {
+        frame.submissions.push_back(&frame.objectCommands[p]);
+    }
+    frame.submissions.push_back(&m_sceneCommands);
+    frame.submissions.push_back(&frame.debugCommands);
+}
+
+void Game::PickObject (int const x, int const y)
+{
+    // Window coordinates have y pointing down, while the frame is flipped to have it point up
+    float const ndcX = 2.f * (x + 0.5f) / m_screenWidth - 1.f;
+    float const ndcY = 1.f - 2.f * (y + 0.5f) / m_screenHeight;
+
+    m_rayHits.clear();
+    m_bvh.QueryRay(m_camera.ScreenRay(ndcX, ndcY), m_rayHits);
+    if (m_rayHits.empty())
+    {
+        trclog("Picked nothing at (" << x << ", " << y << ")");
+        return;
+    }
+
+    // Hits are against bounding boxes, so the front-most one is only an approximation of what is under the cursor
+    BVH::RayHit const& hit = m_rayHits.front();
+    Vector3 const center = m_objects[hit.object].WorldBounds().Center();
+    trclog("Picked object " << hit.object << " at distance " << hit.t << ", centered at (" << center.x << ", " << center.y << ", " << center.z << ")");
+}
+
+void Game::DrawOverlay (size_t const elapsed)
+{
+    if (m_pTF == nullptr) return;
+
+    SDL_Renderer* pRenderer = m_pRenderer->GetRenderer();
+    int y = 0;
+    auto drawLine = [&](char const* text, ColorRGB const color) {
+        SDLTexture texture = m_pTF->DrawTextNormal(text, 16, color);
+        if (texture.get() == nullptr) return;
+
+        int w, h;
+        SDL_QueryTexture(texture.get(), nullptr, nullptr, &w, &h);
+        SDL_Rect dstrect = {0, y, w, h};
+        SDL_RenderCopy(pRenderer, texture.get(), nullptr, &dstrect); // lines are stacked from the top-left corner of the screen
+        y += h;
+    };
+
+    // Lines are formatted on the stack, so that drawing the overlay doesn't allocate either
+    char line[256];
+    size_t fps = 1.f / (float(elapsed) / 1000.f);
+    snprintf(line, sizeof(line), "%zu ms (%zu FPS)", elapsed, fps);
+    drawLine(line, Color::Orange);
+
+    uint64_t const frameAllocations = MemoryTracker::GetTotalUsage().frameAllocations;
+    snprintf(line, sizeof(line), "Heap allocations: %llu", (unsigned long long)frameAllocations);
+    drawLine(line, frameAllocations == 0 ? Color::Green : Color::Red);
+
+    if (TextureStreamer const* pStreamer = m_assets.Streamer())
+    {
+        snprintf(line, sizeof(line), "Streamed textures: %.2f MB of %.2f MB", pStreamer->ResidentBytes() / (1024.0 * 1024.0),
+            pStreamer->BudgetBytes() / (1024.0 * 1024.0));
+        drawLine(line, Color::White);
+    }
+
+    if (size_t const pendingLoads = m_assets.PendingLoads())
+    {
+        snprintf(line, sizeof(line), "Loading assets: %zu", pendingLoads);
+        drawLine(line, Color::White);
+    }
+
+    if (MemoryTracker::TRACKING)
+    {
+        for (uint t = 0; t <= uint(MemoryTracker::Tag::COUNT); ++t)
+        {
+            // The total comes last
+            bool const total = t == uint(MemoryTracker::Tag::COUNT);
+            MemoryTracker::Tag const tag = MemoryTracker::Tag(t);
+            MemoryTracker::Usage const usage = total ? MemoryTracker::GetTotalUsage() : MemoryTracker::GetUsage(tag);
+            snprintf(line, sizeof(line), "%s: %.2f MB live, %.2f MB peak, %llu allocations", total ? "Memory" : MemoryTracker::TagName(tag),
+                usage.liveBytes / (1024.0 * 1024.0), usage.peakBytes / (1024.0 * 1024.0), (unsigned long long)usage.frameAllocations);
+            drawLine(line, total ? Color::Cyan : Color::White);
+        }
+    }
+
+    for (auto const& sample : Profiler::Instance().Samples())
+    {
+        int length = snprintf(line, sizeof(line), "%s: %g ms", sample.name, sample.milliseconds);
+        if (sample.calls > 1 && length < int(sizeof(line)))
+            length += snprintf(line + length, sizeof(line) - length, " (%u calls)", sample.calls);
+        if (sample.framesAgo > 0 && length < int(sizeof(line)))
+            length += snprintf(line + length, sizeof(line) - length, " [%u frames ago]", sample.framesAgo);
+        drawLine(line, Color::White);
+    }
+
+    SDL_RenderPresent(pRenderer);
+}
+
+void Game::DumpMemoryUsage () const
+{
+    if (MemoryTracker::Dump(MEMORY_DUMP_FILE))
+    {
+        trclog("Memory usage written to " << MEMORY_DUMP_FILE);
+    }
+    else
+    {
+        trclog("Failed to write the memory usage to " << MEMORY_DUMP_FILE);
+    }
+}
+
+void Game::CullOccludedObjects ()
+{
+    PROFILE_SCOPE("Occlusion culling");
 
     Matrix4 const& projectionViewMatrix = m_camera.ProjectionViewMatrix();
-    Matrix4 const& viewportMatrix = m_viewportMatrix;
-    
-    for (auto&& obj : m_objects)
+
+    m_occlusionBuffer.Clear();
+    for (uint const index : m_visibleObjects)
     {
-        Matrix4 const modelMatrixInverseTranspose = ~obj.ModelMatrixInverse();
+        Object3D const& obj = m_objects[index];
+        if (obj.IsOccluder())
+            m_occlusionBuffer.DrawOccluder(*obj.Mesh(), projectionViewMatrix * obj.ModelMatrix());
+    }
+    if (m_occlusionBuffer.Empty()) return;
+
+    // Occluders themselves are always drawn, as each one would be found hidden behind its own depth
+    auto const end = std::remove_if(m_visibleObjects.begin(), m_visibleObjects.end(), [&](uint const index) {
+        Object3D const& obj = m_objects[index];
+        return !obj.IsOccluder() && m_occlusionBuffer.IsOccluded(obj.WorldBounds(), projectionViewMatrix);
+    });
+    m_visibleObjects.erase(end, m_visibleObjects.end());
+}
+
+void Game::RecordObjects (uint const* objectIndices, size_t const count, CommandBuffer & commands) const
+{
+    commands.Clear();
 
-        for (auto const& face : obj.Mesh()->GetFaces())
+    Material const* material = nullptr; // every buffer starts out without one
+    for (size_t i = 0; i < count; ++i)
+    {
+        Object3D const& obj = m_objects[objectIndices[i]];
+        if (obj.Material() != material)
         {
-            // Transform surface normals and compute intensity     
-            Vector3 surfaceNormal = TransformDirection(modelMatrixInverseTranspose, face.Normal()); // assumes transformation results in unit vector
-            float intensity = std::max(0.f, -Dot(m_lights[0], surfaceNormal));
-
-            // Back-face culling                        
-            if (Dot(m_camera.LookAtDirection(), surfaceNormal) >= 0) continue;
-            
-            // Transform from model space all the way to NDC clip space
-            Matrix4 projectionViewModelMatrix = projectionViewMatrix * obj.ModelMatrix();
-            Vector4 v0_homo = projectionViewModelMatrix * HomoVector(face[0].xyz());
-            Vector4 v1_homo = projectionViewModelMatrix * HomoVector(face[1].xyz());
-            Vector4 v2_homo = projectionViewModelMatrix * HomoVector(face[2].xyz());
-
-            // Perspective divide
-            Vector3 v0_ndc = ProjectToHyperspace(v0_homo);
-            Vector3 v1_ndc = ProjectToHyperspace(v1_homo);
-            Vector3 v2_ndc = ProjectToHyperspace(v2_homo);
-
-            // Transform to screen space while maintaining z-coordinate for depth buffer
-            Vector3 v0 = viewportMatrix * v0_ndc;
-            Vector3 v1 = viewportMatrix * v1_ndc;
-            Vector3 v2 = viewportMatrix * v2_ndc;
-            
-            // Compute minimum rectangle that fully contains the 3 vertices in screen space
-            auto const boundingBox = TriangleUtil::MinimumBoundingBox<float>(v0, v1, v2)
-                                        .Clip(Box2(Vector2(0, 0), Vector2(m_screenWidth, m_screenHeight)));
-            uint x_start = boundingBox.bottomLeft.x, y_start = boundingBox.bottomLeft.y;
-            uint x_end =  boundingBox.topRight.x, y_end = boundingBox.topRight.y;
-
-            // Identify the pixels within the bounds and compute their colour
-            for (uint x = x_start; x <= x_end; ++x)
-            {                
-                for (uint y = y_start; y <= y_end; ++y)
+            material = obj.Material();
+            commands.SetMaterial(material);
+        }
+
+        // Matrices are copied, as the objects may move again before the render stage gets to them
+        commands.DrawMesh(*obj.Mesh(), obj.ModelMatrix(), obj.ModelMatrixInverse(), obj.NormalMatrix());
+    }
+}
+
+void Game::ExecuteCommands (FrameSnapshot const& frame, CommandBuffer const& commands, ExecutedCommands & out) const
+{
+    Matrix4 const& projectionViewMatrix = frame.camera.ProjectionViewMatrix();
+    Frustum const& frustum = frame.camera.ViewFrustum();
+
+    out.instances.clear();
+    out.drawClusters.clear();
+    out.lines.clear();
+
+    // State, as set by the commands so far
+    Box2 const screenBounds(Vector2(0, 0), Vector2(m_screenWidth - 1, m_screenHeight - 1));
+    Matrix4 viewportMatrix = m_viewportMatrix;
+    Box2 viewportBounds = screenBounds;
+    TextureMap const* diffuseMap = nullptr;
+    StreamedTexture const* diffuseStream = nullptr;
+    TextureSampler diffuseSampler;
+
+    for (auto const& command : commands.Commands())
+    {
+        switch (command.type)
+        {
+            case CommandBuffer::Type::SET_VIEWPORT:
+            {
+                CommandBuffer::Viewport const& viewport = commands.Viewports()[command.index];
+                viewportMatrix = viewport.ToMatrix();
+                viewportBounds = Box2(Vector2(viewport.x, viewport.y), Vector2(viewport.x + viewport.width - 1, viewport.y + viewport.height - 1)).Clip(screenBounds);
+                break;
+            }
+            case CommandBuffer::Type::SET_MATERIAL:
+            {
+                Material const* material = commands.Materials()[command.index];
+                diffuseMap = material ? material->DiffuseMap() : nullptr;
+                diffuseStream = material ? material->DiffuseStream() : nullptr;
+                diffuseSampler = material ? material->DiffuseSampler() : TextureSampler();
+                break;
+            }
+            case CommandBuffer::Type::DRAW_MESH:
+            {
+                CommandBuffer::MeshDraw const& draw = commands.MeshDraws()[command.index];
+                out.instances.emplace_back();
+                DrawInstance & instance = out.instances.back();
+                instance.mesh = draw.mesh;
+                instance.diffuseMap = diffuseMap;
+                instance.diffuseStream = diffuseStream;
+                instance.diffuseSampler = diffuseSampler;
+                instance.viewportMatrix = viewportMatrix;
+                instance.viewportBounds = viewportBounds;
+                instance.modelMatrix = draw.modelMatrix;
+                instance.normalMatrix = draw.normalMatrix;
+                instance.projectionViewModelMatrix = projectionViewMatrix * draw.modelMatrix;
+                instance.boundsScale = MaxScale(draw.modelMatrix);
+
+                // Clusters are in model space, so bring the camera there instead of bringing every cluster to world space
+                instance.cameraPositionModel = draw.modelMatrixInverse * frame.camera.Position();
+                break;
+            }
+            case CommandBuffer::Type::DRAW_LINES:
+            {
+                CommandBuffer::LineDraw const& draw = commands.LineDraws()[command.index];
+                Vector3 const* points = &commands.LinePoints()[draw.firstPoint];
+                for (uint i = 0; i < draw.pointCount; i += 2)
                 {
-                    Vector3 baryCoords = TriangleUtil::BarycentricCoordinates(Vector3(x, y), v0, v1, v2);
-                    float l0 = baryCoords.x, l1 = baryCoords.y, l2 = baryCoords.z;
-                    if (l0 >= 0 && l1 >= 0 && l2 >= 0)
-                    {
-                        // Interpolate UV
-                        auto const& uv0 = face[0].uv();
-                        auto const& uv1 = face[1].uv();
-                        auto const& uv2 = face[2].uv();
-                        float u_interpolated = l0 * uv0.x + l1 * uv1.x + l2 * uv2.x;
-                        float v_interpolated = l0 * uv0.y + l1 * uv1.y + l2 * uv2.y;
-
-                        // Get color from diffuse map
-                        ColorRGB diffuseColor = obj.Material() && obj.Material()->DiffuseMap() ? obj.Material()->DiffuseMap()->Map(u_interpolated, v_interpolated) : face.DebugColor();
-
-                        // Gouraud shading: interpolate normal and compute lighting intensity
-                        // Assumes transformation results in unit vector
-                        float intensity0 = Dot(m_lights[0], TransformDirection(modelMatrixInverseTranspose, face[0].normal()));
-                        float intensity1 = Dot(m_lights[0], TransformDirection(modelMatrixInverseTranspose, face[1].normal()));
-                        float intensity2 = Dot(m_lights[0], TransformDirection(modelMatrixInverseTranspose, face[2].normal()));
-                        float pixelIntensity = std::max(0.f, -(l0 * intensity0 + l1 * intensity1 + l2 * intensity2));
-
-                        // Apply lighting intensity modifier
-                        ColorRGB intensifiedColor = Color::Intensify(diffuseColor, pixelIntensity); // gouraud shading
-                        // ColorRGB intensifiedColor = Color::Intensify(Color::White, pixelIntensity); // gouraud shading, one color
-                        // ColorRGB intensifiedColor = Color::Intensify(diffuseColor, intensity); // flat shading
-                        // ColorRGB intensifiedColor = Color::Intensify(Color::White, intensity); // flat shading, one color
-                        // ColorRGB intensifiedColor = diffuseColor; // no shading
-
-                        // Handle z-buffer
-                        if (m_zBuffer.empty())
-                        {
-                            m_pRenderer->SetPixel(x, y, intensifiedColor);
-                        }
-                        else
-                        {
-                            // Interpolate z-buffer
-                            float z = l0 * v0.z + l1 * v1.z + l2 * v2.z;
-
-                            // TODO: This "clipping" has no performance benefits at this phase; it should be done in clip space
-                            if (z < -1 || z > 1) continue;
-
-                            // Depth test: vertices closest to the near-plane pass, with -1 = near-plane, 1 = far-plane
-                            uint index = y * m_screenWidth + x;
-                            if (z <= m_zBuffer[index])
-                            {
-                                m_zBuffer[index] = z;
-                                m_pRenderer->SetPixel(x, y, intensifiedColor);
-                            }                            
-                        }   
-                    }
+                    Vector3 const from = viewportMatrix * ProjectToHyperspace(projectionViewMatrix * HomoVector(points[i]));
+                    Vector3 const to = viewportMatrix * ProjectToHyperspace(projectionViewMatrix * HomoVector(points[i + 1]));
+                    out.lines.push_back({from, to, draw.color, viewportBounds});
+                }
+                break;
+            }
+        }
+    }
+
+    // Draw every run of instances sharing a mesh and a material as one batch. The instances are all in place by now,
+    // so clusters can point to them.
+    auto const& instances = out.instances;
+    for (size_t begin = 0, end = 0; begin < instances.size(); begin = end)
+    {
+        DrawInstance const& first = instances[begin];
+        for (end = begin + 1; end < instances.size(); ++end)
+        {
+            if (instances[end].mesh != first.mesh || instances[end].diffuseMap != first.diffuseMap) break;
+        }
+
+        // Clusters are the outer loop so that a cluster's faces stay in cache while every instance draws them
+        auto const& faces = first.mesh->GetFaces();
+        for (auto const& cluster : first.mesh->GetClusters())
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                DrawInstance const& instance = instances[i];
+
+                // Reject whole clusters that are entirely outside the view frustum or facing away from the camera.
+                // The frustum test happens in world space, where the radius is stretched along with the model.
+                if (!frustum.Intersects({instance.modelMatrix * cluster.bounds.center, cluster.bounds.radius * instance.boundsScale})) continue;
+                if (cluster.IsBackFacingFrom(instance.cameraPositionModel)) continue;
+
+                out.drawClusters.push_back({&faces[cluster.firstFace], cluster.faceCount, &instance, 0});
+            }
+        }
+    }
+}
+
+void Game::BeginRender ()
+{
+    assert(m_renderJob == nullptr);
+
+    JobSystem & jobs = JobSystem::Instance();
+    FrameSnapshot* pFrame = &m_frames[m_updateFrame];
+    MEMORY_SCOPE(RENDERER); // inherited by all of the render stage's jobs
+    m_renderJob = jobs.Create([this, pFrame] {
+        DrawSnapshot(*pFrame);
+        m_renderArenas.Reset();
+    });
+    jobs.Run(m_renderJob);
+
+    m_updateFrame ^= 1;
+}
+
+bool Game::FinishRender ()
+{
+    if (m_renderJob == nullptr) return false;
+
+    PROFILE_SCOPE("Waiting for the render stage");
+    JobSystem::Instance().Wait(m_renderJob);
+    m_renderJob = nullptr;
+    return true;
+}
+
+void Game::DrawSnapshot (FrameSnapshot & frame)
+{
+    JobSystem & jobs = JobSystem::Instance();
+    FrameSnapshot* pFrame = &frame;
+
+    ResetZBuffer();
+
+    FrameArena & arena = m_renderArenas.Local();
+
+    // Command buffers are independent of one another, so they're all executed at once, each into the arena of
+    // whichever worker executes it
+    uint const submissionCount = uint(frame.submissions.size());
+    ArenaVector<ExecutedCommands> executedCommands{ArenaAllocator<ExecutedCommands>(arena)};
+    executedCommands.reserve(submissionCount);
+    for (uint s = 0; s < submissionCount; ++s)
+    {
+        executedCommands.emplace_back(arena);
+    }
+    ExecutedCommands* pExecutedCommands = executedCommands.data();
+    jobs.ParallelFor(submissionCount, 1, [this, pFrame, pExecutedCommands](uint const begin, uint const end) {
+        FrameArena & localArena = m_renderArenas.Local();
+        for (uint s = begin; s < end; ++s)
+        {
+            pExecutedCommands[s] = ExecutedCommands(localArena);
+            ExecuteCommands(*pFrame, *pFrame->submissions[s], pExecutedCommands[s]);
+        }
+    });
+
+    // Every face gets its own slot, in submission order, so that they can be set up in any order and still be drawn in that one
+    size_t clusterCount = 0;
+    for (auto const& executed : executedCommands)
+    {
+        clusterCount += executed.drawClusters.size();
+    }
+    ArenaVector<DrawCluster> drawClusters{ArenaAllocator<DrawCluster>(arena)};
+    drawClusters.reserve(clusterCount);
+    uint triangleCount = 0;
+    for (auto const& executed : executedCommands)
+    {
+        for (auto drawCluster : executed.drawClusters)
+        {
+            drawCluster.firstTriangle = triangleCount;
+            triangleCount += drawCluster.faceCount;
+            drawClusters.push_back(drawCluster);
+        }
+    }
+    ArenaVector<ScreenTriangle> triangles(triangleCount, ScreenTriangle(), ArenaAllocator<ScreenTriangle>(arena));
+    DrawCluster const* pDrawClusters = drawClusters.data();
+    ScreenTriangle* pTriangles = triangles.data();
+
+    {
+        PROFILE_SCOPE("Vertex processing");
+        jobs.ParallelFor(uint(drawClusters.size()), 16, [this, pFrame, pDrawClusters, pTriangles](uint const begin, uint const end) {
+            for (uint c = begin; c < end; ++c)
+            {
+                DrawCluster const& drawCluster = pDrawClusters[c];
+                for (uint f = 0; f < drawCluster.faceCount; ++f)
+                {
+                    SetupTriangle(*pFrame, drawCluster.faces[f], *drawCluster.instance, pTriangles[drawCluster.firstTriangle + f]);
                 }
             }
+        });
+    }
+
+    {
+        PROFILE_SCOPE("Rasterization");
+        // Bands don't share any pixels, nor any depths, so they need no synchronization at all
+        jobs.ParallelFor(uint(m_rasterScratch.size()), 1, [this, pTriangles, triangleCount](uint const begin, uint const end) {
+            for (uint band = begin; band < end; ++band)
+            {
+                uint const yBegin = band * BAND_HEIGHT;
+                uint const yEnd = std::min(yBegin + BAND_HEIGHT, uint(m_screenHeight)) - 1;
+                for (uint t = 0; t < triangleCount; ++t)
+                {
+                    ScreenTriangle const& triangle = pTriangles[t];
+                    if (triangle.yStart > yEnd || triangle.yEnd < yBegin) continue;
+                    RasterizeTriangle(triangle, std::max(triangle.yStart, yBegin), std::min(triangle.yEnd, yEnd), m_rasterScratch[band]);
+                }
+            }
+        });
+    }
+
+    // Lines go on top of everything, without any depth test
+    for (auto const& executed : executedCommands)
+    {
+        for (auto const& line : executed.lines)
+        {
+            // Only the part inside the line's viewport is drawn, as with faces
+            float tEnter, tExit;
+            if (!line.viewportBounds.ClipSegment(Vector2(line.from.x, line.from.y), Vector2(line.to.x, line.to.y), tEnter, tExit)) continue;
+
+            Vector3 const delta = line.to - line.from;
+            m_pRenderer->DrawLine(line.from + delta * tEnter, line.from + delta * tExit, line.color);
+        }
+    }
+}
+
+void Game::SetupTriangle (FrameSnapshot const& frame, Mesh::Triangle const& face, DrawInstance const& instance, ScreenTriangle & out) const
+{
+    Matrix4 const& viewportMatrix = instance.viewportMatrix;
+    Matrix4 const& normalMatrix = instance.normalMatrix;
+
+    // Culled faces have no rows at all
+    out.yStart = ~0u;
+    out.yEnd = 0;
+
+    // Transform surface normals; scaled models don't preserve their length
+    Vector3 surfaceNormal = Normalized(TransformDirection(normalMatrix, face.Normal()));
+
+    // Back-face culling                        
+    if (Dot(frame.camera.LookAtDirection(), surfaceNormal) >= 0) return;
+
+    // Gouraud shading: lighting intensity at each vertex, to be interpolated across the face
+    Vector3 const& light = frame.lights[0];
+    float intensity0 = Dot(light, Normalized(TransformDirection(normalMatrix, face[0].normal())));
+    float intensity1 = Dot(light, Normalized(TransformDirection(normalMatrix, face[1].normal())));
+    float intensity2 = Dot(light, Normalized(TransformDirection(normalMatrix, face[2].normal())));
+
+    // Transform from model space all the way to NDC clip space
+    Vector4 clip[3];
+    Kernels::Active().TransformPoints(&instance.projectionViewModelMatrix.Row(0).x, &face[0].xyz().x, sizeof(Mesh::Triangle::Vertex), 3, &clip[0].x);
+
+    // Perspective divide
+    Vector3 v0_ndc = ProjectToHyperspace(clip[0]);
+    Vector3 v1_ndc = ProjectToHyperspace(clip[1]);
+    Vector3 v2_ndc = ProjectToHyperspace(clip[2]);
+
+    // Transform to screen space while maintaining z-coordinate for depth buffer
+    Vector3 v0 = viewportMatrix * v0_ndc;
+    Vector3 v1 = viewportMatrix * v1_ndc;
+    Vector3 v2 = viewportMatrix * v2_ndc;
+
+    // Compute minimum rectangle that fully contains the 3 vertices in screen space
+    auto const boundingBox = TriangleUtil::MinimumBoundingBox<float>(v0, v1, v2)
+                                .Clip(instance.viewportBounds);
+    uint x_start = boundingBox.bottomLeft.x, y_start = boundingBox.bottomLeft.y;
+    uint x_end =  boundingBox.topRight.x, y_end = boundingBox.topRight.y;
+
+    // Barycentric coordinates are affine in screen space, and so is every attribute interpolated with them.
+    // Edge function i is opposite vertex i, so that dividing it by the area gives the barycentric coordinate of vertex i.
+    float const area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (area == 0.f) return;
+    Vector3 const* vertices[3] = { &v0, &v1, &v2 };
+    auto const barycentric = [&vertices, area] (uint const i, float const x, float const y)
+    {
+        Vector3 const& a = *vertices[(i + 1) % 3];
+        Vector3 const& b = *vertices[(i + 2) % 3];
+        return ((b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x)) / area;
+    };
+    auto const barycentricStepX = [&vertices, area] (uint const i) // from one pixel to the next along x
+    {
+        return (vertices[(i + 1) % 3]->y - vertices[(i + 2) % 3]->y) / area;
+    };
+    auto const barycentricStepY = [&vertices, area] (uint const i) // from one row to the next
+    {
+        return (vertices[(i + 2) % 3]->x - vertices[(i + 1) % 3]->x) / area;
+    };
+
+    // Attributes at each vertex: depth, uv, and the Gouraud lighting intensity, negated as lights point towards the surface
+    float const z[3] = { v0.z, v1.z, v2.z };
+    float const u[3] = { face[0].uv().x, face[1].uv().x, face[2].uv().x };
+    float const v[3] = { face[0].uv().y, face[1].uv().y, face[2].uv().y };
+    float const intensities[3] = { -intensity0, -intensity1, -intensity2 };
+
+    Kernels::Span & span = out.span;
+    span.count = x_end - x_start + 1;
+    {
+        float const l[3] = { barycentric(0, x_start, y_start), barycentric(1, x_start, y_start), barycentric(2, x_start, y_start) };
+        span.l0 = l[0]; span.l1 = l[1]; span.l2 = l[2];
+        span.z = l[0] * z[0] + l[1] * z[1] + l[2] * z[2];
+        span.u = l[0] * u[0] + l[1] * u[1] + l[2] * u[2];
+        span.v = l[0] * v[0] + l[1] * v[1] + l[2] * v[2];
+        span.intensity = l[0] * intensities[0] + l[1] * intensities[1] + l[2] * intensities[2];
+    }
+    {
+        float const dl[3] = { barycentricStepX(0), barycentricStepX(1), barycentricStepX(2) };
+        span.dl0 = dl[0]; span.dl1 = dl[1]; span.dl2 = dl[2];
+        span.dz = dl[0] * z[0] + dl[1] * z[1] + dl[2] * z[2];
+        span.du = dl[0] * u[0] + dl[1] * u[1] + dl[2] * u[2];
+        span.dv = dl[0] * v[0] + dl[1] * v[1] + dl[2] * v[2];
+        span.dintensity = dl[0] * intensities[0] + dl[1] * intensities[1] + dl[2] * intensities[2];
+    }
+    {
+        float const dl[3] = { barycentricStepY(0), barycentricStepY(1), barycentricStepY(2) };
+        out.dl0 = dl[0]; out.dl1 = dl[1]; out.dl2 = dl[2];
+        out.dz = dl[0] * z[0] + dl[1] * z[1] + dl[2] * z[2];
+        out.du = dl[0] * u[0] + dl[1] * u[1] + dl[2] * u[2];
+        out.dv = dl[0] * v[0] + dl[1] * v[1] + dl[2] * v[2];
+        out.dintensity = dl[0] * intensities[0] + dl[1] * intensities[1] + dl[2] * intensities[2];
+    }
+
+    out.xStart = x_start;
+    out.yStart = y_start;
+    out.yEnd = y_end;
+    out.debugColor = face.DebugColor();
+    out.diffuseMap = instance.diffuseMap;
+    out.diffuseSampler = instance.diffuseSampler;
+
+    // The LOD would be computed from the differences in uv across each 2x2 quad of pixels, but as uv is affine in
+    // screen space, those are the steps along x and y, and thus the same for every quad of the face
+    out.lod = instance.diffuseMap ? instance.diffuseMap->Lod(span.du, span.dv, out.du, out.dv) : 0.f;
+    if (instance.diffuseStream)
+        instance.diffuseStream->Request(out.lod);
+}
+
+void Game::RasterizeTriangle (ScreenTriangle const& triangle, uint const yBegin, uint const yEnd, RasterScratch & scratch)
+{
+    Kernels::Table const& kernels = Kernels::Active();
+
+    Kernels::Fragments const fragments = { scratch.fragmentOffsets.data(), scratch.fragmentU.data(), scratch.fragmentV.data(), scratch.fragmentIntensities.data() };
+    ColorRGB* colors = scratch.fragmentColors.data();
+    TextureMap const* diffuseMap = triangle.diffuseMap;
+    // The mip level(s) closest to the face's LOD; below 0, i.e. magnified, the texture itself
+    static_assert(TextureMap::TILE_SIZE == 4, "The kernels address texels in 4x4 tiles");
+    static_assert(uint(TextureAddress::CLAMP) == uint(Kernels::Address::CLAMP) && uint(TextureAddress::REPEAT) == uint(Kernels::Address::REPEAT)
+        && uint(TextureAddress::MIRROR) == uint(Kernels::Address::MIRROR), "Addressing modes are passed to the kernels as is");
+    Kernels::Texels texels = {}, coarseTexels = {};
+    float coarseWeight = 0.f;
+    if (diffuseMap)
+    {
+        Kernels::Address const addressU = Kernels::Address(triangle.diffuseSampler.addressU);
+        Kernels::Address const addressV = Kernels::Address(triangle.diffuseSampler.addressV);
+        auto const levelTexels = [&](uint const level) {
+            Kernels::Texels t = { nullptr, diffuseMap->Mip(level).width, diffuseMap->Mip(level).height, addressU, addressV };
+            if (diffuseMap->IsCompressed())
+                t.blocks = diffuseMap->MipBlocks(level);
+            else
+                t.pixels = diffuseMap->MipPixels(level);
+            return t;
+        };
+        uint const lastLevel = diffuseMap->MipCount() - 1;
+        float const lod = std::min(std::max(triangle.lod, 0.f), float(lastLevel));
+        uint level = uint(lod);
+        if (m_textureFilter == TextureFilter::TRILINEAR)
+        {
+            uint const coarseLevel = std::min(level + 1, lastLevel);
+            coarseTexels = levelTexels(coarseLevel);
+            coarseWeight = lod - float(level);
         }
+        else
+        {
+            level = uint(lod + 0.5f);
+        }
+        texels = levelTexels(level);
     }
 
-    // DrawReferenceCube();
-}
\ No newline at end of file
+    // Identify the pixels within the bounds, one row at a time, and compute their colour. Each row's attributes
+    // are computed from the first row's rather than accumulated, so that they don't depend on where the band starts.
+    Kernels::Span span = triangle.span;
+    uint const x_start = triangle.xStart;
+    for (uint y = yBegin; y <= yEnd; ++y)
+    {
+        float const rows = float(y - triangle.yStart);
+        span.l0 = triangle.span.l0 + rows * triangle.dl0;
+        span.l1 = triangle.span.l1 + rows * triangle.dl1;
+        span.l2 = triangle.span.l2 + rows * triangle.dl2;
+        span.z = triangle.span.z + rows * triangle.dz;
+        span.u = triangle.span.u + rows * triangle.du;
+        span.v = triangle.span.v + rows * triangle.dv;
+        span.intensity = triangle.span.intensity + rows * triangle.dintensity;
+
+        // Depth test: pixels closest to the near-plane pass, with -1 = near-plane, 1 = far-plane
+        // TODO: Pixels outside that range should be clipped away in clip space instead
+        uint32_t const count = kernels.RasterizeSpan(span, &m_zBuffer[y * uint(m_screenWidth) + x_start], fragments);
+        if (count == 0) continue;
+
+        // Get color from diffuse map
+        if (!diffuseMap)
+        {
+            std::fill_n(colors, count, triangle.debugColor);
+        }
+        else if (m_textureFilter == TextureFilter::NEAREST)
+        {
+            if (texels.blocks)
+                kernels.SampleBlocks(texels, scratch.blockCache, fragments.u, fragments.v, count, colors);
+            else
+                kernels.SampleTexture(texels, fragments.u, fragments.v, count, colors);
+        }
+        else
+        {
+            auto const sampleBilinear = [&](Kernels::Texels const& t, ColorRGB* out) {
+                if (t.blocks)
+                    kernels.SampleBlocksBilinear(t, scratch.blockCache, fragments.u, fragments.v, count, out);
+                else
+                    kernels.SampleTextureBilinear(t, fragments.u, fragments.v, count, out);
+            };
+            sampleBilinear(texels, colors);
+            if (coarseWeight > 0.f)
+            {
+                sampleBilinear(coarseTexels, scratch.fragmentCoarseColors.data());
+                kernels.BlendColors(colors, scratch.fragmentCoarseColors.data(), coarseWeight, count, colors);
+            }
+        }
+
+        // Apply lighting intensity modifier (gouraud shading)
+        kernels.PackColors(colors, fragments.intensities, count, colors);
+
+        for (uint32_t i = 0; i < count; ++i)
+            m_pRenderer->SetPixel(x_start + fragments.offsets[i], y, colors[i]);
+    }
+}
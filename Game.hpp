@@ -9,9 +9,23 @@
 #include "SDLTextFactory.hpp"
 #include "Vector.hpp"
 #include "Matrix.hpp"
+#include "Box.hpp"
+#include "Texture.hpp"
 #include "Object3D.hpp"
 #include "Object3DFactory.hpp"
 #include "Camera.hpp"
+#include "AssetRegistry.hpp"
+#include "BVH.hpp"
+#include "TransformSystem.hpp"
+#include "OcclusionBuffer.hpp"
+#include "Kernels.hpp"
+#include "JobSystem.hpp"
+#include "FrameArena.hpp"
+#include "CommandBuffer.hpp"
+#include "FileWatcher.hpp"
+
+struct LuaContext;
+class LuaSceneLoader;
 
 class Game
 {
@@ -37,6 +51,22 @@ public:
 
     void SetRenderer (SDLRenderer* pRM) { m_pRenderer = pRM; }
     void SetTextRenderer (SDLTextFactory* pTF) { m_pTF = pTF; }
+    void SetTextureFilter (TextureFilter filter) { m_textureFilter = filter; }
+    void SetTextureCompression (bool compress) { m_assets.CompressTextures(compress); }
+    void SetTextureAtlas (bool atlas) { m_assets.AtlasTextures(atlas); }
+    void SetTextureStreaming (bool stream, size_t budgetBytes) { m_assets.StreamTextures(stream, budgetBytes); }
+    void SetAsyncLoading (bool async) { m_assets.LoadAsync(async); }
+    void SetAssetPack (std::shared_ptr<AssetPack const> pPack) { m_assets.Pack(std::move(pPack)); }
+
+    /**
+     * Lua state the scene script runs in, e.g. the one the settings ran in; a new one if none is given
+     */
+    void SetScriptContext (std::shared_ptr<LuaContext> pContext) { m_pScriptContext = std::move(pContext); }
+
+    /**
+     * Whether the scene script is watched, and the scene brought in line with it whenever it's saved; cf. ReloadScene
+     */
+    void SetHotReload (bool hotReload) { m_hotReload = hotReload; }
 
     void SetScreenWidthAndHeight (float width, float height); // it is important to call this at least once before either SetScreenWidth or SetScreenHeight are called
     void SetScreenWidth (float width);
@@ -48,7 +78,8 @@ public:
     bool ProcessEvents ();
 
     /**
-     * Performed once normally at the end of each frame
+     * Performed once normally at the end of each frame. Brings the scene up to date and culls it, then captures
+     * what is left to draw into the update stage's snapshot, for the render stage to draw.
      */
     void DrawWorld (float dt); // dt => normalized lag, i.e. how far into the next frame update cycle the game loop is currently in
 
@@ -57,7 +88,187 @@ private:
     void RecreateZBuffer ();
     void ResetZBuffer ();
 
-    void DrawReferenceCube (Vector3 const& position=Vector3(), float const s=0.25f);
+    void DrawReferenceCube (CommandBuffer & commands, Vector3 const& position=Vector3(), float const s=0.25f);
+
+    /**
+     * Per-instance state that is shared by every face drawn for that instance
+     */
+    struct DrawInstance
+    {
+        Mesh const* mesh;
+        TextureMap const* diffuseMap;
+        StreamedTexture const* diffuseStream; // behind the diffuse map, if streamed, to tell which level its faces need
+        TextureSampler diffuseSampler;
+        Matrix4 viewportMatrix;
+        Box2 viewportBounds; // pixels the instance may draw to
+        Matrix4 modelMatrix;
+        Matrix4 normalMatrix;
+        Matrix4 projectionViewModelMatrix;
+        Vector3 cameraPositionModel;
+        float boundsScale; // how much the model matrix may stretch model-space lengths, e.g. bounding sphere radii
+    };
+
+    /**
+     * Must be called whenever objects are added or removed, or their mesh or material changes
+     */
+    void UpdateDrawOrder ();
+
+    /**
+     * Hands the assets that finished loading in the background over to the objects using them. Must be called between
+     * frames, when nothing is being drawn, so that every frame sees either all of a load or none of it.
+     */
+    void SwapInLoadedAssets ();
+
+    /**
+     * Runs the scene script again if it changed, and applies what changed to the objects, rather than loading the
+     * scene anew: objects that merely moved are placed in place, and the assets of those that stay are never
+     * unloaded. Also frees the objects removed by the previous reload, which the frame that was just finished may
+     * have drawn. Must be called between frames, when nothing is being drawn.
+     */
+    void ReloadScene ();
+
+    /**
+     * Removes the objects hidden behind occluders from m_visibleObjects
+     */
+    void CullOccludedObjects ();
+
+    /**
+     * Faces of one cluster of a mesh, as drawn for one instance
+     */
+    struct DrawCluster
+    {
+        Mesh::Triangle const* faces;
+        uint faceCount;
+        DrawInstance const* instance;
+        uint firstTriangle; // into m_triangles, which has a slot for each face
+    };
+
+    /**
+     * A line in screen space, ready to be rasterized
+     */
+    struct ScreenLine
+    {
+        Vector3 from, to;
+        ColorRGB color;
+        Box2 viewportBounds; // pixels the line may draw to
+    };
+
+    /**
+     * What executing a command buffer amounts to, in the order it was recorded in. Lives in the render stage's
+     * arenas, for one frame.
+     */
+    struct ExecutedCommands
+    {
+        explicit ExecutedCommands (FrameArena & arena)
+            : instances(ArenaAllocator<DrawInstance>(arena))
+            , drawClusters(ArenaAllocator<DrawCluster>(arena))
+            , lines(ArenaAllocator<ScreenLine>(arena))
+        {}
+
+        ArenaVector<DrawInstance> instances;
+        ArenaVector<DrawCluster> drawClusters;
+        ArenaVector<ScreenLine> lines;
+    };
+
+    /**
+     * A face in screen space, ready to be rasterized. Attributes are affine in screen space, so each is kept as its
+     * value at the top-left corner of the face's bounding box, along with its steps from one pixel to the next.
+     */
+    struct ScreenTriangle
+    {
+        Kernels::Span span; // at (xStart, yStart), with steps along x
+        float dl0, dl1, dl2, dz, du, dv, dintensity; // steps along y
+        uint xStart, yStart, yEnd; // rows [yStart, yEnd]; none if culled
+        ColorRGB debugColor;
+        TextureMap const* diffuseMap;
+        TextureSampler diffuseSampler;
+        float lod; // of the diffuse map; the same for every quad, as uv is affine in screen space
+    };
+
+    /**
+     * Scratch space for the pixels of one row of a face, as they go from one kernel to the next
+     */
+    struct RasterScratch
+    {
+        std::vector<uint32_t> fragmentOffsets;
+        std::vector<float> fragmentU, fragmentV, fragmentIntensities;
+        std::vector<ColorRGB> fragmentColors;
+        std::vector<ColorRGB> fragmentCoarseColors; // from the coarser of two mip levels, for trilinear filtering
+        Kernels::BlockCache blockCache; // tiles of compressed textures decoded lately, by the job using this scratch
+    };
+
+    /**
+     * Everything the render stage needs to draw a frame, captured by the update stage. Frames are pipelined: while
+     * the render stage draws one snapshot, the update stage fills in the other one for the next frame, so the two
+     * stages never share anything mutable. Meshes and textures are immutable, so they're pointed to as is.
+     */
+    struct FrameSnapshot
+    {
+        Camera camera;
+        std::vector<Vector3> lights;
+        std::vector<CommandBuffer> objectCommands; // one per partition of the visible objects, each recorded by one job
+        CommandBuffer debugCommands;
+        std::vector<CommandBuffer const*> submissions; // in the order they're to be executed in
+    };
+
+    /**
+     * The screen is rasterized in horizontal bands of this many rows, each by one job
+     */
+    static constexpr uint BAND_HEIGHT = 32;
+
+    /**
+     * Visible objects are recorded into command buffers in partitions of this many, each by one job
+     */
+    static constexpr uint OBJECTS_PER_PARTITION = 256;
+
+    /**
+     * Records the given objects, in order
+     */
+    void RecordObjects (uint const* objectIndices, size_t const count, CommandBuffer & commands) const;
+
+    /**
+     * Turns the commands into instances and lines as seen by the frame's camera, and culls the instances' clusters.
+     * Instances of the same mesh with the same material that were recorded one after the other are drawn as one batch.
+     */
+    void ExecuteCommands (FrameSnapshot const& frame, CommandBuffer const& commands, ExecutedCommands & out) const;
+
+    /**
+     * Hands the update stage's snapshot over to the render stage, which draws it in the background; the update
+     * stage then moves on to the other snapshot. The previous frame must have been finished.
+     */
+    void BeginRender ();
+
+    /**
+     * Waits for the frame in flight, if any, to be drawn, helping out in the meantime. Returns whether there was one.
+     */
+    bool FinishRender ();
+
+    /**
+     * Render stage. Executes every command buffer, then sets up every face in parallel, then rasterizes them band
+     * by band, also in parallel, and finally draws the lines on top. Within a band, faces are drawn in the order
+     * they were submitted in, so that the frame doesn't depend on the scheduling. Everything it needs for the frame
+     * only is allocated from m_renderArenas.
+     */
+    void DrawSnapshot (FrameSnapshot & frame);
+    void SetupTriangle (FrameSnapshot const& frame, Mesh::Triangle const& face, DrawInstance const& instance, ScreenTriangle & out) const;
+    void RasterizeTriangle (ScreenTriangle const& triangle, uint const yBegin, uint const yEnd, RasterScratch & scratch);
+
+    /**
+     * Reports the front-most object under the given window coordinates
+     */
+    void PickObject (int const x, int const y);
+
+    /**
+     * Draws the FPS, the heap allocations (and usage, per subsystem, when tracked) and the profiler's timings on top
+     * of the rendered frame. Allocations are those of the last frame, all threads included; none are expected once
+     * warmed up.
+     */
+    void DrawOverlay (size_t const elapsed);
+
+    /**
+     * Writes the memory usage of every subsystem to a file; cf. MemoryTracker. Pressing M does it on demand.
+     */
+    void DumpMemoryUsage () const;
 
     size_t m_targetFrameRate; // FPS
     size_t m_fixedUpdateTimeStep; // milliseconds, normally synced to target frame rate
@@ -69,10 +280,33 @@ private:
     // the Observer pattern in due time...
     float m_screenWidth;
     float m_screenHeight;
+    TextureFilter m_textureFilter = TextureFilter::TRILINEAR;
     std::vector<float> m_zBuffer;
+    std::vector<RasterScratch> m_rasterScratch; // one per band
+
+    FrameArenas m_renderArenas; // the render stage's scratch space, reset once each frame has been drawn
+
+    std::shared_ptr<LuaContext> m_pScriptContext;
+    std::unique_ptr<LuaSceneLoader> m_pSceneLoader; // runs the scene script once, for every factory
+    bool m_hotReload = true;
+    std::unique_ptr<FileWatcher> m_pSceneWatcher; // if hot reloading
 
+    AssetRegistry m_assets;
     Object3DFactory m_objectFactory;
+    TransformSystem m_transforms; // declared before m_objects, which point into it
     std::vector<Object3D> m_objects;
+    std::vector<size_t> m_sceneObjectCounts; // objects made from each of the scene script's top-level objects, in order
+    std::vector<Object3D> m_removedObjects; // by the last reload, until the frame that may have drawn them is finished
+    std::vector<uint> m_drawOrder; // indices into m_objects, grouped by mesh and material
+    std::vector<uint> m_drawRank; // position of each object in m_drawOrder
+    std::vector<uint> m_visibleObjects; // scratch space for the objects found by the frustum query
+    std::vector<BVH::RayHit> m_rayHits; // scratch space for picking
+    BVH m_bvh; // declared after m_objects, as it unregisters itself from them upon destruction
+    OcclusionBuffer m_occlusionBuffer;
+    CommandBuffer m_sceneCommands; // recorded by the scene script once, and drawn every frame
+    FrameSnapshot m_frames[2];
+    uint m_updateFrame = 0; // snapshot being filled in by the update stage; the other one belongs to the render stage
+    JobSystem::Job* m_renderJob = nullptr; // frame in flight
     std::vector<Vector3> m_lights;
 
     Camera m_camera;
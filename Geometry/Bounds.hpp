@@ -0,0 +1,99 @@
+#ifndef Bounds_hpp
+#define Bounds_hpp
+
+#include "global.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "Vector.hpp"
+#include "Matrix.hpp"
+
+/**
+ * Sphere that fully encloses some piece of geometry. Cheapest possible volume to test against planes.
+ */
+struct BoundingSphere
+{
+   Vector3 center;
+   float radius = 0.f;
+};
+
+/**
+ * Axis-aligned bounding box. A default-constructed box is empty (inverted), so that extending it
+ * with the first point yields a box around just that point.
+ */
+struct AABB
+{
+   Vector3 min = Vector3(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+   Vector3 max = Vector3(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+
+   bool Empty () const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+   Vector3 Center () const { return (min + max) * 0.5f; }
+   Vector3 Extents () const { return (max - min) * 0.5f; } // half-size along each axis
+
+   void Extend (Vector3 const& p)
+   {
+      for (uint i = 0; i < 3; ++i)
+      {
+         min[i] = std::min(min[i], p[i]);
+         max[i] = std::max(max[i], p[i]);
+      }
+   }
+
+   void Extend (AABB const& other)
+   {
+      for (uint i = 0; i < 3; ++i)
+      {
+         min[i] = std::min(min[i], other.min[i]);
+         max[i] = std::max(max[i], other.max[i]);
+      }
+   }
+
+   /**
+    * Tightest AABB around this box after it has been transformed by the given affine matrix.
+    * Much cheaper than transforming all 8 corners (Arvo, Graphics Gems, 1990): each component
+    * of the result is the translation plus, for each input axis, the smaller/larger of the two
+    * products with the box's extremes.
+    */
+   AABB Transformed (Matrix4 const& m) const
+   {
+      if (Empty()) return *this;
+
+      AABB result;
+      for (uint i = 0; i < 3; ++i)
+      {
+         result.min[i] = result.max[i] = m(i, 3);
+         for (uint j = 0; j < 3; ++j)
+         {
+            float const a = m(i, j) * min[j];
+            float const b = m(i, j) * max[j];
+            result.min[i] += std::min(a, b);
+            result.max[i] += std::max(a, b);
+         }
+      }
+      return result;
+   }
+
+   float SurfaceArea () const
+   {
+      if (Empty()) return 0.f;
+      Vector3 const d = max - min;
+      return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+   }
+};
+
+inline bool Intersects (AABB const& box, BoundingSphere const& sphere)
+{
+   // Squared distance from the sphere center to the closest point of the box
+   float distanceSquared = 0.f;
+   for (uint i = 0; i < 3; ++i)
+   {
+      float const v = sphere.center[i];
+      if (v < box.min[i]) distanceSquared += (box.min[i] - v) * (box.min[i] - v);
+      else if (v > box.max[i]) distanceSquared += (v - box.max[i]) * (v - box.max[i]);
+   }
+   return distanceSquared <= sphere.radius * sphere.radius;
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "global.hpp"
 
+#include <algorithm>
 #include <type_traits>
 #include <cassert>
 
@@ -18,7 +19,7 @@ struct Box2Type
 
    point_type bottomLeft, topRight;
 
-   Box2Type (point_type const& _bottomLeft={0, 0}, point_type const& _topRight={0, 0})
+   Box2Type (point_type const& _bottomLeft=point_type(0, 0), point_type const& _topRight=point_type(0, 0))
       : bottomLeft(_bottomLeft), topRight(_topRight)
    {
       assert(bottomLeft.y <= topRight.y);
@@ -41,6 +42,35 @@ struct Box2Type
 
       return {bottomLeftClipped, topRightClipped};
    }
+
+   /**
+    * Clips the segment from + t * (to - from), t in [0, 1], to the box (Liang-Barsky). Returns whether any of it is
+    * left, in which case [tEnter, tExit] is the part that is.
+    */
+   bool ClipSegment (point_type const& from, point_type const& to, Numeric & tEnter, Numeric & tExit) const
+   {
+      static_assert(std::is_floating_point<Numeric>::value, "Segments are clipped parametrically");
+
+      point_type const delta = to - from;
+      Numeric const p[4] = { -delta.x, delta.x, -delta.y, delta.y };
+      Numeric const q[4] = { from.x - bottomLeft.x, topRight.x - from.x, from.y - bottomLeft.y, topRight.y - from.y };
+
+      tEnter = 0;
+      tExit = 1;
+      for (uint i = 0; i < 4; ++i)
+      {
+         if (p[i] == 0)
+         {
+            if (q[i] < 0) return false; // parallel to this edge, and outside of it
+            continue;
+         }
+
+         Numeric const t = q[i] / p[i];
+         if (p[i] < 0) tEnter = std::max(tEnter, t);
+         else tExit = std::min(tExit, t);
+      }
+      return tEnter <= tExit;
+   }
 };
 
 typedef Box2Type<uint>  Box2UInt;
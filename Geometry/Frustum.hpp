@@ -0,0 +1,155 @@
+#ifndef Frustum_hpp
+#define Frustum_hpp
+
+#include "global.hpp"
+
+#include <array>
+
+#include "Vector.hpp"
+#include "Matrix.hpp"
+#include "Bounds.hpp"
+
+/**
+ * Plane in normal-distance form, i.e. all points p for which Dot(normal, p) + d = 0.
+ * Points with a positive signed distance are on the side that the normal points towards.
+ */
+struct Plane
+{
+   Vector3 normal;
+   float d = 0.f;
+
+   float SignedDistance (Vector3 const& p) const { return Dot(normal, p) + d; }
+};
+
+/**
+ * The six planes bounding the volume that is visible to a camera. All plane normals point inwards.
+ */
+class Frustum
+{
+public:
+   // Not named NEAR/FAR because windef.h defines those as macros
+   enum PlaneId
+   {
+      PLANE_LEFT = 0,
+      PLANE_RIGHT,
+      PLANE_BOTTOM,
+      PLANE_TOP,
+      PLANE_NEAR,
+      PLANE_FAR,
+      PLANE_COUNT
+   };
+
+   typedef std::array<Plane, PLANE_COUNT> planes_type;
+
+   enum Containment
+   {
+      OUTSIDE,
+      INTERSECTING,
+      INSIDE
+   };
+
+private:
+   planes_type m_planes;
+
+public:
+   Frustum () {}
+
+   /**
+    * Extracts the planes from a combined projection-view matrix, such that the resulting frustum
+    * is expressed in world space (Gribb & Hartmann). Since a point v is inside the clip volume
+    * iff -w <= x, y, z <= w, each plane is simply the sum or difference of the last row and
+    * one of the other rows of the matrix.
+    */
+   explicit Frustum (Matrix4 const& projectionView)
+   {
+      auto const& r0 = projectionView.Row(0);
+      auto const& r1 = projectionView.Row(1);
+      auto const& r2 = projectionView.Row(2);
+      auto const& r3 = projectionView.Row(3);
+
+      SetPlane(PLANE_LEFT,   r3 + r0);
+      SetPlane(PLANE_RIGHT,  r3 - r0);
+      SetPlane(PLANE_BOTTOM, r3 + r1);
+      SetPlane(PLANE_TOP,    r3 - r1);
+      SetPlane(PLANE_NEAR,   r3 + r2);
+      SetPlane(PLANE_FAR,    r3 - r2);
+   }
+
+   planes_type const& Planes () const { return m_planes; }
+   Plane const& operator[] (uint const index) const { return m_planes[index]; }
+
+   /**
+    * Conservative test: may report an intersection for spheres that are just outside a corner of the frustum
+    */
+   bool Intersects (BoundingSphere const& sphere) const
+   {
+      for (auto const& plane : m_planes)
+      {
+         if (plane.SignedDistance(sphere.center) < -sphere.radius)
+            return false;
+      }
+      return true;
+   }
+
+   /**
+    * Conservative test: may report an intersection for boxes that are just outside a corner of the frustum
+    */
+   bool Intersects (AABB const& box) const
+   {
+      for (auto const& plane : m_planes)
+      {
+         // Only the corner furthest along the plane normal (the "positive vertex") needs to be tested
+         Vector3 positive(
+            plane.normal.x >= 0 ? box.max.x : box.min.x,
+            plane.normal.y >= 0 ? box.max.y : box.min.y,
+            plane.normal.z >= 0 ? box.max.z : box.min.z
+         );
+         if (plane.SignedDistance(positive) < 0)
+            return false;
+      }
+      return true;
+   }
+
+   /**
+    * Like Intersects, but also tells whether the box is entirely inside, which lets hierarchical
+    * culling accept whole subtrees without testing them any further
+    */
+   Containment Classify (AABB const& box) const
+   {
+      Containment result = INSIDE;
+      for (auto const& plane : m_planes)
+      {
+         // Positive vertex decides whether the box is outside, negative vertex whether it straddles the plane
+         Vector3 positive, negative;
+         for (uint i = 0; i < 3; ++i)
+         {
+            bool const towardsMax = plane.normal[i] >= 0;
+            positive[i] = towardsMax ? box.max[i] : box.min[i];
+            negative[i] = towardsMax ? box.min[i] : box.max[i];
+         }
+         if (plane.SignedDistance(positive) < 0)
+            return OUTSIDE;
+         if (plane.SignedDistance(negative) < 0)
+            result = INTERSECTING;
+      }
+      return result;
+   }
+
+private:
+   void SetPlane (PlaneId const id, Vector4 const& coefficients)
+   {
+      // Normalize so that SignedDistance yields real distances, which the sphere test relies upon
+      Vector3 normal = coefficients.xyz();
+      float const length = Magnitude(normal);
+      if (length == 0.f)
+      {
+         // Degenerate matrix (e.g. camera not set up yet); leave a plane that culls nothing
+         m_planes[id] = Plane();
+         return;
+      }
+      m_planes[id].normal = normal / length;
+      m_planes[id].d = coefficients.w / length;
+   }
+};
+
+#endif
@@ -3,17 +3,45 @@
 
 #include <memory>
 
+#include "AssetHandle.hpp"
 #include "Texture.hpp"
+#include "StreamedTexture.hpp"
 
+/**
+ * Materials are immutable once built, and so are the textures they reference, which lets many
+ * objects share both.
+ */
 class Material
 {
-   std::unique_ptr<TextureMap> m_diffuseMap;
+   std::shared_ptr<TextureMap const> m_diffuseMap;
+   std::shared_ptr<StreamedTexture const> m_diffuseStream; // instead of the map, if streamed
+   std::shared_ptr<AssetHandle<TextureMap> const> m_diffuseHandle; // instead of the map, if loaded in the background
+   TextureSampler m_diffuseSampler;
 
    friend class Object3DFactory;
 
 public:
-   TextureMap const* DiffuseMap () const { return m_diffuseMap.get(); }
-   void DiffuseMap (std::unique_ptr<TextureMap> diffuseMap) { m_diffuseMap = std::move(diffuseMap); }
+   TextureMap const* DiffuseMap () const
+   {
+      if (m_diffuseStream) return m_diffuseStream->Current();
+      if (m_diffuseHandle) return m_diffuseHandle->Get().get(); // none until loaded
+      return m_diffuseMap.get();
+   }
+   void DiffuseMap (std::shared_ptr<TextureMap const> diffuseMap) { m_diffuseMap = std::move(diffuseMap); }
+
+   /**
+    * The diffuse map, as it's being loaded in the background; until then, the material has none
+    */
+   void DiffuseMap (std::shared_ptr<AssetHandle<TextureMap> const> diffuseHandle) { m_diffuseHandle = std::move(diffuseHandle); }
+
+   /**
+    * The streamed texture behind the diffuse map, if any, whose resolution changes from one frame to the next
+    */
+   StreamedTexture const* DiffuseStream () const { return m_diffuseStream.get(); }
+   void DiffuseStream (std::shared_ptr<StreamedTexture const> diffuseStream) { m_diffuseStream = std::move(diffuseStream); }
+
+   TextureSampler const& DiffuseSampler () const { return m_diffuseSampler; }
+   void DiffuseSampler (TextureSampler const& sampler) { m_diffuseSampler = sampler; }
 };
 
 #endif
@@ -3,8 +3,10 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
 #include "Util.hpp"
+#include "MemoryTracker.hpp"
 
 static std::vector<std::string> split (std::string const& s, char delim)
 {
@@ -22,9 +24,24 @@ static std::vector<std::string> split (std::string const& s, char delim)
     return std::move(tokens);
 }
 
+/**
+ * Stream buffer that reads from memory it doesn't own, without copying it
+ */
+class MemoryStreamBuffer : public std::streambuf
+{
+public:
+    MemoryStreamBuffer (char const* data, size_t const size)
+    {
+        char* begin = const_cast<char*>(data); // never written to, as the buffer is only ever read from
+        setg(begin, begin, begin + size);
+    }
+};
+
 // TODO: Should separate into a MeshLoader interface
 std::unique_ptr<Mesh> Mesh::MakeFromOBJ (std::string const& fileName)
 {
+    MEMORY_SCOPE(MESHES);
+
     // Attempt to open file
     std::ifstream ifs(fileName, std::ifstream::in);    
 
@@ -35,6 +52,20 @@ std::unique_ptr<Mesh> Mesh::MakeFromOBJ (std::string const& fileName)
         return 0;
     }
 
+    return ParseOBJ(ifs, fileName);
+}
+
+std::unique_ptr<Mesh> Mesh::MakeFromOBJ (char const* data, size_t const size, std::string const& name)
+{
+    MEMORY_SCOPE(MESHES);
+
+    MemoryStreamBuffer buffer(data, size);
+    std::istream is(&buffer);
+    return ParseOBJ(is, name);
+}
+
+std::unique_ptr<Mesh> Mesh::ParseOBJ (std::istream & ifs, std::string const& fileName)
+{
     std::vector<Vector3> vertices;
     std::vector<Vector2> vertexTextureCoords;
     std::vector<Vector3> vertexNormals;
@@ -164,6 +195,8 @@ std::unique_ptr<Mesh> Mesh::MakeFromOBJ (std::string const& fileName)
             triangle.m_normal = Normalized(Cross(triangle[1].xyz() - triangle[0].xyz(), triangle[2].xyz() - triangle[0].xyz()));
             pMesh->m_faces.push_back(triangle);
         }
+        pMesh->ComputeBounds();
+        pMesh->BuildClusters();
         return pMesh;
     }
     else if (ifs.bad())
@@ -174,4 +207,146 @@ std::unique_ptr<Mesh> Mesh::MakeFromOBJ (std::string const& fileName)
     }
 
     return nullptr;
-}
\ No newline at end of file
+}
+
+/**
+ * Spreads the lower 10 bits of `v` so that there are two zero bits between each of them
+ */
+static uint32_t SpreadBits10 (uint32_t v)
+{
+    v &= 0x3FF;
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v <<  8)) & 0x0300F00F;
+    v = (v | (v <<  4)) & 0x030C30C3;
+    v = (v | (v <<  2)) & 0x09249249;
+    return v;
+}
+
+std::unique_ptr<Mesh> Mesh::WithUVTransform (Vector2 const& scale, Vector2 const& offset) const
+{
+    MEMORY_SCOPE(MESHES);
+
+    // Only uvs change, so the bounds and clusters stay valid
+    std::unique_ptr<Mesh> pMesh(new Mesh(*this));
+    for (auto & face : pMesh->m_faces)
+    {
+        for (auto & vertex : face.m_vertices)
+            vertex.m_uv = vertex.m_uv * scale + offset;
+    }
+    return pMesh;
+}
+
+void Mesh::ComputeBounds ()
+{
+    m_bounds = AABB();
+    for (auto const& face : m_faces)
+    {
+        for (int i = 0; i < 3; ++i)
+            m_bounds.Extend(face[i].xyz());
+    }
+
+    // Centered on the box, which is a little looser than a minimal sphere but much simpler to compute
+    m_boundingSphere = BoundingSphere();
+    if (m_bounds.Empty()) return;
+    m_boundingSphere.center = m_bounds.Center();
+    for (auto const& face : m_faces)
+    {
+        for (int i = 0; i < 3; ++i)
+            m_boundingSphere.radius = std::max(m_boundingSphere.radius, Magnitude(face[i].xyz() - m_boundingSphere.center));
+    }
+}
+
+void Mesh::BuildClusters ()
+{
+    m_clusters.clear();
+    if (m_faces.empty()) return;
+
+    // Group faces by the dominant axis of their normal (i.e. which face of a cube the normal points to), which
+    // keeps every cluster's normal cone within roughly 55 degrees of its axis. Within each group, sort faces
+    // along a Z-order (Morton) curve through their centroids, so that every run of consecutive faces is
+    // spatially compact. OBJ exporters give no such guarantee.
+    Vector3 const& lower = m_bounds.min;
+    Vector3 const extent = m_bounds.max - m_bounds.min;
+
+    std::vector<std::pair<uint64_t, uint>> keys(m_faces.size());
+    for (uint f = 0; f < m_faces.size(); ++f)
+    {
+        Vector3 const& normal = m_faces[f].Normal();
+        uint axis = 0;
+        for (uint c = 1; c < 3; ++c)
+        {
+            if (fabsf(normal[c]) > fabsf(normal[axis])) axis = c;
+        }
+        uint64_t const group = 2 * axis + (normal[axis] < 0 ? 1 : 0);
+
+        Vector3 const centroid = (m_faces[f][0].xyz() + m_faces[f][1].xyz() + m_faces[f][2].xyz()) / 3.f;
+        uint32_t code = 0;
+        for (int c = 0; c < 3; ++c)
+        {
+            float const t = extent[c] > 0 ? (centroid[c] - lower[c]) / extent[c] : 0.f;
+            code |= SpreadBits10(static_cast<uint32_t>(t * 1023.f)) << c;
+        }
+        keys[f] = std::make_pair((group << 32) | code, f);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    faces_type sortedFaces;
+    sortedFaces.reserve(m_faces.size());
+    for (auto const& key : keys)
+        sortedFaces.push_back(m_faces[key.second]);
+    m_faces = std::move(sortedFaces);
+
+    // Partition each group into clusters and compute their bounds
+    uint const faceCount = m_faces.size();
+    for (uint first = 0; first < faceCount; )
+    {
+        Cluster cluster;
+        cluster.firstFace = first;
+        uint64_t const group = keys[first].first >> 32;
+        uint last = first + 1;
+        while (last < faceCount && last - first < Cluster::MAX_FACES && (keys[last].first >> 32) == group)
+            ++last;
+        cluster.faceCount = last - first;
+
+        // Bounding sphere: centered on the AABB of the cluster, which is good enough for compact clusters
+        AABB clusterBox;
+        Vector3 normalSum;
+        for (uint f = first; f < last; ++f)
+        {
+            for (int i = 0; i < 3; ++i)
+                clusterBox.Extend(m_faces[f][i].xyz());
+            // Degenerate faces have a NaN normal, which would poison the sum
+            Vector3 const& normal = m_faces[f].Normal();
+            if (Dot(normal, normal) > 0)
+                normalSum += normal;
+        }
+        cluster.bounds.center = clusterBox.Center();
+        for (uint f = first; f < last; ++f)
+        {
+            for (int i = 0; i < 3; ++i)
+                cluster.bounds.radius = std::max(cluster.bounds.radius, Magnitude(m_faces[f][i].xyz() - cluster.bounds.center));
+        }
+
+        // Normal cone: the axis is the average normal, and the half-angle is that of the normal furthest from it
+        float const normalSumLength = Magnitude(normalSum);
+        if (normalSumLength > 0)
+        {
+            cluster.coneAxis = normalSum / normalSumLength;
+
+            float minCos = 1.f;
+            for (uint f = first; f < last; ++f)
+            {
+                float const cosine = Dot(cluster.coneAxis, m_faces[f].Normal());
+                if (cosine == cosine) // skip NaN
+                    minCos = std::min(minCos, cosine);
+            }
+
+            // A cone of half-angle >= 90 degrees can never be entirely back-facing, so keep the "never cull" cutoff
+            if (minCos > 0)
+                cluster.coneCutoff = sqrtf(1.f - minCos * minCos);
+        }
+
+        m_clusters.push_back(cluster);
+        first = last;
+    }
+}
@@ -2,12 +2,14 @@
 #define Mesh_hpp
 
 #include <array>
+#include <iosfwd>
 #include <vector>
 #include <memory>
 #include <string>
 
 #include "Vector.hpp"
 #include "Color.hpp"
+#include "Bounds.hpp"
 
 /**
  * Triangular mesh of a 3D object
@@ -62,16 +64,90 @@ public:
     typedef Triangle face_type;
     typedef std::vector<face_type> faces_type;
 
+    /**
+     * Small contiguous run of faces (a "meshlet") that can be culled as a whole, before any per-face work.
+     * All values are in model space.
+     */
+    struct Cluster
+    {
+        static constexpr uint MAX_FACES = 64;
+
+        uint firstFace = 0;
+        uint faceCount = 0;
+
+        /**
+         * Encloses every vertex of every face in the cluster
+         */
+        BoundingSphere bounds;
+
+        /**
+         * Every face normal in the cluster is within the cone around this axis. coneCutoff is the sine of the
+         * cone's half-angle; a cutoff of 1 means the normals are too spread out for the cone to be useful.
+         */
+        Vector3 coneAxis;
+        float coneCutoff = 1.f;
+
+        /**
+         * Conservative test of whether every face in the cluster faces away from a viewer at the given position.
+         * The position must be in the same (model) space as the cluster. Since the sign of Dot(normal, p - viewer)
+         * is preserved by any affine transformation, this holds for any model matrix.
+         */
+        bool IsBackFacingFrom (Vector3 const& viewerPosition) const
+        {
+            Vector3 const toCenter = bounds.center - viewerPosition;
+            return Dot(toCenter, coneAxis) >= coneCutoff * Magnitude(toCenter) + bounds.radius;
+        }
+    };
+
+    typedef std::vector<Cluster> clusters_type;
+
 private:
     faces_type m_faces;
+    clusters_type m_clusters;
+
+    AABB m_bounds;
+    BoundingSphere m_boundingSphere;
+
+    /**
+     * Computes the model-space bounding volumes. Must be called whenever the faces change.
+     */
+    void ComputeBounds ();
+
+    /**
+     * Reorders the faces so that spatially close faces are adjacent, then partitions them into clusters.
+     * Must be called whenever the faces change.
+     */
+    void BuildClusters ();
+
+    /**
+     * Reads an OBJ file's contents from the stream; `fileName` is only for messages
+     */
+    static std::unique_ptr<Mesh> ParseOBJ (std::istream & ifs, std::string const& fileName);
 
 public:
     Mesh () {}
     faces_type const& GetFaces () const { return m_faces; }
+    clusters_type const& GetClusters () const { return m_clusters; }
+
+    /**
+     * Model-space bounding volumes
+     */
+    AABB const& GetBounds () const { return m_bounds; }
+    BoundingSphere const& GetBoundingSphere () const { return m_boundingSphere; }
 
 
     // TODO: Should separate into a MeshLoader interface
     static std::unique_ptr<Mesh> MakeFromOBJ (std::string const& fileName);
+
+    /**
+     * Same as above, from an OBJ file's contents already in memory, e.g. in an asset pack, which are read in place
+     */
+    static std::unique_ptr<Mesh> MakeFromOBJ (char const* data, size_t const size, std::string const& name);
+
+    /**
+     * Copy of the mesh with every uv scaled, then offset, e.g. to point into a texture atlas instead
+     */
+    std::unique_ptr<Mesh> WithUVTransform (Vector2 const& scale, Vector2 const& offset) const;
 };
 
 #endif
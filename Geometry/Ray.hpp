@@ -0,0 +1,44 @@
+#ifndef Ray_hpp
+#define Ray_hpp
+
+#include "global.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "Vector.hpp"
+#include "Bounds.hpp"
+
+struct Ray
+{
+   Vector3 origin;
+   Vector3 direction; // expected to be of unit length
+
+   Ray () {}
+   Ray (Vector3 const& _origin, Vector3 const& _direction) : origin(_origin), direction(_direction) {}
+
+   Vector3 At (float const t) const { return origin + direction * t; }
+
+   /**
+    * Slab test. On a hit, `tNear` is the distance along the ray at which it enters the box, which is 0 if the
+    * origin is inside the box. Axis-parallel rays work thanks to IEEE infinities.
+    */
+   bool Intersects (AABB const& box, float & tNear, float const maxDistance=std::numeric_limits<float>::max()) const
+   {
+      float tMin = 0.f, tMax = maxDistance;
+      for (uint i = 0; i < 3; ++i)
+      {
+         float const inverse = 1.f / direction[i];
+         float t0 = (box.min[i] - origin[i]) * inverse;
+         float t1 = (box.max[i] - origin[i]) * inverse;
+         if (t0 > t1) std::swap(t0, t1);
+         tMin = std::max(tMin, t0);
+         tMax = std::min(tMax, t1);
+         if (tMin > tMax) return false;
+      }
+      tNear = tMin;
+      return true;
+   }
+};
+
+#endif
@@ -1,59 +1,95 @@
 #include "SDLTextureLoader.hpp"
 
-#include <cassert>
+#include <algorithm>
+#include <atomic>
 
 #include "SDL.h"
 #include "SDL_image.h"
 #include "Color.hpp"
+#include "JobSystem.hpp"
+#include "MemoryTracker.hpp"
 
-// Courtesy of http://sdl.beuc.net/sdl.wiki/Pixel_Access
-Uint32 GetRawPixelFromSurface (SDL_Surface * surface, int const index)
-{
-   /*
-    * This algorithm takes into account the fact that image data in a surface might not always be described
-    * using 4 bytes per pixel. (This can actually vary across platforms for the exact same image file! For example,
-    * on my macbook pro the same file was described with 4 bytes per pixel whereas on my Windows 7 desktop it was
-    * 3 bytes per pixel).
-    */
-
-   int bpp = surface->format->BytesPerPixel;
-   
-   // The smallest possible bpp is 1 byte, so we start with a byte-pointer to the pixel and handle all the valid cases thereafter
-   Uint8 * p = (Uint8 *)surface->pixels + index * bpp;
+/**
+ * Rows of pixels converted per job; big enough to be worth a job, small enough for 4K textures to spread over every
+ * worker
+ */
+static constexpr uint DECODE_BAND_PIXELS = 64 * 1024;
 
-   switch (bpp) {
-      case 1:
-         return *p;
-         break;
+/**
+ * Converts the surface's pixels to the engine's format, i.e. ColorRGB, a band of rows per job. SDL's RGBA8888 is
+ * ColorRGB's layout as is; only alpha, which ColorRGB has no use for, is set to opaque.
+ */
+static bool DecodeSurface (SDL_Surface* surface, TextureMap::PixelBuffer & pixels)
+{
+   uint const width = uint(surface->w), height = uint(surface->h);
+   pixels.resize(size_t(width) * height);
 
-      case 2:
-         return *(Uint16 *)p;
-         break;
+   // SDL_ConvertPixels() doesn't do palettes, so those surfaces are converted in one go instead
+   SDL_Surface* converted = nullptr;
+   if (SDL_ISPIXELFORMAT_INDEXED(surface->format->format))
+   {
+      converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA8888, 0);
+      if (converted == nullptr) return false;
+      surface = converted;
+   }
 
-      case 3:
-         if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
-            return p[0] << 16 | p[1] << 8 | p[2];
-         else
-            return p[0] | p[1] << 8 | p[2] << 16;
-         break;
+   bool const locked = SDL_MUSTLOCK(surface);
+   if (locked && SDL_LockSurface(surface) != 0)
+   {
+      SDL_FreeSurface(converted);
+      return false;
+   }
 
-      case 4:
-         return *(Uint32 *)p;
-         break;
+   std::atomic<bool> failed(false);
+   uint const grain = std::max(1u, DECODE_BAND_PIXELS / std::max(1u, width));
+   JobSystem::Instance().ParallelFor(height, grain, [&] (uint const begin, uint const end) {
+      ColorRGB* out = &pixels[size_t(begin) * width];
+      if (surface->format->format == SDL_PIXELFORMAT_RGBA8888)
+      {
+         for (uint y = begin; y < end; ++y)
+         {
+            auto const* row = reinterpret_cast<Uint32 const*>(static_cast<Uint8 const*>(surface->pixels) + size_t(y) * surface->pitch);
+            std::copy(row, row + width, out + size_t(y - begin) * width);
+         }
+      }
+      else
+      {
+         // Rows are pitch bytes apart in the surface, which may be more than the pixels take
+         void const* in = static_cast<Uint8 const*>(surface->pixels) + size_t(begin) * surface->pitch;
+         if (SDL_ConvertPixels(int(width), int(end - begin), surface->format->format, in, surface->pitch,
+               SDL_PIXELFORMAT_RGBA8888, out, int(width * sizeof(ColorRGB))) != 0)
+         {
+            failed.store(true, std::memory_order_relaxed);
+            return;
+         }
+      }
+      for (ColorRGB* pixel = out; pixel != out + size_t(end - begin) * width; ++pixel)
+         *pixel |= 0xFF;
+   });
 
-      default:
-         // We don't support any other valid (> 4) or invalid (< 1) bytes per pixel
-         assert(false);
-         return 0;
-   }
+   if (locked) SDL_UnlockSurface(surface);
+   SDL_FreeSurface(converted);
+   return !failed.load(std::memory_order_relaxed);
 }
 
 std::unique_ptr<TextureMap> SDLTextureLoader::LoadFromFile (std::string fileName)
 {
+   MEMORY_SCOPE(TEXTURES);
+
    std::cout << "Loading texture from " << fileName << std::endl;
 
-   // Load textures
-   SDL_Surface* pTextureImage = IMG_Load(fileName.c_str());
+   // Load textures; SDL_image only tells some formats apart by their contents, so the extension goes along too
+   SDL_Surface* pTextureImage = nullptr;
+   AssetPack::Asset const asset = m_pPack ? m_pPack->Find(fileName) : AssetPack::Asset();
+   if (asset)
+   {
+      std::string const type = fileName.substr(fileName.find_last_of('.') + 1);
+      pTextureImage = IMG_LoadTyped_RW(SDL_RWFromConstMem(asset.data, int(asset.size)), 1, type.c_str());
+   }
+   else
+   {
+      pTextureImage = IMG_Load(fileName.c_str());
+   }
    if (pTextureImage == nullptr)
    {
       std::cerr << "Error loading texture " << fileName << " due to: " << IMG_GetError() << std::endl;
@@ -62,19 +98,16 @@ std::unique_ptr<TextureMap> SDLTextureLoader::LoadFromFile (std::string fileName
    else
    {
       // Extract raw pixel data
-      size_t totalPixels = pTextureImage->w * pTextureImage->h;
-      auto pixels = TextureMap::PixelBuffer(totalPixels);
-      for (size_t i = 0; i < totalPixels; ++i)
+      TextureMap::PixelBuffer pixels;
+      if (!DecodeSurface(pTextureImage, pixels))
       {
-         Uint32 color = GetRawPixelFromSurface(pTextureImage, i);
-         Uint8 r, g, b;
-         SDL_GetRGB(color, pTextureImage->format, &r, &g, &b);
-         ColorRGB finalColor = Color::Mix(r, g, b);
-         pixels[i] = finalColor;
+         std::cerr << "Error converting texture " << fileName << " due to: " << SDL_GetError() << std::endl;
+         SDL_FreeSurface(pTextureImage);
+         return nullptr;
       }
 
-      // Construct texture map
-      std::unique_ptr<TextureMap> pTexture(new TextureMap(pTextureImage->w, pTextureImage->h, std::move(pixels)));
+      // Construct texture map, along with its mips
+      std::unique_ptr<TextureMap> pTexture = TextureMap::MakeFromPixels(pTextureImage->w, pTextureImage->h, std::move(pixels), m_compress);
 
       // Destroy SDL data before proceeding
       SDL_FreeSurface(pTextureImage);
@@ -1,14 +1,26 @@
 #ifndef SDLTextureLoader_hpp
 #define SDLTextureLoader_hpp
 
+#include "AssetPack.hpp"
 #include "ITextureLoader.hpp"
 
 class SDLTextureLoader : virtual public ITextureLoader
 {
 public:
+   /**
+    * With `compress`, textures are compressed as they're loaded, mips included; cf. TextureCompression. Textures in
+    * the pack, if any, are decoded from it in place; others from their files.
+    */
+   explicit SDLTextureLoader (bool const compress=false, std::shared_ptr<AssetPack const> pPack=nullptr)
+      : m_compress(compress), m_pPack(std::move(pPack))
+   {}
    virtual ~SDLTextureLoader () {}
 
    std::unique_ptr<TextureMap> LoadFromFile (std::string fileName) override;   
+
+private:
+   bool m_compress;
+   std::shared_ptr<AssetPack const> m_pPack;
 };
 
 #endif
@@ -0,0 +1,65 @@
+#ifndef StreamedTexture_hpp
+#define StreamedTexture_hpp
+
+#include "global.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <memory>
+#include <string>
+
+#include "Texture.hpp"
+
+/**
+ * Texture whose finer mip levels come and go, as they're needed and as memory allows; cf. TextureStreamer. Until
+ * its file has been loaded once, it's a 1x1 placeholder.
+ *
+ * Current() is what gets sampled: the texture from some level down, i.e. at a fraction of its full resolution. It
+ * only ever changes between frames, while nothing is being drawn, so the render stage may use it as is.
+ */
+class StreamedTexture
+{
+public:
+   explicit StreamedTexture (std::string path, std::shared_ptr<TextureMap const> placeholder)
+      : m_path(std::move(path)), m_pCurrent(std::move(placeholder))
+   {}
+
+   TextureMap const* Current () const { return m_pCurrent.get(); }
+
+   /**
+    * Asks for the level that a face using Current() at the given level of detail needs. Called by the render stage,
+    * from any number of threads at once; the finest level asked for during a frame wins.
+    */
+   void Request (float const lod) const
+   {
+      // Levels of Current() are levels of the full texture, firstLevel down; below 0, it's magnified
+      int const level = m_loaded ? std::max(0, int(m_firstLevel) + int(std::floor(lod))) : UNKNOWN_LEVEL;
+      int wanted = m_wantedLevel.load(std::memory_order_relaxed);
+      while (level < wanted && !m_wantedLevel.compare_exchange_weak(wanted, level, std::memory_order_relaxed)) {}
+   }
+
+private:
+   friend class TextureStreamer;
+
+   static constexpr int NOT_WANTED = INT_MAX;
+   static constexpr int UNKNOWN_LEVEL = INT_MAX - 1; // drawn, but as a placeholder
+
+   std::string m_path;
+   std::shared_ptr<TextureMap const> m_pCurrent;
+
+   // All of the below is only touched between frames, by the streamer, except for m_wantedLevel
+   bool m_loaded = false; // at least once; until then, the full texture's size isn't even known
+   bool m_loading = false;
+   bool m_failed = false;
+   uint m_width = 1, m_height = 1; // of the full texture
+   uint m_levelCount = 1;
+   uint m_firstLevel = 0; // of the full texture, that Current() starts at
+   uint m_tailLevel = 0; // from which on levels are small enough to stay resident for good
+   uint m_neededLevel = 0; // as of the last frame that drew the texture
+   uint64_t m_lastUsedFrame = 0;
+   mutable std::atomic<int> m_wantedLevel{NOT_WANTED};
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "Texture.hpp"
+
+#include "JobSystem.hpp"
+
+/**
+ * Tiles compressed per job
+ */
+static constexpr uint COMPRESS_BATCH_TILES = 1024;
+
+/**
+ * Average of 4 colours, channel by channel, rounded to nearest
+ */
+static ColorRGB Average (ColorRGB const a, ColorRGB const b, ColorRGB const c, ColorRGB const d)
+{
+   ColorRGB result = 0;
+   for (uint shift = 0; shift < 32; shift += 8)
+   {
+      uint const sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff) + ((c >> shift) & 0xff) + ((d >> shift) & 0xff);
+      result |= ((sum + 2) / 4) << shift;
+   }
+   return result;
+}
+
+/**
+ * Appends the whole mip pyramid below the texture to its pixels, down to 1x1
+ */
+static std::vector<TextureMap::MipLevel> BuildMipPyramid (uint const width, uint const height, TextureMap::PixelBuffer & pixels)
+{
+   std::vector<TextureMap::MipLevel> mips{{width, height, 0}};
+   size_t total = size_t(width) * height;
+   while (mips.back().width > 1 || mips.back().height > 1)
+   {
+      TextureMap::MipLevel const& above = mips.back();
+      TextureMap::MipLevel const level = {std::max(1u, above.width / 2), std::max(1u, above.height / 2), total};
+      total += size_t(level.width) * level.height;
+      mips.push_back(level);
+   }
+   pixels.resize(total); // once, as the levels are less than a third of the texture on top of it
+
+   for (size_t l = 1; l < mips.size(); ++l)
+   {
+      TextureMap::MipLevel const& above = mips[l - 1];
+      TextureMap::MipLevel const& level = mips[l];
+      ColorRGB const* in = &pixels[above.offset];
+      ColorRGB* out = &pixels[level.offset];
+      for (uint y = 0; y < level.height; ++y)
+      {
+         // A 1-texel dimension stays as is
+         ColorRGB const* row0 = in + size_t(std::min(2 * y, above.height - 1)) * above.width;
+         ColorRGB const* row1 = in + size_t(std::min(2 * y + 1, above.height - 1)) * above.width;
+         for (uint x = 0; x < level.width; ++x)
+         {
+            uint const x0 = std::min(2 * x, above.width - 1), x1 = std::min(2 * x + 1, above.width - 1);
+            out[size_t(y) * level.width + x] = Average(row0[x0], row0[x1], row1[x0], row1[x1]);
+         }
+      }
+   }
+
+   return mips;
+}
+
+std::unique_ptr<TextureMap> TextureMap::MakeFromPixels (uint const width, uint const height, PixelBuffer pixels, bool const compress)
+{
+   std::vector<MipLevel> mips = BuildMipPyramid(width, height, pixels);
+   return MakeFromPixels(width, height, pixels, mips, compress);
+}
+
+std::unique_ptr<TextureMap> TextureMap::MakeFromPixels (uint const width, uint const height, PixelBuffer const& pixels,
+   std::vector<MipLevel> const& mips, bool const compress)
+{
+   // Every level tiled, one after the other
+   std::vector<MipLevel> tiledMips = mips;
+   size_t tiledSize = 0;
+   for (auto & level : tiledMips)
+   {
+      level.offset = tiledSize;
+      tiledSize += TiledSize(level.width, level.height);
+   }
+   auto tiled = PixelBuffer(tiledSize);
+   for (size_t l = 0; l < mips.size(); ++l)
+   {
+      Tile(&pixels[mips[l].offset], mips[l].width, mips[l].height, &tiled[tiledMips[l].offset]);
+   }
+
+   if (!compress)
+      return std::make_unique<TextureMap>(width, height, std::move(tiled), std::move(tiledMips));
+
+   // Tiles are a block each, in the same order
+   uint const TEXELS_PER_BLOCK = TextureCompression::TEXELS_PER_BLOCK;
+   BlockBuffer blocks(tiled.size() / TEXELS_PER_BLOCK);
+   JobSystem::Instance().ParallelFor(uint(blocks.size()), COMPRESS_BATCH_TILES, [&] (uint const begin, uint const end) {
+      for (uint b = begin; b < end; ++b)
+         blocks[b] = TextureCompression::Encode(&tiled[size_t(b) * TEXELS_PER_BLOCK]);
+   });
+   return std::make_unique<TextureMap>(width, height, std::move(blocks), std::move(tiledMips));
+}
+
+std::unique_ptr<TextureMap> TextureMap::MakeFromLevels (TextureMap const& texture, uint const firstLevel)
+{
+   // Levels are one after the other, so the ones wanted are the tail end of the buffer
+   std::vector<MipLevel> mips(texture.m_mips.begin() + firstLevel, texture.m_mips.end());
+   size_t const start = mips.front().offset;
+   for (auto & level : mips)
+      level.offset -= start;
+
+   uint const width = mips.front().width, height = mips.front().height;
+   if (texture.IsCompressed())
+   {
+      BlockBuffer blocks(texture.m_blocks.begin() + start / TextureCompression::TEXELS_PER_BLOCK, texture.m_blocks.end());
+      return std::make_unique<TextureMap>(width, height, std::move(blocks), std::move(mips));
+   }
+   return std::make_unique<TextureMap>(width, height, PixelBuffer(texture.m_pixels.begin() + start, texture.m_pixels.end()), std::move(mips));
+}
@@ -3,12 +3,46 @@
 
 #include "global.hpp"
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 #include <cassert>
+#include <cmath>
 
 #include "Color.hpp"
+#include "TextureCompression.hpp"
 #include "Vector.hpp"
 
+/**
+ * How texels are picked and combined when sampling a texture. Every mode samples the mip level(s) whose texels are
+ * closest in size to the pixels being drawn, so that distant objects only touch the small, cache-resident levels.
+ */
+enum class TextureFilter
+{
+   NEAREST, // the nearest texel of the nearest level
+   BILINEAR, // the 4 nearest texels of the nearest level, weighted by distance
+   TRILINEAR // bilinear samples from the two nearest levels, weighted by the LOD's fraction
+};
+
+/**
+ * What uv outside of [0, 1] maps to, along one axis of a texture
+ */
+enum class TextureAddress
+{
+   CLAMP, // the nearest texel on the edge
+   REPEAT, // the texture, over and over
+   MIRROR // the texture, over and over, with every other copy flipped
+};
+
+/**
+ * How a material samples its textures, other than the filter, which is the renderer's to choose; cf. TextureFilter
+ */
+struct TextureSampler
+{
+   TextureAddress addressU = TextureAddress::CLAMP;
+   TextureAddress addressV = TextureAddress::CLAMP;
+};
+
 /**
  * Maps between a uv coordinate to pixel data from a texture
  */
@@ -16,26 +50,177 @@ class TextureMap
 {
 public:
    typedef std::vector<ColorRGB> PixelBuffer;
+   typedef std::vector<TextureCompression::Block> BlockBuffer;
+
+   /**
+    * One level of the mip pyramid, i.e. the texture scaled down by 2^level along each axis
+    */
+   struct MipLevel
+   {
+      uint width, height;
+      size_t offset; // of its first pixel in m_pixels, or, if compressed, 16 times that of its first block in m_blocks
+   };
 
    uint m_width, m_height;
 
    /**
-    * Should support 24-bit color values
+    * Texels are stored in square tiles of this many on a side, i.e. 64 bytes or one cache line per tile. Tiles are
+    * in row-major order, and so are texels within a tile, so that a texel's neighbours along either axis are most
+    * likely in the same line, however a face is rotated relative to the texture. Levels are padded to whole tiles.
+    */
+   static constexpr uint TILE_SIZE = 4;
+   static_assert(TILE_SIZE * TILE_SIZE == TextureCompression::TEXELS_PER_BLOCK, "A tile is compressed into one block");
+
+   /**
+    * Should support 24-bit color values. Holds every mip level, tiled, one after the other, from the largest (the
+    * texture itself) to the smallest.
     */
    PixelBuffer m_pixels;
 
+   /**
+    * Instead of the pixels, if compressed: a block per tile, in the same order
+    */
+   BlockBuffer m_blocks;
+
+   std::vector<MipLevel> m_mips;
+
 public:
-   TextureMap (uint width, uint height, PixelBuffer const& pixels)
-      : m_width(width), m_height(height), m_pixels(pixels)
+   /**
+    * Texture without mips; `pixels` only holds the texture itself, tiled
+    */
+   TextureMap (uint width, uint height, PixelBuffer pixels)
+      : m_width(width), m_height(height), m_pixels(std::move(pixels)), m_mips{{width, height, 0}}
    {}
 
-   ColorRGB Map (Vector2 const& uv ) const { return Map(uv.x, uv.y); }
-   ColorRGB Map (float const u, float const v) const
+   TextureMap (uint width, uint height, PixelBuffer pixels, std::vector<MipLevel> mips)
+      : m_width(width), m_height(height), m_pixels(std::move(pixels)), m_mips(std::move(mips))
+   {
+      assert(!m_mips.empty() && m_mips[0].width == width && m_mips[0].height == height);
+   }
+
+   /**
+    * Compressed texture, mips included
+    */
+   TextureMap (uint width, uint height, BlockBuffer blocks, std::vector<MipLevel> mips)
+      : m_width(width), m_height(height), m_blocks(std::move(blocks)), m_mips(std::move(mips))
+   {
+      assert(!m_mips.empty() && m_mips[0].width == width && m_mips[0].height == height);
+   }
+
+   /**
+    * Texture from row-major pixels, with its mip pyramid down to 1x1, compressed if asked to. Each level is a 2x2 box
+    * filter of the one above; along an odd dimension, the last row or column is left out.
+    */
+   static std::unique_ptr<TextureMap> MakeFromPixels (uint const width, uint const height, PixelBuffer pixels, bool const compress);
+
+   /**
+    * Texture from the row-major pixels of every level, one after the other as `mips` says, compressed if asked to
+    */
+   static std::unique_ptr<TextureMap> MakeFromPixels (uint const width, uint const height, PixelBuffer const& pixels,
+      std::vector<MipLevel> const& mips, bool const compress);
+
+   /**
+    * Copy of the texture's levels from the given one down, i.e. the texture at 1/2^firstLevel of its resolution
+    */
+   static std::unique_ptr<TextureMap> MakeFromLevels (TextureMap const& texture, uint const firstLevel);
+
+   /**
+    * Index of texel (x, y), from the top-left corner, in a tiled level of the given width
+    */
+   static size_t TexelIndex (uint const x, uint const y, uint const width)
+   {
+      size_t const tilesPerRow = (width + TILE_SIZE - 1) / TILE_SIZE;
+      size_t const tile = (y / TILE_SIZE) * tilesPerRow + x / TILE_SIZE;
+      return tile * TILE_SIZE * TILE_SIZE + (y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE;
+   }
+
+   /**
+    * Texels in a tiled level of the given size, padding included
+    */
+   static size_t TiledSize (uint const width, uint const height)
+   {
+      return size_t((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE) * TILE_SIZE * TILE_SIZE;
+   }
+
+   /**
+    * Texel coordinate i wrapped into [0, size), as the addressing mode says. Power-of-2 sizes only need a mask.
+    */
+   static uint Address (int const i, uint const size, TextureAddress const address)
+   {
+      int const n = int(size);
+      if (address == TextureAddress::CLAMP)
+         return uint(i < 0 ? 0 : (i < n ? i : n - 1));
+
+      // The texture repeats every size texels, or every 2 * size when mirrored
+      int const period = address == TextureAddress::MIRROR ? 2 * n : n;
+      int const m = (size & (size - 1)) == 0 ? i & (period - 1) : ((i % period) + period) % period;
+      return uint(address == TextureAddress::MIRROR && m >= n ? period - 1 - m : m);
+   }
+
+   /**
+    * Copies row-major pixels into TiledSize(width, height) tiled ones. Padding repeats the last row and column.
+    */
+   static void Tile (ColorRGB const* pixels, uint const width, uint const height, ColorRGB* tiled)
+   {
+      uint const paddedWidth = (width + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+      uint const paddedHeight = (height + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+      for (uint y = 0; y < paddedHeight; ++y)
+      {
+         ColorRGB const* row = pixels + size_t(y < height ? y : height - 1) * width;
+         for (uint x = 0; x < paddedWidth; ++x)
+            tiled[TexelIndex(x, y, width)] = row[x < width ? x : width - 1];
+      }
+   }
+
+   uint MipCount () const { return uint(m_mips.size()); }
+   MipLevel const& Mip (uint const level) const { return m_mips[level]; }
+
+   bool IsCompressed () const { return !m_blocks.empty(); }
+   size_t SizeInBytes () const { return m_pixels.size() * sizeof(ColorRGB) + m_blocks.size() * sizeof(TextureCompression::Block); }
+   ColorRGB const* MipPixels (uint const level) const { assert(!IsCompressed()); return m_pixels.data() + m_mips[level].offset; }
+   TextureCompression::Block const* MipBlocks (uint const level) const
+   {
+      assert(IsCompressed());
+      return m_blocks.data() + m_mips[level].offset / TextureCompression::TEXELS_PER_BLOCK;
+   }
+
+   /**
+    * Level of detail for the pixels of a 2x2 quad, from how far uv moves from one pixel of the quad to the next,
+    * along x and y. 0 means a texel per pixel; every unit above it halves the texels' resolution.
+    */
+   float Lod (float const dudx, float const dvdx, float const dudy, float const dvdy) const
+   {
+      // Texels covered by a step along either axis; the larger footprint decides, so that nothing aliases
+      float const x = (dudx * m_width) * (dudx * m_width) + (dvdx * m_height) * (dvdx * m_height);
+      float const y = (dudy * m_width) * (dudy * m_width) + (dvdy * m_height) * (dvdy * m_height);
+      float const rhoSquared = x > y ? x : y;
+      return rhoSquared > 0.f ? 0.5f * std::log2(rhoSquared) : 0.f;
+   }
+
+   /**
+    * Texel (x, y) of a level, from the top-left corner, decoded if need be
+    */
+   ColorRGB Texel (uint const level, uint const x, uint const y) const
+   {
+      size_t const index = m_mips[level].offset + TexelIndex(x, y, m_mips[level].width);
+      if (IsCompressed())
+         return TextureCompression::DecodeTexel(m_blocks[index / TextureCompression::TEXELS_PER_BLOCK], uint(index % TextureCompression::TEXELS_PER_BLOCK));
+      return m_pixels[index];
+   }
+
+   ColorRGB Map (Vector2 const& uv, TextureSampler const& sampler={}) const { return Map(uv.x, uv.y, sampler); }
+   ColorRGB Map (float const u, float const v, TextureSampler const& sampler={}) const
    {
       // u,v coordinates map 0,0 to the bottom-left and 1,1 to the top-right corners of the texture,
       // but pixels are stored such that 0,0 is the bottom-left and 1,1 is the *bottom*-right, i.e.
       // the vertical axis is flipped. We account for this by flipping hte `v` coordinate.
-      uint index = static_cast<uint>(u * m_width) + static_cast<uint>((1.f - v) * m_height) * m_height; 
+      // Coordinates are clamped first, to stay within an int; that far out, floats can't tell texels apart anyway.
+      float const limit = 8388608.f; // 2^23
+      float const x = std::floor(std::max(-limit, std::min(u * m_width, limit)));
+      float const y = std::floor(std::max(-limit, std::min((1.f - v) * m_height, limit)));
+      size_t const index = TexelIndex(Address(int(x), m_width, sampler.addressU), Address(int(y), m_height, sampler.addressV), m_width);
+      if (IsCompressed())
+         return TextureCompression::DecodeTexel(m_blocks[index / TextureCompression::TEXELS_PER_BLOCK], uint(index % TextureCompression::TEXELS_PER_BLOCK));
       return m_pixels[index];
    }
 };
@@ -0,0 +1,148 @@
+#include "TextureCompression.hpp"
+
+#include <cmath>
+
+namespace
+{
+   ColorRGB Expand (uint const rgb565)
+   {
+      // Replicating the top bits into the bottom ones maps 0 to 0 and the maximum to 255
+      uint const r = (rgb565 >> 11) & 0x1f, g = (rgb565 >> 5) & 0x3f, b = rgb565 & 0x1f;
+      return Color::Mix(uint8_t(r << 3 | r >> 2), uint8_t(g << 2 | g >> 4), uint8_t(b << 3 | b >> 2));
+   }
+
+   uint Quantize (float const r, float const g, float const b)
+   {
+      auto const channel = [] (float const c, float const max) {
+         float const q = std::floor(c / 255.f * max + 0.5f);
+         return uint(q < 0.f ? 0.f : (q > max ? max : q));
+      };
+      return channel(r, 31.f) << 11 | channel(g, 63.f) << 5 | channel(b, 31.f);
+   }
+
+   /**
+    * a + (b - a) * weight / 3, channel by channel, rounded to nearest
+    */
+   ColorRGB Third (ColorRGB const a, ColorRGB const b, uint const weight)
+   {
+      ColorRGB result = 0xff;
+      for (uint shift = 8; shift < 32; shift += 8)
+      {
+         uint const ca = (a >> shift) & 0xff, cb = (b >> shift) & 0xff;
+         result |= (((3 - weight) * ca + weight * cb + 1) / 3) << shift;
+      }
+      return result;
+   }
+
+   void Palette (TextureCompression::Block const block, ColorRGB* palette)
+   {
+      palette[0] = Expand(uint(block & 0xffff));
+      palette[1] = Expand(uint((block >> 16) & 0xffff));
+      palette[2] = Third(palette[0], palette[1], 1);
+      palette[3] = Third(palette[0], palette[1], 2);
+   }
+
+   float Channel (ColorRGB const color, uint const c)
+   {
+      return float((color >> (24 - 8 * c)) & 0xff);
+   }
+}
+
+TextureCompression::Block TextureCompression::Encode (ColorRGB const* texels)
+{
+   // Mean and covariance of the colours
+   float mean[3] = {};
+   for (uint i = 0; i < TEXELS_PER_BLOCK; ++i)
+   {
+      for (uint c = 0; c < 3; ++c)
+         mean[c] += Channel(texels[i], c) / TEXELS_PER_BLOCK;
+   }
+   float covariance[3][3] = {};
+   for (uint i = 0; i < TEXELS_PER_BLOCK; ++i)
+   {
+      float const d[3] = {Channel(texels[i], 0) - mean[0], Channel(texels[i], 1) - mean[1], Channel(texels[i], 2) - mean[2]};
+      for (uint r = 0; r < 3; ++r)
+      {
+         for (uint c = 0; c < 3; ++c)
+            covariance[r][c] += d[r] * d[c];
+      }
+   }
+
+   // Principal axis, by power iteration; a few steps are plenty to pick endpoints. It starts from the covariance row
+   // of the channel that varies most, rather than a fixed vector, which may be orthogonal to the variation, e.g. that
+   // of a red and green checker against (1, 1, 1), and would leave both endpoints at the mean.
+   uint widest = 0;
+   for (uint c = 1; c < 3; ++c)
+   {
+      if (covariance[c][c] > covariance[widest][widest]) widest = c;
+   }
+   float axis[3] = {1.f, 0.f, 0.f};
+   float const seedLength = std::sqrt(covariance[widest][0] * covariance[widest][0] + covariance[widest][1] * covariance[widest][1]
+      + covariance[widest][2] * covariance[widest][2]);
+   if (seedLength >= 1e-6f)
+   {
+      for (uint c = 0; c < 3; ++c)
+         axis[c] = covariance[widest][c] / seedLength;
+   }
+   for (uint step = 0; step < 8; ++step)
+   {
+      float next[3];
+      for (uint r = 0; r < 3; ++r)
+         next[r] = covariance[r][0] * axis[0] + covariance[r][1] * axis[1] + covariance[r][2] * axis[2];
+      float const length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+      if (length < 1e-6f) break; // a flat tile: any axis will do
+      for (uint c = 0; c < 3; ++c)
+         axis[c] = next[c] / length;
+   }
+
+   // The extremes of the colours along it become the endpoints
+   float low = 0.f, high = 0.f;
+   for (uint i = 0; i < TEXELS_PER_BLOCK; ++i)
+   {
+      float const t = (Channel(texels[i], 0) - mean[0]) * axis[0] + (Channel(texels[i], 1) - mean[1]) * axis[1] + (Channel(texels[i], 2) - mean[2]) * axis[2];
+      low = t < low ? t : low;
+      high = t > high ? t : high;
+   }
+   Block block = Quantize(mean[0] + low * axis[0], mean[1] + low * axis[1], mean[2] + low * axis[2]);
+   block |= Block(Quantize(mean[0] + high * axis[0], mean[1] + high * axis[1], mean[2] + high * axis[2])) << 16;
+
+   // Each texel takes the nearest colour of the palette, as it will be decoded
+   ColorRGB palette[4];
+   Palette(block, palette);
+   for (uint i = 0; i < TEXELS_PER_BLOCK; ++i)
+   {
+      uint nearest = 0;
+      float nearestDistance = INFINITY;
+      for (uint p = 0; p < 4; ++p)
+      {
+         float distance = 0.f;
+         for (uint c = 0; c < 3; ++c)
+         {
+            float const d = Channel(texels[i], c) - Channel(palette[p], c);
+            distance += d * d;
+         }
+         if (distance < nearestDistance)
+         {
+            nearest = p;
+            nearestDistance = distance;
+         }
+      }
+      block |= Block(nearest) << (32 + 2 * i);
+   }
+   return block;
+}
+
+void TextureCompression::Decode (Block const block, ColorRGB* texels)
+{
+   ColorRGB palette[4];
+   Palette(block, palette);
+   for (uint i = 0; i < TEXELS_PER_BLOCK; ++i)
+      texels[i] = palette[(block >> (32 + 2 * i)) & 3];
+}
+
+ColorRGB TextureCompression::DecodeTexel (Block const block, uint const i)
+{
+   uint const index = uint(block >> (32 + 2 * i)) & 3;
+   ColorRGB const a = Expand(uint(block & 0xffff)), b = Expand(uint((block >> 16) & 0xffff));
+   return index < 2 ? (index == 0 ? a : b) : Third(a, b, index - 1);
+}
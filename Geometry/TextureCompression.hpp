@@ -0,0 +1,42 @@
+#ifndef TextureCompression_hpp
+#define TextureCompression_hpp
+
+#include "global.hpp"
+
+#include "Color.hpp"
+
+/**
+ * Lossy compression of 4x4 tiles of texels into 8 bytes each, i.e. 1/8 of their size, after BC1 (a.k.a. DXT1) without
+ * its transparent mode. A block holds two colours as RGB565, and a 2-bit index per texel into a palette of those two
+ * and the two colours a third and two thirds of the way between them:
+ *
+ *   bits  0-15: first colour
+ *   bits 16-31: second colour
+ *   bits 32-63: index of texel i, in its tile's row-major order, at bits 32 + 2i
+ *
+ * Alpha is always opaque.
+ */
+namespace TextureCompression
+{
+   typedef uint64_t Block;
+
+   static constexpr uint TEXELS_PER_BLOCK = 16;
+
+   /**
+    * Block closest to the 16 texels of a tile, in row-major order. Picks the palette along the axis the colours vary
+    * the most along, i.e. their principal component.
+    */
+   Block Encode (ColorRGB const* texels);
+
+   /**
+    * The 16 texels of a block, in row-major order
+    */
+   void Decode (Block const block, ColorRGB* texels);
+
+   /**
+    * Texel i of a block, in row-major order
+    */
+   ColorRGB DecodeTexel (Block const block, uint const i);
+}
+
+#endif
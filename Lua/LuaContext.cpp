@@ -2,13 +2,18 @@
 
 #include <iostream>
 
+#include "MemoryTracker.hpp"
+
 LuaContext::LuaContext ()
+   : lua(sol::default_at_panic, &MemoryTracker::LuaAllocate)
 {
+   MEMORY_SCOPE(LUA);
    lua.open_libraries(sol::lib::base, sol::lib::package);
 }
 
 bool LuaContext::LoadFromFile (std::string filename)
 {
+   MEMORY_SCOPE(LUA);
    auto result = lua.script_file(filename, &sol::script_default_on_error);
 
    bool rc = result.valid();
@@ -21,4 +26,19 @@ bool LuaContext::LoadFromFile (std::string filename)
    #endif
    }
    return rc;
+}
+
+bool LuaContext::TryLoadFromFile (std::string const& filename)
+{
+   MEMORY_SCOPE(LUA);
+   auto result = lua.safe_script_file(filename, &sol::script_pass_on_error);
+   if (!result.valid())
+   {
+      sol::error error = result;
+      std::cerr << "Failed load lua script " << filename << ": " << error.what() << std::endl;
+      return false;
+   }
+
+   m_loaded = true;
+   return true;
 }
\ No newline at end of file
@@ -20,6 +20,11 @@ struct LuaContext
    LuaContext ();
    bool LoadFromFile (std::string filename);
 
+   /**
+    * Like LoadFromFile, but a script that fails, e.g. one saved halfway through an edit, is only reported
+    */
+   bool TryLoadFromFile (std::string const& filename);
+
    bool Ready () const { return m_loaded; }
 
 private:
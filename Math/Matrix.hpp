@@ -5,6 +5,8 @@
 #include <iostream>
 #include <type_traits>
 #include <array>
+#include <algorithm>
+#include <cmath>
 
 #include "Vector.hpp"
 
@@ -339,15 +341,18 @@ Matrix<Numeric, M, P> operator* (Matrix<Numeric, M, N> const& A, Matrix<Numeric,
 template <typename Numeric, uint N>
 Matrix<Numeric, N, N> & operator*= (Matrix<Numeric, N, N> & A, Matrix<Numeric, N, N> const& B)
 {
+   // Every element of a row depends on the whole row of A, so the row can't be overwritten while it is being computed
    for (int r = 0; r < N; ++r)
    {
+      typename Matrix<Numeric, N, N>::row_type row;
       for (int c = 0; c < N; ++c)
       {
-         float result = 0;
+         Numeric result = 0;
          for (int i = 0; i < N; ++i)
             result += A(r,i) * B(i,c);
-         A(r,c) = result;
+         row[c] = result;
       }
+      A(r) = row;
    }
    return A;
 }
@@ -442,35 +447,115 @@ Matrix<Numeric, N, N> Inverse_Orthogonal (Matrix<Numeric, N, N> const& A)
 }
 
 /**
- * Calculate inverse of 4x4 homogenous transformation assuming it contains just a rotation and a translation.
- * 
- * We use the same trick as with change-of-basis matrix calculations, namely M^-1 = (T * R)^-1 = R^-1 * T^-1
- * \see Camera::LookAt
+ * Calculate inverse of any invertible 4x4 matrix, via the 2x2 sub-determinants of its top and bottom halves
+ * (Laplace expansion). Prefer the specialized inverses below whenever the structure of the matrix is known.
  */
 template <typename Numeric>
-Matrix<Numeric, 4, 4> Inverse_RotationTranslation (Matrix<Numeric, 4, 4> const& A)
-{	
-   typedef Matrix<Numeric, 4 , 4> matrix_type;
-
-   matrix_type rotation(typename matrix_type::elements_array_type({
-      A(0,0), A(0,1), A(0,2), 0,
-      A(1,0), A(1,1), A(1,2), 0,
-      A(2,0), A(2,1), A(2,2), 0,
-           0,		 0, 		0, 1
-   }));	
-
-   matrix_type inverseOfTranslation(typename matrix_type::elements_array_type({
-      1, 0, 0, -A(0,3),
-      0, 1, 0, -A(1,3),
-      0, 0, 1, -A(2,3),
-      0, 0, 0,      1
-   }));
-
-   return Inverse_Orthogonal(rotation) * inverseOfTranslation;
+Matrix<Numeric, 4, 4> Inverse (Matrix<Numeric, 4, 4> const& A)
+{
+   Numeric const s0 = A(0,0) * A(1,1) - A(1,0) * A(0,1);
+   Numeric const s1 = A(0,0) * A(1,2) - A(1,0) * A(0,2);
+   Numeric const s2 = A(0,0) * A(1,3) - A(1,0) * A(0,3);
+   Numeric const s3 = A(0,1) * A(1,2) - A(1,1) * A(0,2);
+   Numeric const s4 = A(0,1) * A(1,3) - A(1,1) * A(0,3);
+   Numeric const s5 = A(0,2) * A(1,3) - A(1,2) * A(0,3);
+
+   Numeric const c5 = A(2,2) * A(3,3) - A(3,2) * A(2,3);
+   Numeric const c4 = A(2,1) * A(3,3) - A(3,1) * A(2,3);
+   Numeric const c3 = A(2,1) * A(3,2) - A(3,1) * A(2,2);
+   Numeric const c2 = A(2,0) * A(3,3) - A(3,0) * A(2,3);
+   Numeric const c1 = A(2,0) * A(3,2) - A(3,0) * A(2,2);
+   Numeric const c0 = A(2,0) * A(3,1) - A(3,0) * A(2,1);
+
+   Numeric const inverseDeterminant = static_cast<Numeric>(1) / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+   return Matrix<Numeric, 4, 4>(typename Matrix<Numeric, 4, 4>::elements_array_type{
+      ( A(1,1) * c5 - A(1,2) * c4 + A(1,3) * c3) * inverseDeterminant,
+      (-A(0,1) * c5 + A(0,2) * c4 - A(0,3) * c3) * inverseDeterminant,
+      ( A(3,1) * s5 - A(3,2) * s4 + A(3,3) * s3) * inverseDeterminant,
+      (-A(2,1) * s5 + A(2,2) * s4 - A(2,3) * s3) * inverseDeterminant,
+
+      (-A(1,0) * c5 + A(1,2) * c2 - A(1,3) * c1) * inverseDeterminant,
+      ( A(0,0) * c5 - A(0,2) * c2 + A(0,3) * c1) * inverseDeterminant,
+      (-A(3,0) * s5 + A(3,2) * s2 - A(3,3) * s1) * inverseDeterminant,
+      ( A(2,0) * s5 - A(2,2) * s2 + A(2,3) * s1) * inverseDeterminant,
+
+      ( A(1,0) * c4 - A(1,1) * c2 + A(1,3) * c0) * inverseDeterminant,
+      (-A(0,0) * c4 + A(0,1) * c2 - A(0,3) * c0) * inverseDeterminant,
+      ( A(3,0) * s4 - A(3,1) * s2 + A(3,3) * s0) * inverseDeterminant,
+      (-A(2,0) * s4 + A(2,1) * s2 - A(2,3) * s0) * inverseDeterminant,
+
+      (-A(1,0) * c3 + A(1,1) * c1 - A(1,2) * c0) * inverseDeterminant,
+      ( A(0,0) * c3 - A(0,1) * c1 + A(0,2) * c0) * inverseDeterminant,
+      (-A(3,0) * s3 + A(3,1) * s1 - A(3,2) * s0) * inverseDeterminant,
+      ( A(2,0) * s3 - A(2,1) * s1 + A(2,2) * s0) * inverseDeterminant
+   });
+}
+
+/**
+ * Calculate inverse of a 4x4 homogeneous transformation composed as T * R * S, i.e. a scale, then a rotation,
+ * then a translation, directly from those components. Only the upper-left 3x3 of `rotation` is used.
+ *
+ * M^-1 = S^-1 * R^-1 * T^-1 = S^-1 * R^T * T^-1, so the upper-left 3x3 of the inverse is R^T with its rows divided
+ * by the scale factors, and its translation is that 3x3 applied to the negated translation. No products of full
+ * matrices are involved. Scale factors must be non-zero.
+ */
+template <typename Numeric>
+Matrix<Numeric, 4, 4> Inverse_TRS (Vector<Numeric, 3> const& translation, Matrix<Numeric, 4, 4> const& rotation, Vector<Numeric, 3> const& scale)
+{
+   Matrix<Numeric, 4, 4> result;
+   for (uint r = 0; r < 3; ++r)
+   {
+      Numeric const inverseScale = static_cast<Numeric>(1) / scale[r];
+      for (uint c = 0; c < 3; ++c)
+         result(r, c) = rotation(c, r) * inverseScale;
+      result(r, 3) = -(result(r, 0) * translation[0] + result(r, 1) * translation[1] + result(r, 2) * translation[2]);
+   }
+   result(3, 3) = static_cast<Numeric>(1);
+   return result;
+}
+
+/**
+ * Matrix that transforms surface normals along with an affine transformation M: the inverse-transpose of
+ * the upper-left 3x3 of M, computed from the already known inverse of M. The translation is dropped, so the
+ * result can be used with TransformDirection. Normals need renormalizing afterwards unless M is rigid.
+ */
+template <typename Numeric>
+Matrix<Numeric, 4, 4> NormalMatrix (Matrix<Numeric, 4, 4> const& inverse)
+{
+   Matrix<Numeric, 4, 4> result;
+   for (uint r = 0; r < 3; ++r)
+      for (uint c = 0; c < 3; ++c)
+         result(r, c) = inverse(c, r);
+   result(3, 3) = static_cast<Numeric>(1);
+   return result;
+}
+
+/**
+ * Upper bound on the factor by which an affine transformation stretches any length, e.g. to scale bounding
+ * sphere radii. Exact for T * R * S transformations, whose basis vectors (columns) are orthogonal: it is then
+ * the longest column. Sheared transformations (non-uniformly scaled parents of rotated children) fall back to
+ * the Frobenius norm, which is never smaller.
+ */
+template <typename Numeric>
+Numeric MaxScale (Matrix<Numeric, 4, 4> const& A)
+{
+   Vector<Numeric, 3> const a(A(0,0), A(1,0), A(2,0));
+   Vector<Numeric, 3> const b(A(0,1), A(1,1), A(2,1));
+   Vector<Numeric, 3> const c(A(0,2), A(1,2), A(2,2));
+   Numeric const aa = Dot(a, a), bb = Dot(b, b), cc = Dot(c, c);
+
+   Numeric const tolerance = static_cast<Numeric>(1e-4) * (aa + bb + cc);
+   bool const orthogonal = std::abs(Dot(a, b)) <= tolerance && std::abs(Dot(b, c)) <= tolerance && std::abs(Dot(c, a)) <= tolerance;
+   return std::sqrt(orthogonal ? std::max(aa, std::max(bb, cc)) : aa + bb + cc);
 }
 
 //// Super specialized operations ////
 
 Vector3 TransformDirection (Matrix4 const& A, Vector3 const& u);
 
+//// Hand-vectorized overloads of the above, where supported ////
+
+#include "MatrixSSE.hpp"
+
 #endif
\ No newline at end of file
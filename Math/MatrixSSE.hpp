@@ -0,0 +1,204 @@
+#ifndef MatrixSSE_hpp
+#define MatrixSSE_hpp
+
+/**
+ * SSE implementations of the hottest Matrix4 and Vector4 operations. These are plain (non-template) overloads,
+ * which overload resolution always prefers over the generic templates in Matrix.hpp, so every existing call site
+ * picks them up unchanged. Only included by Matrix.hpp, after the generic versions.
+ *
+ * Vector4 is 16-byte aligned, and thus so is every row of a Matrix4, which allows aligned loads and stores.
+ */
+
+#include "SIMD.hpp"
+
+#ifdef SIMD_SSE2
+
+static_assert(alignof(Vector4) == 16 && sizeof(Vector4) == 16, "Vector4 must map exactly onto an SSE register");
+static_assert(alignof(Matrix4) == 16 && sizeof(Matrix4) == 64, "Matrix4 rows must map exactly onto SSE registers");
+
+namespace SSE
+{
+   inline __m128 Load (Vector4 const& v) { return _mm_load_ps(&v.x); }
+   inline void Store (Vector4 & v, __m128 const r) { _mm_store_ps(&v.x, r); }
+
+   template <int x, int y, int z, int w>
+   inline __m128 Swizzle (__m128 const v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(w, z, y, x)); }
+
+   /**
+    * (a.x, a.y, b.z, b.w) style shuffles: lanes 0-1 come from a, lanes 2-3 from b
+    */
+   template <int x, int y, int z, int w>
+   inline __m128 Shuffle (__m128 const a, __m128 const b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x)); }
+
+   /**
+    * Every lane holds the sum of all 4 lanes
+    */
+   inline __m128 HorizontalSum (__m128 v)
+   {
+      v = _mm_add_ps(v, Swizzle<1, 0, 3, 2>(v));
+      return _mm_add_ps(v, Swizzle<2, 3, 0, 1>(v));
+   }
+
+   /// 2x2 matrices packed in a register as (m00, m01, m10, m11)
+
+   // A * B
+   inline __m128 Mat2Mul (__m128 const a, __m128 const b)
+   {
+      return _mm_add_ps(_mm_mul_ps(a, Swizzle<0, 3, 0, 3>(b)), _mm_mul_ps(Swizzle<1, 0, 3, 2>(a), Swizzle<2, 1, 2, 1>(b)));
+   }
+
+   // adj(A) * B
+   inline __m128 Mat2AdjMul (__m128 const a, __m128 const b)
+   {
+      return _mm_sub_ps(_mm_mul_ps(Swizzle<3, 3, 0, 0>(a), b), _mm_mul_ps(Swizzle<1, 1, 2, 2>(a), Swizzle<2, 3, 0, 1>(b)));
+   }
+
+   // A * adj(B)
+   inline __m128 Mat2MulAdj (__m128 const a, __m128 const b)
+   {
+      return _mm_sub_ps(_mm_mul_ps(a, Swizzle<3, 0, 3, 0>(b)), _mm_mul_ps(Swizzle<1, 0, 3, 2>(a), Swizzle<2, 1, 2, 1>(b)));
+   }
+
+   /**
+    * The pieces shared by Determinant and Inverse. The matrix is split into 2x2 blocks [A B; C D], and its
+    * determinant is |A||D| + |B||C| - tr(adj(A) * B * adj(D) * C).
+    */
+   struct BlockDecomposition
+   {
+      __m128 A, B, C, D;
+      __m128 detA, detB, detC, detD; // broadcast to every lane
+      __m128 A_B, D_C; // adj(A) * B and adj(D) * C
+      __m128 det; // broadcast to every lane
+
+      explicit BlockDecomposition (Matrix4 const& m)
+      {
+         __m128 const r0 = Load(m.Row(0)), r1 = Load(m.Row(1)), r2 = Load(m.Row(2)), r3 = Load(m.Row(3));
+
+         A = _mm_movelh_ps(r0, r1);
+         B = _mm_movehl_ps(r1, r0);
+         C = _mm_movelh_ps(r2, r3);
+         D = _mm_movehl_ps(r3, r2);
+
+         // Determinants of all four blocks at once: (|A|, |B|, |C|, |D|)
+         __m128 const dets = _mm_sub_ps(
+            _mm_mul_ps(Shuffle<0, 2, 0, 2>(r0, r2), Shuffle<1, 3, 1, 3>(r1, r3)),
+            _mm_mul_ps(Shuffle<1, 3, 1, 3>(r0, r2), Shuffle<0, 2, 0, 2>(r1, r3))
+         );
+         detA = Swizzle<0, 0, 0, 0>(dets);
+         detB = Swizzle<1, 1, 1, 1>(dets);
+         detC = Swizzle<2, 2, 2, 2>(dets);
+         detD = Swizzle<3, 3, 3, 3>(dets);
+
+         A_B = Mat2AdjMul(A, B);
+         D_C = Mat2AdjMul(D, C);
+
+         __m128 const trace = HorizontalSum(_mm_mul_ps(A_B, Swizzle<0, 2, 1, 3>(D_C)));
+         det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), trace);
+      }
+   };
+}
+
+/**
+ * Each row of the result is a linear combination of the rows of B, weighted by the corresponding row of A
+ */
+inline Matrix4 operator* (Matrix4 const& A, Matrix4 const& B)
+{
+   __m128 const b0 = SSE::Load(B.Row(0)), b1 = SSE::Load(B.Row(1)), b2 = SSE::Load(B.Row(2)), b3 = SSE::Load(B.Row(3));
+
+   Matrix4 result;
+   for (uint r = 0; r < 4; ++r)
+   {
+      __m128 const a = SSE::Load(A.Row(r));
+      __m128 row = _mm_mul_ps(SSE::Swizzle<0, 0, 0, 0>(a), b0);
+      row = _mm_add_ps(row, _mm_mul_ps(SSE::Swizzle<1, 1, 1, 1>(a), b1));
+      row = _mm_add_ps(row, _mm_mul_ps(SSE::Swizzle<2, 2, 2, 2>(a), b2));
+      row = _mm_add_ps(row, _mm_mul_ps(SSE::Swizzle<3, 3, 3, 3>(a), b3));
+      SSE::Store(result.Row(r), row);
+   }
+   return result;
+}
+
+inline Matrix4 & operator*= (Matrix4 & A, Matrix4 const& B)
+{
+   A = A * B;
+   return A;
+}
+
+/**
+ * The four row-vector products are computed side by side, then transposed so that they can be summed vertically
+ */
+inline Vector4 operator* (Matrix4 const& A, Vector4 const& v)
+{
+   __m128 const x = SSE::Load(v);
+   __m128 p0 = _mm_mul_ps(SSE::Load(A.Row(0)), x);
+   __m128 p1 = _mm_mul_ps(SSE::Load(A.Row(1)), x);
+   __m128 p2 = _mm_mul_ps(SSE::Load(A.Row(2)), x);
+   __m128 p3 = _mm_mul_ps(SSE::Load(A.Row(3)), x);
+   _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+   Vector4 result;
+   SSE::Store(result, _mm_add_ps(_mm_add_ps(p0, p1), _mm_add_ps(p2, p3)));
+   return result;
+}
+
+/**
+ * Homogeneous transformation of a point, as in the generic version
+ */
+inline Vector3 operator* (Matrix4 const& A, Vector3 const& v)
+{
+   return ProjectToHyperspace(A * HomoVector(v));
+}
+
+/**
+ * Transpose
+ */
+inline Matrix4 operator~ (Matrix4 const& A)
+{
+   __m128 r0 = SSE::Load(A.Row(0)), r1 = SSE::Load(A.Row(1)), r2 = SSE::Load(A.Row(2)), r3 = SSE::Load(A.Row(3));
+   _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+   Matrix4 result;
+   SSE::Store(result.Row(0), r0);
+   SSE::Store(result.Row(1), r1);
+   SSE::Store(result.Row(2), r2);
+   SSE::Store(result.Row(3), r3);
+   return result;
+}
+
+inline float Determinant (Matrix4 const& A)
+{
+   return _mm_cvtss_f32(SSE::BlockDecomposition(A).det);
+}
+
+/**
+ * General inverse by blockwise inversion (cf. Eric Zhang, "Fast 4x4 Matrix Inverse with SSE SIMD, Explained"):
+ * every 2x2 block of the inverse is a combination of 2x2 products and adjugates of the blocks of A.
+ */
+inline Matrix4 Inverse (Matrix4 const& A)
+{
+   SSE::BlockDecomposition const m(A);
+
+   // Blocks of the inverse, up to the 1/det factor and the adjugate's signs
+   __m128 X = _mm_sub_ps(_mm_mul_ps(m.detD, m.A), SSE::Mat2Mul(m.B, m.D_C));
+   __m128 W = _mm_sub_ps(_mm_mul_ps(m.detA, m.D), SSE::Mat2Mul(m.C, m.A_B));
+   __m128 Y = _mm_sub_ps(_mm_mul_ps(m.detB, m.C), SSE::Mat2MulAdj(m.D, m.A_B));
+   __m128 Z = _mm_sub_ps(_mm_mul_ps(m.detC, m.B), SSE::Mat2MulAdj(m.A, m.D_C));
+
+   __m128 const inverseDeterminant = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), m.det);
+   X = _mm_mul_ps(X, inverseDeterminant);
+   Y = _mm_mul_ps(Y, inverseDeterminant);
+   Z = _mm_mul_ps(Z, inverseDeterminant);
+   W = _mm_mul_ps(W, inverseDeterminant);
+
+   // Reassemble, applying the adjugate's transposition of each block
+   Matrix4 result;
+   SSE::Store(result.Row(0), SSE::Shuffle<3, 1, 3, 1>(X, Y));
+   SSE::Store(result.Row(1), SSE::Shuffle<2, 0, 2, 0>(X, Y));
+   SSE::Store(result.Row(2), SSE::Shuffle<3, 1, 3, 1>(Z, W));
+   SSE::Store(result.Row(3), SSE::Shuffle<2, 0, 2, 0>(Z, W));
+   return result;
+}
+
+#endif // SIMD_SSE2
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef Quaternion_hpp
+#define Quaternion_hpp
+
+#include "global.hpp"
+
+#include <cmath>
+
+#include "Vector.hpp"
+#include "Matrix.hpp"
+
+/**
+ * Unit quaternion w + xi + yj + zk, representing a rotation. Unlike a rotation matrix, it takes 4 floats,
+ * composes in 16 multiplications and is trivially renormalized, so accumulated rotations don't drift into shears.
+ */
+struct Quaternion
+{
+   float w = 1.f;
+   float x = 0.f, y = 0.f, z = 0.f;
+
+   Quaternion () {}
+   Quaternion (float const _w, float const _x, float const _y, float const _z) : w(_w), x(_x), y(_y), z(_z) {}
+
+   static Quaternion Identity () { return Quaternion(); }
+
+   /**
+    * Rotation by the given angle, in radians, about the given unit axis
+    */
+   static Quaternion FromAxisAngle (Vector3 const& axis, float const angle)
+   {
+      float const s = sinf(angle * 0.5f);
+      return Quaternion(cosf(angle * 0.5f), axis.x * s, axis.y * s, axis.z * s);
+   }
+
+   /**
+    * Euler angles, in radians, with the same meaning as the rotation matrix Rx * Ry * Rz
+    */
+   static Quaternion FromEuler (float const x, float const y, float const z);
+};
+
+/**
+ * Composition: the rotation a * b applies b first, then a, just like the product of rotation matrices
+ */
+inline Quaternion operator* (Quaternion const& a, Quaternion const& b)
+{
+   return Quaternion(
+      a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+      a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+      a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+      a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w
+   );
+}
+
+inline Quaternion & operator*= (Quaternion & a, Quaternion const& b)
+{
+   a = a * b;
+   return a;
+}
+
+/**
+ * Inverse rotation, for unit quaternions
+ */
+inline Quaternion Conjugate (Quaternion const& q)
+{
+   return Quaternion(q.w, -q.x, -q.y, -q.z);
+}
+
+inline Quaternion Normalized (Quaternion const& q)
+{
+   float const length = sqrtf(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+   return Quaternion(q.w / length, q.x / length, q.y / length, q.z / length);
+}
+
+inline Quaternion Quaternion::FromEuler (float const x, float const y, float const z)
+{
+   return FromAxisAngle(Vector3(1, 0, 0), x) * FromAxisAngle(Vector3(0, 1, 0), y) * FromAxisAngle(Vector3(0, 0, 1), z);
+}
+
+/**
+ * Rotates v by q, i.e. q * v * q^-1, expanded so as to avoid two full quaternion products
+ */
+inline Vector3 Rotate (Quaternion const& q, Vector3 const& v)
+{
+   Vector3 const u(q.x, q.y, q.z);
+   Vector3 const t = Cross(u, v) * 2.f;
+   return v + t * q.w + Cross(u, t);
+}
+
+/**
+ * The 3x3 rotation matrix of q, in the upper-left corner of an otherwise identity matrix
+ */
+inline Matrix4 RotationMatrix (Quaternion const& q)
+{
+   float const xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+   float const xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+   float const wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+   return Matrix4(Matrix4::elements_array_type{
+      1 - 2 * (yy + zz),     2 * (xy - wz),     2 * (xz + wy), 0,
+          2 * (xy + wz), 1 - 2 * (xx + zz),     2 * (yz - wx), 0,
+          2 * (xz - wy),     2 * (yz + wx), 1 - 2 * (xx + yy), 0,
+                      0,                 0,                 0, 1
+   });
+}
+
+#endif
@@ -158,10 +158,11 @@ template<typename Numeric>
 Vector<Numeric, 2> Vector<Numeric, 2>::Right = Vector<Numeric, 2>(static_cast<Numeric>(-1),  0);
 
 /**
- * 4D Vectors -- for when you need to think outside the box
+ * 4D Vectors -- for when you need to think outside the box.
+ * Float vectors are aligned so as to be loaded straight into SIMD registers.
  */
 template <typename Numeric>
-class Vector<Numeric, 4>
+class alignas(std::is_same<Numeric, float>::value ? 16 : alignof(Numeric)) Vector<Numeric, 4>
 {
    static_assert(std::is_arithmetic<Numeric>::value, "Vectors can only contain numeric/arithmetic types, i.e. integers and floating-point numbers");
 
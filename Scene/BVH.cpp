@@ -0,0 +1,355 @@
+#include "BVH.hpp"
+
+#include <algorithm>
+
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+BVH::~BVH ()
+{
+   Clear();
+}
+
+void BVH::Clear ()
+{
+   if (m_pObjects)
+   {
+      for (auto & object : *m_pObjects)
+         object.SetTransformListener(nullptr);
+   }
+   m_pObjects = nullptr;
+
+   m_nodes.clear();
+   m_objectIndices.clear();
+   m_objectBounds.clear();
+   m_leafOfObject.clear();
+   m_dirtyObjects.clear();
+   m_objectIsDirty.clear();
+}
+
+void BVH::Build (std::vector<Object3D> & objects)
+{
+   PROFILE_SCOPE("BVH build");
+
+   Clear();
+   m_pObjects = &objects;
+
+   uint const n = objects.size();
+   m_objectBounds.resize(n);
+   m_leafOfObject.assign(n, 0);
+   m_objectIsDirty.assign(n, false);
+   std::vector<Vector3> centroids(n);
+   for (uint i = 0; i < n; ++i)
+   {
+      objects[i].SetTransformListener(this, i);
+
+      // Objects without a mesh have empty bounds and can never be found, so leave them out entirely
+      m_objectBounds[i] = objects[i].WorldBounds();
+      if (m_objectBounds[i].Empty()) continue;
+
+      centroids[i] = m_objectBounds[i].Center();
+      m_objectIndices.push_back(i);
+   }
+   if (m_objectIndices.empty()) return;
+
+   m_nodes.reserve(2 * m_objectIndices.size());
+   m_nodes.push_back(Node());
+   m_nodes[0].parent = NO_PARENT;
+   m_nodes[0].first = 0;
+   m_nodes[0].count = m_objectIndices.size();
+   BuildNode(0, 0, centroids);
+}
+
+void BVH::BuildNode (uint const nodeIndex, uint const depth, std::vector<Vector3> const& centroids)
+{
+   // Careful: m_nodes grows during recursion, so never hold on to a reference across BuildNode calls
+   uint const first = m_nodes[nodeIndex].first;
+   uint const count = m_nodes[nodeIndex].count;
+   auto const begin = m_objectIndices.begin() + first;
+   auto const end = begin + count;
+
+   AABB bounds, centroidBounds;
+   for (auto it = begin; it != end; ++it)
+   {
+      bounds.Extend(m_objectBounds[*it]);
+      centroidBounds.Extend(centroids[*it]);
+   }
+   m_nodes[nodeIndex].bounds = bounds;
+
+   auto makeLeaf = [&]() {
+      m_nodes[nodeIndex].leaf = true;
+      for (auto it = begin; it != end; ++it)
+         m_leafOfObject[*it] = nodeIndex;
+   };
+
+   if (count <= 1 || depth >= MAX_DEPTH)
+   {
+      makeLeaf();
+      return;
+   }
+
+   // Binned SAH: bucket the centroids along each axis and evaluate the split planes between buckets. The
+   // cost of a split is the traversal cost (relative to that of testing one object) plus the expected
+   // number of objects tested, i.e. each side's count weighted by the chance of a ray hitting that side.
+   float const parentArea = std::max(bounds.SurfaceArea(), std::numeric_limits<float>::min());
+   float const traversalCost = 1.f;
+   float bestCost = std::numeric_limits<float>::max();
+   int bestAxis = -1;
+   uint bestSplit = 0;
+
+   struct Bin
+   {
+      AABB bounds;
+      uint count = 0;
+   };
+
+   for (int axis = 0; axis < 3; ++axis)
+   {
+      float const lower = centroidBounds.min[axis];
+      float const extent = centroidBounds.max[axis] - lower;
+      if (extent <= 0) continue;
+
+      Bin bins[SAH_BINS];
+      float const scale = SAH_BINS / extent;
+      for (auto it = begin; it != end; ++it)
+      {
+         uint b = std::min(SAH_BINS - 1, static_cast<uint>((centroids[*it][axis] - lower) * scale));
+         bins[b].bounds.Extend(m_objectBounds[*it]);
+         ++bins[b].count;
+      }
+
+      // Sweep from the right to get the cost of every right side, then from the left
+      float rightCosts[SAH_BINS];
+      AABB rightBounds;
+      uint rightCount = 0;
+      for (uint b = SAH_BINS - 1; b > 0; --b)
+      {
+         rightBounds.Extend(bins[b].bounds);
+         rightCount += bins[b].count;
+         rightCosts[b] = rightCount * rightBounds.SurfaceArea();
+      }
+
+      AABB leftBounds;
+      uint leftCount = 0;
+      for (uint b = 0; b < SAH_BINS - 1; ++b)
+      {
+         leftBounds.Extend(bins[b].bounds);
+         leftCount += bins[b].count;
+         if (leftCount == 0 || leftCount == count) continue;
+
+         float const cost = traversalCost + (leftCount * leftBounds.SurfaceArea() + rightCosts[b + 1]) / parentArea;
+         if (cost < bestCost)
+         {
+            bestCost = cost;
+            bestAxis = axis;
+            bestSplit = b + 1;
+         }
+      }
+   }
+
+   auto mid = begin;
+   if (bestAxis >= 0)
+   {
+      // Only split if it is actually expected to be cheaper than testing every object in a leaf
+      if (bestCost >= float(count) && count <= MAX_LEAF_SIZE)
+      {
+         makeLeaf();
+         return;
+      }
+
+      float const lower = centroidBounds.min[bestAxis];
+      float const scale = SAH_BINS / (centroidBounds.max[bestAxis] - lower);
+      mid = std::partition(begin, end, [&](uint const object) {
+         return std::min(SAH_BINS - 1, static_cast<uint>((centroids[object][bestAxis] - lower) * scale)) < bestSplit;
+      });
+   }
+   else
+   {
+      // All centroids coincide, so no plane can separate them
+      if (count <= MAX_LEAF_SIZE)
+      {
+         makeLeaf();
+         return;
+      }
+      mid = begin + count / 2;
+   }
+
+   uint const left = m_nodes.size();
+   m_nodes.push_back(Node());
+   m_nodes.push_back(Node());
+
+   m_nodes[nodeIndex].leaf = false;
+   m_nodes[nodeIndex].left = left;
+
+   m_nodes[left].parent = nodeIndex;
+   m_nodes[left].first = first;
+   m_nodes[left].count = mid - begin;
+   m_nodes[left + 1].parent = nodeIndex;
+   m_nodes[left + 1].first = first + (mid - begin);
+   m_nodes[left + 1].count = end - mid;
+
+   BuildNode(left, depth + 1, centroids);
+   BuildNode(left + 1, depth + 1, centroids);
+}
+
+void BVH::OnTransformChanged (uint handle)
+{
+   if (handle < m_objectIsDirty.size() && !m_objectIsDirty[handle])
+   {
+      m_objectIsDirty[handle] = true;
+      m_dirtyObjects.push_back(handle);
+   }
+}
+
+void BVH::Refit ()
+{
+   if (m_dirtyObjects.empty()) return;
+
+   PROFILE_SCOPE("BVH refit");
+
+   // Transforming each object's bounds is independent of the others, so that's done in parallel first
+   JobSystem::Instance().ParallelFor(uint(m_dirtyObjects.size()), 64, [this] (uint const begin, uint const end) {
+      for (uint i = begin; i < end; ++i)
+      {
+         uint const object = m_dirtyObjects[i];
+
+         // Objects that were left out of the tree (no bounds at build time) cannot be refitted in
+         if (!m_objectBounds[object].Empty())
+            m_objectBounds[object] = (*m_pObjects)[object].WorldBounds();
+      }
+   });
+
+   // Objects share ancestors, so walking up the tree is left to this thread
+   for (uint object : m_dirtyObjects)
+   {
+      m_objectIsDirty[object] = false;
+      if (m_objectBounds[object].Empty())
+         continue;
+
+      // Recompute the leaf, then walk up until a node's bounds no longer change
+      uint nodeIndex = m_leafOfObject[object];
+      {
+         Node & leaf = m_nodes[nodeIndex];
+         leaf.bounds = AABB();
+         for (uint i = leaf.first; i < leaf.first + leaf.count; ++i)
+            leaf.bounds.Extend(m_objectBounds[m_objectIndices[i]]);
+      }
+      for (uint parent = m_nodes[nodeIndex].parent; parent != NO_PARENT; parent = m_nodes[parent].parent)
+      {
+         Node & node = m_nodes[parent];
+         AABB refitted = m_nodes[node.left].bounds;
+         refitted.Extend(m_nodes[node.left + 1].bounds);
+         if (refitted.min.x == node.bounds.min.x && refitted.min.y == node.bounds.min.y && refitted.min.z == node.bounds.min.z &&
+             refitted.max.x == node.bounds.max.x && refitted.max.y == node.bounds.max.y && refitted.max.z == node.bounds.max.z)
+            break;
+         node.bounds = refitted;
+      }
+   }
+
+   m_dirtyObjects.clear();
+}
+
+void BVH::AppendSubtree (Node const& node, std::vector<uint> & out) const
+{
+   out.insert(out.end(), m_objectIndices.begin() + node.first, m_objectIndices.begin() + node.first + node.count);
+}
+
+void BVH::QueryFrustum (Frustum const& frustum, std::vector<uint> & out) const
+{
+   if (m_nodes.empty()) return;
+
+   uint stack[STACK_SIZE];
+   uint top = 0;
+   stack[top++] = 0;
+   while (top > 0)
+   {
+      Node const& node = m_nodes[stack[--top]];
+
+      Frustum::Containment const containment = frustum.Classify(node.bounds);
+      if (containment == Frustum::OUTSIDE) continue;
+      if (containment == Frustum::INSIDE)
+      {
+         AppendSubtree(node, out);
+         continue;
+      }
+
+      if (node.leaf)
+      {
+         for (uint i = node.first; i < node.first + node.count; ++i)
+         {
+            uint const object = m_objectIndices[i];
+            if (frustum.Intersects(m_objectBounds[object]))
+               out.push_back(object);
+         }
+      }
+      else
+      {
+         stack[top++] = node.left;
+         stack[top++] = node.left + 1;
+      }
+   }
+}
+
+void BVH::QuerySphere (BoundingSphere const& sphere, std::vector<uint> & out) const
+{
+   if (m_nodes.empty()) return;
+
+   uint stack[STACK_SIZE];
+   uint top = 0;
+   stack[top++] = 0;
+   while (top > 0)
+   {
+      Node const& node = m_nodes[stack[--top]];
+      if (!Intersects(node.bounds, sphere)) continue;
+
+      if (node.leaf)
+      {
+         for (uint i = node.first; i < node.first + node.count; ++i)
+         {
+            uint const object = m_objectIndices[i];
+            if (Intersects(m_objectBounds[object], sphere))
+               out.push_back(object);
+         }
+      }
+      else
+      {
+         stack[top++] = node.left;
+         stack[top++] = node.left + 1;
+      }
+   }
+}
+
+void BVH::QueryRay (Ray const& ray, std::vector<RayHit> & out, float const maxDistance) const
+{
+   if (m_nodes.empty()) return;
+
+   size_t const firstHit = out.size();
+
+   uint stack[STACK_SIZE];
+   uint top = 0;
+   stack[top++] = 0;
+   while (top > 0)
+   {
+      Node const& node = m_nodes[stack[--top]];
+
+      float t;
+      if (!ray.Intersects(node.bounds, t, maxDistance)) continue;
+
+      if (node.leaf)
+      {
+         for (uint i = node.first; i < node.first + node.count; ++i)
+         {
+            uint const object = m_objectIndices[i];
+            if (ray.Intersects(m_objectBounds[object], t, maxDistance))
+               out.push_back({object, t});
+         }
+      }
+      else
+      {
+         stack[top++] = node.left;
+         stack[top++] = node.left + 1;
+      }
+   }
+
+   std::sort(out.begin() + firstHit, out.end(), [](RayHit const& a, RayHit const& b) { return a.t < b.t; });
+}
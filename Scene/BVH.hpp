@@ -0,0 +1,102 @@
+#ifndef BVH_hpp
+#define BVH_hpp
+
+#include "global.hpp"
+
+#include <vector>
+#include <limits>
+
+#include "Bounds.hpp"
+#include "Frustum.hpp"
+#include "Ray.hpp"
+#include "ITransformListener.hpp"
+#include "Object3D.hpp"
+
+/**
+ * Bounding volume hierarchy over the world-space bounds of a list of scene objects, used to answer
+ * spatial queries in roughly logarithmic rather than linear time.
+ *
+ * Built top-down with binned SAH (surface area heuristic) splits. The BVH listens to the transforms of
+ * the objects it was built over, and refits only the paths from moved objects to the root on the next
+ * call to Refit(). Refitting doesn't change the tree's topology, so after large movements a Build()
+ * yields faster queries.
+ *
+ * All queries report indices into the object list given to Build().
+ */
+class BVH : virtual public ITransformListener
+{
+public:
+   struct RayHit
+   {
+      uint object;
+      float t; // distance along the ray at which it enters the object's bounds
+   };
+
+   BVH () {}
+   virtual ~BVH ();
+
+   // Objects keep pointing to the BVH they were registered with
+   BVH (BVH const&) = delete;
+   BVH & operator= (BVH const&) = delete;
+
+   /**
+    * (Re)builds the hierarchy from scratch. The objects must stay at the same addresses until the next
+    * Build() or Clear(), as the BVH registers itself as their transform listener.
+    */
+   void Build (std::vector<Object3D> & objects);
+
+   /**
+    * Stops listening to the objects and drops the hierarchy
+    */
+   void Clear ();
+
+   /**
+    * Brings the bounds of every node above a moved object up to date
+    */
+   void Refit ();
+
+   bool Empty () const { return m_nodes.empty(); }
+
+   void QueryFrustum (Frustum const& frustum, std::vector<uint> & out) const;
+   void QuerySphere (BoundingSphere const& sphere, std::vector<uint> & out) const;
+
+   /**
+    * Hits are sorted front to back
+    */
+   void QueryRay (Ray const& ray, std::vector<RayHit> & out, float const maxDistance=std::numeric_limits<float>::max()) const;
+
+   /// ITransformListener
+   void OnTransformChanged (uint handle) override;
+
+private:
+   struct Node
+   {
+      AABB bounds;
+      uint left; // interior nodes only; the right child is always left + 1
+      uint parent;
+      uint first; // range of m_objectIndices covered by this node's subtree
+      uint count;
+      bool leaf;
+   };
+
+   static constexpr uint MAX_LEAF_SIZE = 4;
+   static constexpr uint MAX_DEPTH = 64; // bounds the size of the traversal stacks
+   static constexpr uint STACK_SIZE = 2 * MAX_DEPTH;
+   static constexpr uint SAH_BINS = 16;
+   static constexpr uint NO_PARENT = std::numeric_limits<uint>::max();
+
+   void BuildNode (uint const nodeIndex, uint const depth, std::vector<Vector3> const& centroids);
+   void AppendSubtree (Node const& node, std::vector<uint> & out) const;
+
+   std::vector<Object3D> * m_pObjects = nullptr;
+
+   std::vector<Node> m_nodes; // m_nodes[0] is the root
+   std::vector<uint> m_objectIndices; // permutation of object indices, so that every subtree covers a contiguous range
+   std::vector<AABB> m_objectBounds; // world bounds of each object as of the last Build/Refit, indexed by object
+   std::vector<uint> m_leafOfObject; // indexed by object
+
+   std::vector<uint> m_dirtyObjects;
+   std::vector<bool> m_objectIsDirty;
+};
+
+#endif
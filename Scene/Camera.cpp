@@ -6,6 +6,7 @@
 void Camera::UpdateProjectionViewMatrix ()
 {
    m_projectionViewMatrix = m_perspectiveProjectionMatrix * m_viewMatrix;
+   m_frustum = Frustum(m_projectionViewMatrix);
 }
 
 void Camera::UpdatePerspectiveProjectionMatrix ()
@@ -143,4 +144,18 @@ void Camera::Translate (Vector3 const& translation)
 
    m_position += translation;
    // Direction doesn't change with a translation
-}
\ No newline at end of file
+}
+Ray Camera::ScreenRay (float const ndcX, float const ndcY) const
+{
+   // Undo the projection's scaling of x and y to get the direction in view space, where the camera looks down -z
+   float const dx = ndcX / m_perspectiveProjectionMatrix(0, 0);
+   float const dy = ndcY / m_perspectiveProjectionMatrix(1, 1);
+   float const dz = -1.f;
+
+   // The rows of the view matrix's rotation are the camera's basis vectors in world space
+   Vector3 const i = m_viewMatrix.Row(0).xyz();
+   Vector3 const j = m_viewMatrix.Row(1).xyz();
+   Vector3 const k = m_viewMatrix.Row(2).xyz();
+
+   return Ray(m_position, Normalized(i * dx + j * dy + k * dz));
+}
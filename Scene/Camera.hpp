@@ -6,12 +6,15 @@
 #include "Constants.hpp"
 #include "Vector.hpp"
 #include "Matrix.hpp"
+#include "Frustum.hpp"
+#include "Ray.hpp"
 
 class Camera
 {
    Matrix4 m_viewMatrix;
    Matrix4 m_perspectiveProjectionMatrix;
    Matrix4 m_projectionViewMatrix;
+   Frustum m_frustum;
    
    Vector3 m_position;
    Vector3 m_lookAtDirection;
@@ -70,9 +73,19 @@ public:
    Matrix4 const& ProjectionMatrix () const { return m_perspectiveProjectionMatrix; }
    Matrix4 const& ProjectionViewMatrix () const { return m_projectionViewMatrix; }
 
+   /**
+    * World-space view frustum, kept in sync with the projection-view matrix
+    */
+   Frustum const& ViewFrustum () const { return m_frustum; }
+
    Vector3 const& Position() const { return m_position; }
    Vector3 const& LookAtDirection() const { return m_lookAtDirection; }   
 
+   /**
+    * World-space ray from the camera through the given point of the near plane, in NDC ([-1, 1], y up)
+    */
+   Ray ScreenRay (float const ndcX, float const ndcY) const;
+
    void LookAt (Vector3 const& position, Vector3 const& center=Vector3(0, 0, 0), Vector3 const& up=Vector3(0, 1, 0));
 
    void Move (Vector3 const& translation)
@@ -0,0 +1,17 @@
+#ifndef ITransformListener_hpp
+#define ITransformListener_hpp
+
+#include "global.hpp"
+
+/**
+ * Gets told whenever an object's transform changes. The handle is whatever the listener chose
+ * to associate with the object when it started listening.
+ */
+struct ITransformListener
+{
+   virtual ~ITransformListener () {}
+
+   virtual void OnTransformChanged (uint handle) = 0;
+};
+
+#endif
@@ -3,13 +3,17 @@
 
 #include "ICameraFactory.hpp"
 
-#include "LuaContext.hpp"
+#include "LuaSceneLoader.hpp"
 
 class LuaCameraFactory : virtual public ICameraFactory
 {
-   LuaContext _;
+   LuaSceneLoader & m_scenes;
 
 public:
+   /**
+    * Cameras are built from the loader's descriptions, so the script isn't run again just for them
+    */
+   explicit LuaCameraFactory (LuaSceneLoader & scenes) : m_scenes(scenes) {}
    virtual ~LuaCameraFactory () {}
 
    std::unique_ptr<Camera> MakeFromFile (std::string const& filename) override;
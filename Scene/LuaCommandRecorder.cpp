@@ -0,0 +1,47 @@
+#include "LuaCommandRecorder.hpp"
+
+#include <array>
+#include <iostream>
+#include <vector>
+
+bool LuaCommandRecorder::RecordFromFile (std::string const& filename, CommandBuffer & commands)
+{
+   SceneDescription const* pScene = m_scenes.Load(filename);
+   if (!pScene)
+      return false;
+
+   if (!pScene->draw.valid())
+      return true;
+
+   m_scenes.Context().lua.new_usertype<CommandBuffer>("CommandBuffer", sol::no_constructor,
+      "set_viewport", [] (CommandBuffer & self, float x, float y, float width, float height) {
+         self.SetViewport({x, y, width, height});
+      },
+      "draw_lines", [] (CommandBuffer & self, sol::table const& pointsTable, sol::optional<std::array<int, 3>> color) {
+         std::vector<Vector3> points;
+         int length = pointsTable.size();
+         for (int i = 1; i <= length; ++i)
+         {
+            std::array<float, 3> v = pointsTable[i];
+            points.emplace_back(v[0], v[1], v[2]);
+         }
+         if (points.size() % 2 != 0)
+         {
+            std::cout << "Warning: draw_lines needs an even number of points; ignoring the last one" << std::endl;
+            points.pop_back();
+         }
+
+         auto const& c = color.value_or(std::array<int, 3>{255, 255, 255});
+         self.DrawLines(points.data(), points.size(), Color::Mix(uint8_t(c[0]), uint8_t(c[1]), uint8_t(c[2])));
+      }
+   );
+
+   auto result = pScene->draw(&commands);
+   if (!result.valid())
+   {
+      sol::error error = result;
+      std::cerr << "Failed to record the draw commands of " << filename << ": " << error.what() << std::endl;
+      return false;
+   }
+   return true;
+}
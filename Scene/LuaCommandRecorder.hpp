@@ -0,0 +1,33 @@
+#ifndef LuaCommandRecorder_hpp
+#define LuaCommandRecorder_hpp
+
+#include <string>
+
+#include "LuaSceneLoader.hpp"
+#include "CommandBuffer.hpp"
+
+/**
+ * Records the draw commands of a scene script's `draw` function, if it has one:
+ *    draw = function (commands)
+ *       commands:set_viewport(0, 0, 320, 240) -- in pixels, from the bottom-left corner of the screen
+ *       commands:draw_lines({ {0, 0, 0}, {1, 0, 0}, ... }, {255, 0, 0}) -- world-space points, taken two at a time
+ *    end
+ * The function is called once, when the scene is loaded, and what it records is drawn on top of every frame.
+ */
+class LuaCommandRecorder
+{
+   LuaSceneLoader & m_scenes;
+
+public:
+   /**
+    * The `draw` function is taken from the loader's description of the script
+    */
+   explicit LuaCommandRecorder (LuaSceneLoader & scenes) : m_scenes(scenes) {}
+
+   /**
+    * Returns false if the script couldn't be run; a script without a `draw` function records nothing
+    */
+   bool RecordFromFile (std::string const& filename, CommandBuffer & commands);
+};
+
+#endif
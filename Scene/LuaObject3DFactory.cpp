@@ -6,99 +6,458 @@
 #include "Mesh.hpp"
 #include "Material.hpp"
 
-#include "SDLTextureLoader.hpp"
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <unordered_map>
 
-LuaObject3DFactory::LuaObject3DFactory ()
+LuaObject3DFactory::LuaObject3DFactory (LuaSceneLoader & scenes, AssetRegistry & assets, TransformSystem & transforms)
+   : m_scenes(scenes)
+   , m_assets(assets)
+   , m_transforms(transforms)
+{}
+
+/**
+ * Applies the transform on top of the object's current one
+ */
+static void ApplyTransform (Object3D & object, TransformDescription const& transform)
 {
-   m_pTextureLoader = std::make_unique<SDLTextureLoader>();
+   object.Translate(transform.position);
+   object.Scale(transform.scale);
+   object.Rotate(Constants::Deg2Rad(transform.rotation.x), Constants::Deg2Rad(transform.rotation.y), Constants::Deg2Rad(transform.rotation.z));
+}
+
+/**
+ * Gathers the asset paths referenced by the given object and its children, and which textures go on which meshes
+ */
+static void CollectAssetPaths (ObjectDescription const& element, std::vector<std::string> & meshPaths, std::vector<std::string> & texturePaths,
+   std::vector<std::pair<std::string, std::string>> & texturedMeshes)
+{
+   if (!element.mesh.empty())
+      meshPaths.push_back(element.mesh);
+
+   if (!element.diffuse.empty())
+      texturePaths.push_back(element.diffuse);
+
+   if (!element.mesh.empty() && !element.diffuse.empty())
+      texturedMeshes.push_back({element.mesh, element.diffuse});
+
+   for (auto const& child : element.children)
+      CollectAssetPaths(child, meshPaths, texturePaths, texturedMeshes);
 }
 
 std::vector<Object3D> LuaObject3DFactory::MakeFromFile (std::string const& filename)
+{
+   SceneDescription const* pScene = m_scenes.Load(filename);
+   if (!pScene)
+      return std::vector<Object3D>();
+
+   return MakeFromDescription(*pScene);
+}
+
+std::vector<Object3D> LuaObject3DFactory::MakeFromDescription (SceneDescription const& scene, std::vector<size_t>* pCounts)
 {
    std::vector<Object3D> objects;
-      
-   if (!_.LoadFromFile(filename))
-      return objects;
+   m_loadAsync = m_assets.LoadAsync();
 
-   sol::optional<sol::table> config = _.lua["_"]["objects"];
-   if (!config)
-      return objects;
+   // Load all the scene's assets up front, in parallel, rather than one by one as objects come up, unless they're to
+   // be loaded in the background, as objects come up, in which case there's nothing to pack up front either
+   std::vector<std::string> meshPaths, texturePaths;
+   std::vector<std::pair<std::string, std::string>> texturedMeshes;
+   for (auto const& element : scene.objects)
+   {
+      CollectAssetPaths(element, meshPaths, texturePaths, texturedMeshes);
+   }
+   // Streamed textures load in the background instead, once the scene is up
+   if (m_assets.StreamTextures() || m_assets.LoadAsync())
+      texturePaths.clear();
+   if (m_assets.LoadAsync())
+      meshPaths.clear();
+   auto const resident = m_assets.Preload(meshPaths, texturePaths);
 
-   auto & objectsTable = config.value();
-   int length = objectsTable.size();
-   for (int i = 1; i <= length; ++i)
+   // Small textures on meshes whose uvs stay within them share atlas pages, so that those objects batch together
+   if (m_assets.AtlasTextures() && (m_assets.StreamTextures() || m_assets.LoadAsync()))
    {
-      auto element = objectsTable[i];
+      std::cout << "Warning: Textures can't be packed into atlas pages when loaded in the background" << std::endl;
+   }
+   else if (m_assets.AtlasTextures())
+   {
+      std::vector<TextureMap const*> textures;
+      for (auto const& texturedMesh : texturedMeshes)
+      {
+         auto const pMesh = m_assets.GetMesh(texturedMesh.first);
+         auto const pTexture = m_assets.GetTexture(texturedMesh.second);
+         if (pMesh && pTexture && TextureAtlas::Fits(*pTexture) && TextureAtlas::HasUnitUVs(*pMesh))
+            textures.push_back(pTexture.get());
+      }
+      if (!textures.empty())
+      {
+         m_pAtlas = std::make_unique<TextureAtlas>(textures, m_assets.CompressTextures());
+         std::cout << "Packed small textures into " << m_pAtlas->PageCount() << " atlas page(s)" << std::endl;
+      }
+   }
+
+   if (pCounts)
+      pCounts->clear();
+   for (auto const& element : scene.objects)
+   {
+      size_t const first = objects.size();
+      MakeObjects(element, TransformSystem::NONE, objects);
+      if (pCounts)
+         pCounts->push_back(objects.size() - first);
+   }
 
-      Object3D object;
+   // The objects hold on to the pages and meshes they use
+   m_pAtlas.reset();
 
-      sol::optional<std::string> meshStr = element["mesh"];
-      if (meshStr)
-      {
-         // First, interpret as mesh OBJ filepath
-         auto mesh = Mesh::MakeFromOBJ(meshStr.value());
+   return objects;
+}
+
+void LuaObject3DFactory::MakeObjects (ObjectDescription const& element, uint const parentTransform, std::vector<Object3D> & objects)
+{
+   Object3D object;
+
+   if (!element.mesh.empty() && m_loadAsync)
+   {
+      // The object has no mesh, and so doesn't get drawn, until it's loaded
+      object.m_meshHandle = m_assets.LoadMeshAsync(element.mesh);
+   }
+   else if (!element.mesh.empty())
+   {
+      // First, interpret as mesh OBJ filepath. Every object using the same path shares one mesh.
+      auto mesh = m_assets.GetMesh(element.mesh);
 
-         // TODO: Check if it identifies a pre-defined primitive mesh
+      // TODO: Check if it identifies a pre-defined primitive mesh
 
-         // TODO: For now, just ignore if no mesh was makeable
-         if (!mesh) continue;
+      // TODO: For now, just ignore if no mesh was makeable
+      if (!mesh) return;
 
-         if (mesh)
+      object.m_mesh = std::move(mesh);
+   }
+   // TODO: Fallback to default mesh (cube) if could not read mesh
+
+   if (element.hasMaterial)
+   {  
+      // Prepare material
+      std::shared_ptr<Material> pMaterial = std::make_shared<Material>();
+      bool materialIsUseful = false;
+
+      // Streamed textures are only placeholders for now, and so can't be packed
+      bool const hasDiffuse = !element.diffuse.empty();
+      bool const streamed = hasDiffuse && m_assets.StreamTextures();
+      bool const async = hasDiffuse && !streamed && m_loadAsync;
+      auto pDiffuseTexture = hasDiffuse && !streamed && !async ? m_assets.GetTexture(element.diffuse) : nullptr;
+      if (pDiffuseTexture != nullptr || streamed || async)
+      {
+         materialIsUseful |= true;
+
+         TextureSampler const& sampler = element.diffuseSampler;
+         pMaterial->DiffuseSampler(sampler);
+
+         // Clamped textures that were packed are sampled from their region of a page instead, by a copy of the mesh
+         bool const clamped = sampler.addressU == TextureAddress::CLAMP && sampler.addressV == TextureAddress::CLAMP;
+         if (m_pAtlas && object.m_mesh && clamped)
          {
-            object.m_mesh = std::move(mesh);
+            if (auto pMesh = m_pAtlas->MeshFor(object.m_mesh, pDiffuseTexture.get()))
+            {
+               object.m_mesh = std::move(pMesh);
+               pDiffuseTexture = m_pAtlas->Find(pDiffuseTexture.get())->page;
+            }
          }
+
+         if (streamed)
+            pMaterial->DiffuseStream(m_assets.GetStreamedTexture(element.diffuse));
+         else if (async)
+            pMaterial->DiffuseMap(m_assets.LoadTextureAsync(element.diffuse));
+         else
+            pMaterial->DiffuseMap(std::move(pDiffuseTexture));
       }
-      // TODO: Fallback to default mesh (cube) if could not read mesh
-
-      auto material = element["material"];
-      if (material.valid())
-      {  
-         // Prepare material
-         std::unique_ptr<Material> pMaterial(new Material());
-         bool materialIsUseful = false;
-
-         sol::optional<std::string> diffuseStr = material["diffuse"];
-         auto pDiffuseTexture = m_pTextureLoader->LoadFromFile(diffuseStr.value());
-         if (pDiffuseTexture != nullptr)
+
+      if (materialIsUseful)
+      {
+         object.m_material = std::move(pMaterial);
+      }
+      else
+      {
+         std::cout << "Warning: No Material components were loaded successfully" << std::endl;
+      }
+   }
+
+   object.m_isOccluder = element.occluder;
+
+   // Transform (model to parent, or to world if there is no parent). Every copy of the object gets its own, as
+   // the object itself is only a template that's never stored.
+   object.m_pTransforms = &m_transforms;
+
+   // Instances: copies of the object that share its mesh and material, each with its own transform
+   // applied on top of the object's
+   size_t const firstInstance = objects.size();
+   auto makeInstance = [&]() -> Object3D & {
+      objects.push_back(object);
+      Object3D & instance = objects.back();
+      instance.m_transform = m_transforms.Create(parentTransform);
+      ApplyTransform(instance, element.transform);
+      return instance;
+   };
+
+   switch (element.instancing)
+   {
+      case ObjectDescription::Instancing::NONE:
+         makeInstance();
+         break;
+
+      case ObjectDescription::Instancing::GRID:
+      {
+         auto const& n = element.gridCount;
+         Vector3 const& d = element.gridSpacing;
+         objects.reserve(objects.size() + std::max(0, n[0] * n[1] * n[2]));
+         for (int x = 0; x < n[0]; ++x)
          {
-            materialIsUseful |= true;
+            for (int y = 0; y < n[1]; ++y)
+            {
+               for (int z = 0; z < n[2]; ++z)
+               {
+                  makeInstance().Translate(x * d.x, y * d.y, z * d.z);
+               }
+            }
+         }
+         break;
+      }
 
-            pMaterial->DiffuseMap(std::move(pDiffuseTexture));
+      case ObjectDescription::Instancing::LIST:
+         objects.reserve(objects.size() + element.instances.size());
+         for (auto const& instance : element.instances)
+         {
+            ApplyTransform(makeInstance(), instance);
          }
+         break;
+   }
 
-         if (materialIsUseful)
+   // Children: objects whose transforms are relative to this one's, and follow it around. With instances,
+   // every instance gets its own copy of the children.
+   if (element.children.empty()) return;
+
+   size_t const lastInstance = objects.size();
+   for (size_t k = firstInstance; k < lastInstance; ++k)
+   {
+      uint const transform = objects[k].m_transform; // copied, as objects may reallocate below
+      for (auto const& child : element.children)
+      {
+         MakeObjects(child, transform, objects);
+      }
+   }
+}
+
+void LuaObject3DFactory::UpdateTransforms (ObjectDescription const& element, std::vector<Object3D> & objects, size_t & next)
+{
+   // As made by MakeObjects(): the object's transform, then the instance's on top of it, if any
+   auto place = [&]() -> Object3D & {
+      Object3D & object = objects[next++];
+      m_transforms.Position(object.m_transform, Vector3());
+      m_transforms.Rotation(object.m_transform, Quaternion::Identity());
+      m_transforms.Scale(object.m_transform, Vector3(1, 1, 1));
+      ApplyTransform(object, element.transform);
+      return object;
+   };
+
+   size_t const firstInstance = next;
+   switch (element.instancing)
+   {
+      case ObjectDescription::Instancing::NONE:
+         place();
+         break;
+
+      case ObjectDescription::Instancing::GRID:
+      {
+         auto const& n = element.gridCount;
+         Vector3 const& d = element.gridSpacing;
+         for (int x = 0; x < n[0]; ++x)
          {
-            object.m_material = std::move(pMaterial);
+            for (int y = 0; y < n[1]; ++y)
+            {
+               for (int z = 0; z < n[2]; ++z)
+               {
+                  place().Translate(x * d.x, y * d.y, z * d.z);
+               }
+            }
          }
-         else
+         break;
+      }
+
+      case ObjectDescription::Instancing::LIST:
+         for (auto const& instance : element.instances)
          {
-            std::cout << "Warning: No Material components were loaded successfully" << std::endl;
+            ApplyTransform(place(), instance);
          }
+         break;
+   }
+
+   size_t const lastInstance = next;
+   for (size_t k = firstInstance; k < lastInstance; ++k)
+   {
+      for (auto const& child : element.children)
+      {
+         UpdateTransforms(child, objects, next);
       }
+   }
+}
+
+static bool Equal (Vector3 const& a, Vector3 const& b)
+{
+   return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+static bool Equal (TransformDescription const& a, TransformDescription const& b)
+{
+   return Equal(a.position, b.position) && Equal(a.rotation, b.rotation) && Equal(a.scale, b.scale);
+}
+
+/**
+ * How a top-level object changed from one version of the script to the next
+ */
+enum class Change
+{
+   NONE,
+   TRANSFORMS, // only where the object, its instances or its children are placed
+   OTHER // anything that takes making the objects anew, e.g. a mesh, a material or the number of instances
+};
+
+static Change Compare (ObjectDescription const& a, ObjectDescription const& b)
+{
+   if (a.mesh != b.mesh || a.hasMaterial != b.hasMaterial || a.diffuse != b.diffuse || a.occluder != b.occluder
+      || a.diffuseSampler.addressU != b.diffuseSampler.addressU || a.diffuseSampler.addressV != b.diffuseSampler.addressV
+      || a.instancing != b.instancing || a.instances.size() != b.instances.size() || a.gridCount != b.gridCount
+      || a.children.size() != b.children.size())
+   {
+      return Change::OTHER;
+   }
+
+   Change change = Change::NONE;
+   if (!Equal(a.transform, b.transform) || !Equal(a.gridSpacing, b.gridSpacing))
+      change = Change::TRANSFORMS;
+   for (size_t i = 0; i < a.instances.size() && change == Change::NONE; ++i)
+   {
+      if (!Equal(a.instances[i], b.instances[i]))
+         change = Change::TRANSFORMS;
+   }
+   for (size_t i = 0; i < a.children.size(); ++i)
+   {
+      Change const childChange = Compare(a.children[i], b.children[i]);
+      if (childChange == Change::OTHER)
+         return Change::OTHER;
+      if (childChange == Change::TRANSFORMS)
+         change = Change::TRANSFORMS;
+   }
+   return change;
+}
+
+/**
+ * Objects MakeObjects() makes from the given table, unless some of them are left out for want of a mesh
+ */
+static size_t CountObjects (ObjectDescription const& element)
+{
+   size_t instances = 1;
+   if (element.instancing == ObjectDescription::Instancing::GRID)
+      instances = size_t(std::max(0, element.gridCount[0] * element.gridCount[1] * element.gridCount[2]));
+   else if (element.instancing == ObjectDescription::Instancing::LIST)
+      instances = element.instances.size();
+
+   size_t perInstance = 1;
+   for (auto const& child : element.children)
+      perInstance += CountObjects(child);
+   return instances * perInstance;
+}
+
+void LuaObject3DFactory::Reload (SceneDescription const& previous, SceneDescription const& scene, std::vector<Object3D> & objects,
+   std::vector<size_t> & counts, std::vector<Object3D> & removed)
+{
+   assert(counts.size() == previous.objects.size());
+
+   // Each previous top-level object's objects are objects[firsts[i], firsts[i] + counts[i])
+   std::vector<size_t> firsts(counts.size());
+   std::unordered_map<std::string, size_t> previousIndices;
+   size_t first = 0;
+   for (size_t i = 0; i < counts.size(); ++i)
+   {
+      firsts[i] = first;
+      first += counts[i];
+      previousIndices[previous.objects[i].id] = i;
+   }
+   assert(first == objects.size());
+
+   // The scene is already up, so whatever it's missing shows up once loaded, rather than holding up a frame
+   m_loadAsync = true;
+
+   std::vector<Object3D> reloaded;
+   std::vector<size_t> reloadedCounts;
+   std::vector<bool> kept(counts.size(), false);
+   size_t unchanged = 0, placed = 0, made = 0;
+   for (auto const& element : scene.objects)
+   {
+      size_t const firstReloaded = reloaded.size();
 
-      // Transform (model to world)
-      object.ModelMatrix(Matrix4::Identity());
+      auto it = previousIndices.find(element.id);
+      Change change = Change::OTHER;
+      if (it != previousIndices.end() && !kept[it->second])
+      {
+         change = Compare(previous.objects[it->second], element);
+         // Objects left out for want of a mesh can't be told apart from the others, so their siblings are made anew
+         if (counts[it->second] != CountObjects(previous.objects[it->second]))
+            change = Change::OTHER;
+      }
 
-      auto transform = element["transform"];
-      if (transform.valid())
+      if (change == Change::OTHER)
+      {
+         // The previous objects are still around, so whatever assets they share with the new ones are too
+         MakeObjects(element, TransformSystem::NONE, reloaded);
+         ++made;
+      }
+      else
       {
-         sol::optional<std::array<float, 3>> position = transform["position"];
-         if (position)
+         size_t const i = it->second;
+         kept[i] = true;
+         if (change == Change::TRANSFORMS)
          {
-            auto & v = position.value();
-            object.Translate(v[0], v[1], v[2]);
+            size_t next = firsts[i];
+            UpdateTransforms(element, objects, next);
+            ++placed;
          }
-
-         sol::optional<std::array<float, 3>> rotation = transform["rotation"];
-         if (rotation)
+         else
          {
-            auto & v = rotation.value();
-            object.Rotate(Constants::Deg2Rad(v[0]), Constants::Deg2Rad(v[1]), Constants::Deg2Rad(v[2]));
+            ++unchanged;
          }
+         std::move(objects.begin() + firsts[i], objects.begin() + firsts[i] + counts[i], std::back_inserter(reloaded));
       }
 
-      objects.push_back(std::move(object));
+      reloadedCounts.push_back(reloaded.size() - firstReloaded);
    }
 
-   return objects;
-}
\ No newline at end of file
+   size_t const firstRemoved = removed.size();
+   for (size_t i = 0; i < counts.size(); ++i)
+   {
+      if (!kept[i])
+         std::move(objects.begin() + firsts[i], objects.begin() + firsts[i] + counts[i], std::back_inserter(removed));
+   }
+
+   objects = std::move(reloaded);
+   counts = std::move(reloadedCounts);
+
+   // Only transforms used by the objects that are left are kept
+   std::vector<bool> keep(m_transforms.Size(), false);
+   for (auto const& object : objects)
+   {
+      keep[object.m_transform] = true;
+   }
+   auto const remap = m_transforms.Compact(keep);
+   for (auto & object : objects)
+   {
+      object.m_transform = remap[object.m_transform];
+   }
+   for (size_t i = firstRemoved; i < removed.size(); ++i)
+   {
+      removed[i].m_transform = TransformSystem::NONE;
+   }
+
+   std::cout << "Reloaded scene: " << unchanged << " unchanged, " << placed << " moved, " << made << " made anew; "
+      << removed.size() - firstRemoved << " object(s) removed" << std::endl;
+}
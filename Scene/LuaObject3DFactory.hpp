@@ -3,19 +3,56 @@
 
 #include "IObject3DFactory.hpp"
 
-#include "LuaContext.hpp"
-#include "ITextureLoader.hpp"
+#include "LuaSceneLoader.hpp"
+#include "AssetRegistry.hpp"
+#include "TextureAtlas.hpp"
+#include "TransformSystem.hpp"
 
 class LuaObject3DFactory : virtual public IObject3DFactory
 {
-   LuaContext _;
-   std::unique_ptr<ITextureLoader> m_pTextureLoader;
+   LuaSceneLoader & m_scenes;
+   AssetRegistry & m_assets;
+   TransformSystem & m_transforms;
+   std::unique_ptr<TextureAtlas> m_pAtlas; // of the scene being made, if its textures are packed
+   bool m_loadAsync = false; // whether the objects being made load their assets in the background
+
+   /**
+    * Appends the object described by the given table, with its instances and children, to `objects`
+    */
+   void MakeObjects (ObjectDescription const& element, uint const parentTransform, std::vector<Object3D> & objects);
+
+   /**
+    * Places the objects made from the given table anew, starting at objects[next], in the order MakeObjects() made
+    * them in; `next` ends up past them
+    */
+   void UpdateTransforms (ObjectDescription const& element, std::vector<Object3D> & objects, size_t & next);
 
 public:
-   LuaObject3DFactory ();
+   /**
+    * Scenes are read through the given loader. Assets are obtained from the given registry, and every object's
+    * transform is created in the given system. Both must outlive the factory as well as the objects.
+    */
+   LuaObject3DFactory (LuaSceneLoader & scenes, AssetRegistry & assets, TransformSystem & transforms);
    virtual ~LuaObject3DFactory () {}
 
    std::vector<Object3D> MakeFromFile (std::string const& filename);
+
+   /**
+    * The objects of a scene already read, in the order they're declared in, each followed by its instances, then
+    * their children. How many objects each top-level object was made into goes into `pCounts`, if given.
+    */
+   std::vector<Object3D> MakeFromDescription (SceneDescription const& scene, std::vector<size_t>* pCounts=nullptr);
+
+   /**
+    * Brings the objects made from `previous` in line with `scene`, matching top-level objects by id:
+    *    - those whose transforms are all that changed are placed anew, in place;
+    *    - those that are new, or changed otherwise, are made anew, loading their assets in the background;
+    *    - those that are gone, or were made anew, are moved to `removed`, and their transforms dropped.
+    * Assets used by objects on both sides stay resident throughout. `counts` holds how many objects each top-level
+    * object was made into, as filled in by MakeFromDescription(), and is kept up to date.
+    */
+   void Reload (SceneDescription const& previous, SceneDescription const& scene, std::vector<Object3D> & objects,
+      std::vector<size_t> & counts, std::vector<Object3D> & removed);
 };
 
 #endif
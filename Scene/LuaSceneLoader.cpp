@@ -0,0 +1,297 @@
+#include "LuaSceneLoader.hpp"
+
+#include <iostream>
+#include <unordered_set>
+
+#include "Constants.hpp"
+#include "MemoryTracker.hpp"
+
+LuaSceneLoader::LuaSceneLoader (std::shared_ptr<LuaContext> pContext)
+   : m_pContext(std::move(pContext))
+{}
+
+/**
+ * Reads a texture addressing mode, i.e. one of "clamp", "repeat" or "mirror", into `address`; leaves it as is if
+ * there's none
+ */
+static void ReadTextureAddress (sol::optional<std::string> const& name, TextureAddress & address)
+{
+   if (!name) return;
+
+   if (name.value() == "clamp")
+      address = TextureAddress::CLAMP;
+   else if (name.value() == "repeat")
+      address = TextureAddress::REPEAT;
+   else if (name.value() == "mirror")
+      address = TextureAddress::MIRROR;
+   else
+      std::cout << "Warning: Unknown texture address \"" << name.value() << "\"; expected one of clamp, repeat or mirror" << std::endl;
+}
+
+/**
+ * Reads a `transform` table, i.e. { position = {x, y, z}, rotation = {x, y, z}, scale = {x, y, z} } with rotation
+ * in degrees. Scale may also be a single, uniform factor.
+ */
+template <typename Table>
+static TransformDescription ReadTransform (Table const& table)
+{
+   TransformDescription transform;
+
+   sol::optional<std::array<float, 3>> position = table["position"];
+   if (position)
+   {
+      auto & v = position.value();
+      transform.position = Vector3(v[0], v[1], v[2]);
+   }
+
+   sol::optional<std::array<float, 3>> scale = table["scale"];
+   sol::optional<float> uniformScale = table["scale"];
+   if (scale)
+   {
+      auto & v = scale.value();
+      transform.scale = Vector3(v[0], v[1], v[2]);
+   }
+   else if (uniformScale)
+   {
+      float const s = uniformScale.value();
+      transform.scale = Vector3(s, s, s);
+   }
+
+   sol::optional<std::array<float, 3>> rotation = table["rotation"];
+   if (rotation)
+   {
+      auto & v = rotation.value();
+      transform.rotation = Vector3(v[0], v[1], v[2]);
+   }
+
+   return transform;
+}
+
+/**
+ * Reads an object table, with its instances and children, into `out`; returns false if the object is to be left out
+ */
+static bool ReadObject (sol::table const& element, ObjectDescription & out)
+{
+   sol::optional<std::string> id = element["id"];
+   if (id)
+      out.id = id.value();
+
+   sol::optional<std::string> meshStr = element["mesh"];
+   if (meshStr)
+      out.mesh = meshStr.value();
+
+   auto material = element["material"];
+   if (material.valid())
+   {
+      out.hasMaterial = true;
+
+      sol::optional<std::string> diffuseStr = material["diffuse"];
+      if (diffuseStr)
+         out.diffuse = diffuseStr.value();
+
+      // What uv outside of [0, 1] maps to: `address` for both axes, or `address_u` and `address_v` for either
+      ReadTextureAddress(material["address"], out.diffuseSampler.addressU);
+      ReadTextureAddress(material["address"], out.diffuseSampler.addressV);
+      ReadTextureAddress(material["address_u"], out.diffuseSampler.addressU);
+      ReadTextureAddress(material["address_v"], out.diffuseSampler.addressV);
+   }
+
+   sol::optional<bool> occluder = element["occluder"];
+   out.occluder = occluder.value_or(false);
+
+   auto transform = element["transform"];
+   if (transform.valid())
+      out.transform = ReadTransform(transform);
+
+   // Instances: copies of the object that share its mesh and material, each with its own transform
+   // applied on top of the object's. Either an explicit list of transforms, or a regular grid:
+   //    instances = { { position = {...}, rotation = {...} }, ... }
+   //    instances = { grid = { count = {nx, ny, nz}, spacing = {dx, dy, dz} } }
+   sol::optional<sol::table> instances = element["instances"];
+   if (instances)
+   {
+      auto & instancesTable = instances.value();
+      sol::optional<sol::table> grid = instancesTable["grid"];
+      if (grid)
+      {
+         sol::optional<std::array<int, 3>> count = grid.value()["count"];
+         sol::optional<std::array<float, 3>> spacing = grid.value()["spacing"];
+         if (!count || !spacing)
+         {
+            std::cout << "Warning: Instance grid needs both count and spacing" << std::endl;
+            return false;
+         }
+
+         auto const& d = spacing.value();
+         out.instancing = ObjectDescription::Instancing::GRID;
+         out.gridCount = count.value();
+         out.gridSpacing = Vector3(d[0], d[1], d[2]);
+      }
+      else
+      {
+         out.instancing = ObjectDescription::Instancing::LIST;
+         int instanceCount = instancesTable.size();
+         out.instances.reserve(instanceCount);
+         for (int j = 1; j <= instanceCount; ++j)
+         {
+            sol::table instance = instancesTable[j];
+            out.instances.push_back(ReadTransform(instance));
+         }
+      }
+   }
+
+   // Children: objects whose transforms are relative to this one's, and follow it around
+   //    children = { { mesh = ..., transform = {...} }, ... }
+   sol::optional<sol::table> children = element["children"];
+   if (children)
+   {
+      auto & childrenTable = children.value();
+      int childCount = childrenTable.size();
+      for (int j = 1; j <= childCount; ++j)
+      {
+         sol::table child = childrenTable[j];
+         out.children.emplace_back();
+         if (!ReadObject(child, out.children.back()))
+            out.children.pop_back();
+      }
+   }
+
+   return true;
+}
+
+/**
+ * Reads a `camera` table into `camera`
+ */
+template <typename Table>
+static void ReadCamera (Table const& config, Camera & camera)
+{
+   sol::optional<float> fov = config["fov"];
+   if (fov)
+   {
+      camera.Fov(Constants::Deg2Rad(fov.value()));
+   }
+
+   sol::optional<float> near = config["near"];
+   if (near)
+   {
+      camera.Near(near.value());
+   }
+
+   sol::optional<float> far = config["far"];
+   if (far)
+   {
+      camera.Far(far.value());
+   }
+
+   // TODO: Implement proper transform for Camera so that its positioning + orientation works just like Object3D
+   Vector3 newPosition;
+   sol::optional<std::array<float, 3>> position = config["transform"]["position"];
+   if (position)
+   {
+      auto & v = position.value();
+      newPosition = Vector3(v[0], v[1], v[2]);
+   }
+
+   sol::optional<std::array<float, 3>> lookAt = config["look_at"]["at"];
+   sol::optional<std::array<float, 3>> up = config["look_at"]["up"];
+   if (lookAt && up)
+   {
+      auto & v_at = lookAt.value();
+      auto & v_up = up.value();
+      camera.LookAt(newPosition, Vector3(v_at[0], v_at[1], v_at[2]), Vector3(v_up[0], v_up[1], v_up[2]));
+   }
+}
+
+SceneDescription const* LuaSceneLoader::Load (std::string const& filename)
+{
+   auto & pScene = m_scenes[filename];
+   if (pScene)
+      return pScene.get();
+
+   // The state is shared with settings and earlier scenes, so a script that doesn't set _ mustn't find theirs
+   m_pContext->lua["_"] = sol::lua_nil;
+   if (!m_pContext->LoadFromFile(filename))
+   {
+      m_scenes.erase(filename);
+      return nullptr;
+   }
+
+   pScene = Read();
+   return pScene.get();
+}
+
+std::unique_ptr<SceneDescription> LuaSceneLoader::Reload (std::string const& filename)
+{
+   m_pContext->lua["_"] = sol::lua_nil;
+   if (!m_pContext->TryLoadFromFile(filename))
+      return nullptr;
+
+   auto & pScene = m_scenes[filename];
+   auto pPrevious = std::move(pScene);
+   pScene = Read();
+   return pPrevious ? std::move(pPrevious) : std::make_unique<SceneDescription>();
+}
+
+std::unique_ptr<SceneDescription> LuaSceneLoader::Read ()
+{
+   MEMORY_SCOPE(LUA);
+   auto pScene = std::make_unique<SceneDescription>();
+   sol::optional<sol::table> rootTable = m_pContext->lua["_"];
+   if (!rootTable)
+      return pScene; // an empty scene
+   sol::table const& root = rootTable.value();
+
+   auto camera = root["camera"];
+   if (camera.valid())
+   {
+      pScene->hasCamera = true;
+      ReadCamera(camera, pScene->camera);
+   }
+
+   sol::optional<sol::table> objects = root["objects"];
+   if (objects)
+   {
+      auto & objectsTable = objects.value();
+      int length = objectsTable.size();
+      pScene->objects.reserve(length);
+      std::unordered_set<std::string> ids;
+      for (int i = 1; i <= length; ++i)
+      {
+         sol::table element = objectsTable[i];
+         pScene->objects.emplace_back();
+         ObjectDescription & object = pScene->objects.back();
+         if (!ReadObject(element, object))
+         {
+            pScene->objects.pop_back();
+            continue;
+         }
+
+         // Objects without an id are only recognized across reloads for as long as they don't move in the list
+         if (object.id.empty())
+            object.id = "#" + std::to_string(i);
+         if (!ids.insert(object.id).second)
+            std::cout << "Warning: More than one object has the id \"" << object.id << "\"; only one of them is kept across reloads" << std::endl;
+      }
+   }
+
+   // Directional lights, e.g. lights = { {0, 0, -1} }
+   sol::optional<sol::table> lights = root["lights"];
+   if (lights)
+   {
+      auto & lightsTable = lights.value();
+      int length = lightsTable.size();
+      for (int i = 1; i <= length; ++i)
+      {
+         sol::optional<std::array<float, 3>> direction = lightsTable[i];
+         if (!direction) continue;
+         auto & v = direction.value();
+         pScene->lights.push_back(Normalized(Vector3(v[0], v[1], v[2])));
+      }
+   }
+
+   sol::optional<sol::protected_function> draw = root["draw"];
+   if (draw)
+      pScene->draw = draw.value();
+
+   return pScene;
+}
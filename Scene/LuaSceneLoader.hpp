@@ -0,0 +1,49 @@
+#ifndef LuaSceneLoader_hpp
+#define LuaSceneLoader_hpp
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "LuaContext.hpp"
+#include "SceneDescription.hpp"
+
+/**
+ * Runs scene scripts and reads what they declare into a SceneDescription, in a single pass over the script's table.
+ * Descriptions are cached per script, so every factory that builds part of a scene gets the same one, and the
+ * script only runs once however many of them there are.
+ *
+ * Scripts run in the given context, which may be shared with other scripts, e.g. the settings, so that there's a
+ * single Lua state. The context must outlive the loader, and so must the descriptions' `draw` functions, which live
+ * in it.
+ */
+class LuaSceneLoader
+{
+public:
+   explicit LuaSceneLoader (std::shared_ptr<LuaContext> pContext);
+
+   /**
+    * Description of the scene the script declares, run if it wasn't yet; nullptr if it couldn't be run
+    */
+   SceneDescription const* Load (std::string const& filename);
+
+   /**
+    * Runs the script again, e.g. once it has been edited, and caches what it now declares in place of the description
+    * Load() returned so far, which is handed back, so that the two can be compared. Returns nullptr if the script
+    * couldn't be run, in which case the description stays as it was.
+    */
+   std::unique_ptr<SceneDescription> Reload (std::string const& filename);
+
+   LuaContext & Context () { return *m_pContext; }
+
+private:
+   /**
+    * Reads the table the script just assigned to `_`
+    */
+   std::unique_ptr<SceneDescription> Read ();
+
+   std::shared_ptr<LuaContext> m_pContext;
+   std::unordered_map<std::string, std::unique_ptr<SceneDescription>> m_scenes;
+};
+
+#endif
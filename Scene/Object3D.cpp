@@ -1,63 +1,38 @@
 #include "Object3D.hpp"
 
-#include <cmath>
+AABB const& Object3D::WorldBounds () const
+{
+   uint const version = m_pTransforms->Version(m_transform);
+   if (m_worldBoundsVersion != version)
+   {
+      m_worldBounds = m_mesh ? m_mesh->GetBounds().Transformed(ModelMatrix()) : AABB();
+      m_worldBoundsVersion = version;
+   }
+   return m_worldBounds;
+}
 
-void Object3D::ModelMatrix (Matrix4 const& m)
+bool Object3D::SwapInMesh ()
 {
-   m_modelMatrix = m;
-   m_modelMatrixInverse = Inverse_RotationTranslation(m_modelMatrix); // TODO: Will break once we start supporting scaling.
+   if (!m_meshHandle || m_meshHandle->IsLoading()) return false;
+
+   m_mesh = m_meshHandle->Get(); // nullptr if it couldn't be loaded, in which case the object stays empty
+   m_meshHandle.reset();
+   m_worldBoundsVersion = TransformSystem::NONE;
+   return m_mesh != nullptr;
 }
 
 void Object3D::Translate (float const x, float const y, float const z)
 {
-   ModelMatrix(m_modelMatrix + Matrix4(Matrix4::elements_array_type{
-      0, 0, 0, x,
-      0, 0, 0, y,
-      0, 0, 0, z,
-      0, 0, 0, 0
-   }));
+   m_pTransforms->Translate(m_transform, Vector3(x, y, z));
 }
 
-void Object3D::Rotate (float const x, float const y, float const z)
+void Object3D::Scale (float const x, float const y, float const z)
 {
-   // Note that this is a rotation about the object's origin.
-   // Here is the order of transformations to accomplish this:
-   // 1. Translate to origin
-   // 2. Apply rotation about the point (0, 0, 0)
-   // 3. Translate back to object's world position
-
-   float t_x = m_modelMatrix(0,3), t_y = m_modelMatrix(1,3), t_z = m_modelMatrix(2,3);
+   m_pTransforms->Scale(m_transform, m_pTransforms->Scale(m_transform) * Vector3(x, y, z));
+}
 
-   ModelMatrix(
-      Matrix4(Matrix4::elements_array_type{
-         1, 0, 0, t_x,
-         0, 1, 0, t_y,
-         0, 0, 1, t_z,
-         0, 0, 0, 1
-      }) *
-      Matrix4(Matrix4::elements_array_type{
-         1, 0, 0, 0,
-         0, cosf(x), -sinf(x), 0,
-         0, sinf(x), cosf(x), 0,
-         0, 0, 0, 1
-      }) * 
-      Matrix4(Matrix4::elements_array_type{
-         cosf(y), 0, sinf(y), 0,
-         0, 1, 0, 0,
-         -sinf(y), 0, cosf(y), 0,
-         0, 0, 0, 1
-      }) * 
-      Matrix4(Matrix4::elements_array_type{
-         cosf(z), -sinf(z), 0, 0,
-         sinf(z), cosf(z), 0, 0,
-         0, 0, 1, 0,
-         0, 0, 0, 1
-      }) * 
-      Matrix4(Matrix4::elements_array_type{
-         1, 0, 0, -t_x,
-         0, 1, 0, -t_y,
-         0, 0, 1, -t_z,
-         0, 0, 0, 1
-      }) *
-      m_modelMatrix);
-}
\ No newline at end of file
+void Object3D::Rotate (float const x, float const y, float const z)
+{
+   // Note that this is a rotation about the object's origin, around the axes of its parent's (normally the world's) space
+   m_pTransforms->Rotate(m_transform, Quaternion::FromEuler(x, y, z));
+}
@@ -5,9 +5,13 @@
 
 #include <memory>
 
+#include "AssetHandle.hpp"
 #include "Matrix.hpp"
 #include "Mesh.hpp"
 #include "Material.hpp"
+#include "Bounds.hpp"
+#include "ITransformListener.hpp"
+#include "TransformSystem.hpp"
 #include "Color.hpp"
 
 /**
@@ -24,24 +28,36 @@ private:
    uint m_id;
 
    /**
-    * 3D mesh of the object
+    * 3D mesh of the object. Shared with every other object that uses the same mesh asset.
     */
-   std::unique_ptr<Mesh> m_mesh;
+   std::shared_ptr<::Mesh const> m_mesh;
 
    /**
-    * Surface material info for advanced rendering
+    * Mesh being loaded in the background, if any; the object has none until SwapInMesh() finds it loaded
     */
-   std::unique_ptr<Material> m_material;
+   std::shared_ptr<AssetHandle<::Mesh> const> m_meshHandle;
 
    /**
-    * Transforms from model to world space
+    * Surface material info for advanced rendering. Shared between instances declared together.
     */
-   Matrix4 m_modelMatrix;
+   std::shared_ptr<::Material const> m_material;
 
    /**
-    * Transforms from world to model space. The transpose of this matrix can also be used to transform normals
+    * Placement in the scene. The transform itself lives in the system, along with those of every other object.
     */
-   Matrix4 m_modelMatrixInverse;
+   TransformSystem* m_pTransforms = nullptr;
+   uint m_transform = TransformSystem::NONE;
+
+   /**
+    * World-space bounds of the mesh, recomputed lazily after the model matrix changes
+    */
+   mutable AABB m_worldBounds;
+   mutable uint m_worldBoundsVersion = TransformSystem::NONE;
+
+   /**
+    * Large, solid objects that are worth rasterizing into the occlusion buffer to hide whatever is behind them
+    */
+   bool m_isOccluder = false;
 
    /**
     * Must only be constructed and populated by factory
@@ -60,20 +76,63 @@ public:
 
    Material const* Material() const { return m_material.get(); }
 
+   bool IsOccluder () const { return m_isOccluder; }
+
+   uint Transform () const { return m_transform; }
+
    /**
-    * Update the model matrix and all dependents
+    * Transforms from model to world space, as of the transform system's last update
     */
-   void ModelMatrix (Matrix4 const&);
+   Matrix4 const& ModelMatrix () const { return m_pTransforms->WorldMatrix(m_transform); }
 
-   Matrix4 const& ModelMatrix () const { return m_modelMatrix; }
-   Matrix4 const& ModelMatrixInverse () const { return m_modelMatrixInverse; }
+   /**
+    * Transforms from world to model space. The transpose of this matrix can also be used to transform normals
+    */
+   Matrix4 const& ModelMatrixInverse () const { return m_pTransforms->WorldMatrixInverse(m_transform); }
+
+   /**
+    * Transforms normals from model to world space, i.e. the inverse-transpose of the model matrix. Transformed
+    * normals need renormalizing, as objects may be scaled.
+    */
+   Matrix4 const& NormalMatrix () const { return m_pTransforms->NormalMatrix(m_transform); }
 
+   /**
+    * World-space AABB around the object's mesh. Empty if there is no mesh.
+    */
+   AABB const& WorldBounds () const;
+
+   /**
+    * Takes on the mesh being loaded in the background, if it just has been. Returns whether the object got a mesh,
+    * in which case its bounds have changed.
+    */
+   bool SwapInMesh ();
+
+   /**
+    * Told whenever the transform system updates the model matrix. Only one listener is supported; pass nullptr to stop listening
+    */
+   void SetTransformListener (ITransformListener* pListener, uint const handle=0)
+   {
+      m_pTransforms->SetListener(m_transform, pListener, handle);
+   }
+
+   /**
+    * Changes to the transform only show in the model matrix after the transform system's next update
+    */
    void Translate (float const x, float const y, float const z);
    inline void Translate (Vector3 const& translation)
    {
       Translate(translation[0], translation[1], translation[2]);
    }
 
+   /**
+    * Scales the object along its own axes, on top of its current scale. Factors must not be zero.
+    */
+   void Scale (float const x, float const y, float const z);
+   inline void Scale (Vector3 const& factors)
+   {
+      Scale(factors[0], factors[1], factors[2]);
+   }
+
    /**
     * Rotate's the object **about its center, i.e. model-space origin**.
     * Specify euler angles, in radians
@@ -2,15 +2,12 @@
 
 #include <cstring>
 
-#include "SDLTextureLoader.hpp"
 #include "Util.hpp"
 
 uint Object3DFactory::s_appWideNextAvailableObjectId = 1;
 
 Object3DFactory::Object3DFactory ()
-{
-   m_pTextureLoader = std::make_unique<SDLTextureLoader>();
-}
+{}
 
 Object3D* Object3DFactory::MakeTexturedObject (std::string const& objFileName, std::string const& diffuseTextureFilename)
 {
@@ -19,7 +16,7 @@ Object3D* Object3DFactory::MakeTexturedObject (std::string const& objFileName, s
    std::unique_ptr<Object3D> pObject(new Object3D());
 
    // Load mesh
-   pObject->m_mesh = std::move(Mesh::MakeFromOBJ(objFileName));
+   pObject->m_mesh = m_assets.GetMesh(objFileName);
    if (pObject->m_mesh == nullptr)
    {
       return nullptr;
@@ -31,7 +28,7 @@ Object3D* Object3DFactory::MakeTexturedObject (std::string const& objFileName, s
 
    // Load textures
    std::cout << "Diffuse Texture: " << diffuseTextureFilename << std::endl;
-   auto pDiffuseTexture = m_pTextureLoader->LoadFromFile(diffuseTextureFilename);
+   auto pDiffuseTexture = m_assets.GetTexture(diffuseTextureFilename);
    if (pDiffuseTexture != nullptr)
    {
       materialIsUseful |= true;
@@ -48,8 +45,9 @@ Object3D* Object3DFactory::MakeTexturedObject (std::string const& objFileName, s
       std::cout << "Warning: No Material components were loaded successfully" << std::endl;
    }   
 
-   // Initialize model matrix
-   pObject->ModelMatrix(Matrix4::Identity());
+   // Initialize transform
+   pObject->m_pTransforms = &m_transforms;
+   pObject->m_transform = m_transforms.Create();
 
    // Store in factory and return raw pointer
    // BEGIN THREAD UNSAFE
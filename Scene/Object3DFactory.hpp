@@ -7,14 +7,16 @@
 #include <string>
 #include <unordered_map>
 
-#include "ITextureLoader.hpp"
+#include "AssetRegistry.hpp"
+#include "TransformSystem.hpp"
 
 // TODO: To inherit from IObject3DFactory
 class Object3DFactory
 {
    std::unordered_map<uint, std::unique_ptr<Object3D>> m_objectMap;
 
-   std::unique_ptr<ITextureLoader> m_pTextureLoader;
+   AssetRegistry m_assets;
+   TransformSystem m_transforms;
 
    // TODO: This will need to be made thread-safe eventually
    static uint s_appWideNextAvailableObjectId;
@@ -0,0 +1,64 @@
+#ifndef SceneDescription_hpp
+#define SceneDescription_hpp
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "LuaCommon.hpp"
+#include "Vector.hpp"
+#include "Texture.hpp"
+#include "Camera.hpp"
+
+/**
+ * Placement relative to a parent: translated, then scaled, then rotated, by angles in degrees; cf. Object3D
+ */
+struct TransformDescription
+{
+   Vector3 position;
+   Vector3 rotation;
+   Vector3 scale = Vector3(1, 1, 1);
+};
+
+/**
+ * An object as a scene script declares it, along with its instances and children
+ */
+struct ObjectDescription
+{
+   enum class Instancing
+   {
+      NONE, // the object itself
+      LIST, // a copy per transform in `instances`, each on top of the object's transform
+      GRID // a copy per cell of a grid of `gridCount` cells, `gridSpacing` apart
+   };
+
+   std::string id; // matches a top-level object across reloads of the script; its position, e.g. "#2", if not given
+   std::string mesh; // path; none if empty
+   bool hasMaterial = false;
+   std::string diffuse; // path; none if empty
+   TextureSampler diffuseSampler;
+   bool occluder = false;
+   TransformDescription transform;
+
+   Instancing instancing = Instancing::NONE;
+   std::vector<TransformDescription> instances;
+   std::array<int, 3> gridCount = {{0, 0, 0}};
+   Vector3 gridSpacing;
+
+   std::vector<ObjectDescription> children; // placed relative to the object, or to each of its instances
+};
+
+/**
+ * Everything a scene script declares, read out of Lua once so that every part of the scene is built from the same
+ * plain data; cf. LuaSceneLoader
+ */
+struct SceneDescription
+{
+   bool hasCamera = false;
+   Camera camera;
+   std::vector<ObjectDescription> objects;
+   std::vector<Vector3> lights; // directions, normalized; none if the script declares none
+   sol::protected_function draw; // invalid if the script has none; cf. LuaCommandRecorder
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "TransformSystem.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+uint TransformSystem::Create (uint const parent)
+{
+   assert(parent == NONE || parent < Size());
+
+   uint const transform = Size();
+   m_positions.emplace_back();
+   m_rotations.emplace_back();
+   m_scales.emplace_back(1.f, 1.f, 1.f);
+   m_parents.push_back(parent);
+   m_flags.push_back(0);
+
+   m_localMatrices.push_back(Matrix4::Identity());
+   m_localInverses.push_back(Matrix4::Identity());
+   m_worldMatrices.push_back(parent == NONE ? Matrix4::Identity() : m_worldMatrices[parent]);
+   m_worldInverses.push_back(parent == NONE ? Matrix4::Identity() : m_worldInverses[parent]);
+   m_normalMatrices.push_back(parent == NONE ? Matrix4::Identity() : m_normalMatrices[parent]);
+   m_versions.push_back(0);
+
+   m_listeners.push_back(nullptr);
+   m_listenerHandles.push_back(0);
+
+   return transform;
+}
+
+std::vector<uint> TransformSystem::Compact (std::vector<bool> const& keep)
+{
+   assert(keep.size() == Size());
+
+   std::vector<uint> remap(Size(), NONE);
+   uint kept = 0;
+   for (uint i = 0; i < Size(); ++i)
+   {
+      if (!keep[i]) continue;
+
+      uint const parent = m_parents[i];
+      assert(parent == NONE || remap[parent] != NONE);
+
+      remap[i] = kept;
+      if (kept != i)
+      {
+         m_positions[kept] = m_positions[i];
+         m_rotations[kept] = m_rotations[i];
+         m_scales[kept] = m_scales[i];
+         m_flags[kept] = m_flags[i];
+         m_localMatrices[kept] = m_localMatrices[i];
+         m_localInverses[kept] = m_localInverses[i];
+         m_worldMatrices[kept] = m_worldMatrices[i];
+         m_worldInverses[kept] = m_worldInverses[i];
+         m_normalMatrices[kept] = m_normalMatrices[i];
+         m_versions[kept] = m_versions[i];
+         m_listeners[kept] = m_listeners[i];
+         m_listenerHandles[kept] = m_listenerHandles[i];
+      }
+      m_parents[kept] = parent == NONE ? NONE : remap[parent];
+      ++kept;
+   }
+
+   m_positions.resize(kept);
+   m_rotations.resize(kept);
+   m_scales.resize(kept);
+   m_parents.resize(kept);
+   m_flags.resize(kept);
+   m_localMatrices.resize(kept);
+   m_localInverses.resize(kept);
+   m_worldMatrices.resize(kept);
+   m_worldInverses.resize(kept);
+   m_normalMatrices.resize(kept);
+   m_versions.resize(kept);
+   m_listeners.resize(kept);
+   m_listenerHandles.resize(kept);
+
+   return remap;
+}
+
+void TransformSystem::UpdateLocalMatrix (uint const transform)
+{
+   Vector3 const& p = m_positions[transform];
+   Vector3 const& s = m_scales[transform];
+   Matrix4 const R = RotationMatrix(m_rotations[transform]);
+
+   // M = T * R * S, i.e. the columns of R scaled by S, with the translation in the last column
+   Matrix4 & M = m_localMatrices[transform];
+   M = R;
+   for (uint r = 0; r < 3; ++r)
+   {
+      for (uint c = 0; c < 3; ++c)
+         M(r, c) *= s[c];
+      M(r, 3) = p[r];
+   }
+
+   m_localInverses[transform] = Inverse_TRS(p, R, s);
+}
+
+void TransformSystem::Update ()
+{
+   if (!m_anyDirty) return;
+
+   PROFILE_SCOPE("Transforms");
+
+   uint const n = Size();
+
+   // Local matrices don't depend on one another, so this pass is split across threads as is
+   JobSystem::Instance().ParallelFor(n, 256, [this] (uint const begin, uint const end) {
+      for (uint i = begin; i < end; ++i)
+      {
+         if (m_flags[i] & LOCAL_DIRTY)
+            UpdateLocalMatrix(i);
+      }
+   });
+
+   // Parents come before their children, so a change propagates down a whole subtree in this single pass
+   for (uint i = 0; i < n; ++i)
+   {
+      uint const parent = m_parents[i];
+      bool const parentChanged = parent != NONE && (m_flags[parent] & WORLD_CHANGED);
+      if (!(m_flags[i] & LOCAL_DIRTY) && !parentChanged) continue;
+
+      if (parent == NONE)
+      {
+         m_worldMatrices[i] = m_localMatrices[i];
+         m_worldInverses[i] = m_localInverses[i];
+      }
+      else
+      {
+         m_worldMatrices[i] = m_worldMatrices[parent] * m_localMatrices[i];
+         m_worldInverses[i] = m_localInverses[i] * m_worldInverses[parent];
+      }
+      m_normalMatrices[i] = ::NormalMatrix(m_worldInverses[i]);
+      m_flags[i] |= WORLD_CHANGED;
+      ++m_versions[i];
+
+      if (m_listeners[i])
+         m_listeners[i]->OnTransformChanged(m_listenerHandles[i]);
+   }
+
+   std::fill(m_flags.begin(), m_flags.end(), 0);
+   m_anyDirty = false;
+}
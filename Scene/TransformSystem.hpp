@@ -0,0 +1,123 @@
+#ifndef TransformSystem_hpp
+#define TransformSystem_hpp
+
+#include "global.hpp"
+
+#include <vector>
+#include <limits>
+
+#include "Vector.hpp"
+#include "Matrix.hpp"
+#include "Quaternion.hpp"
+#include "ITransformListener.hpp"
+
+/**
+ * Owns the transforms of every object in a scene, stored as parallel (SoA) arrays indexed by transform handle.
+ *
+ * Each transform is a position, rotation and scale relative to its parent. Editing one only flags it as dirty;
+ * world matrices (and their inverses) are recomputed by Update(), once per frame, for the dirty transforms and
+ * their descendants only. A parent's handle is always smaller than its children's, so a single forward pass
+ * over the arrays sees every parent before its children.
+ */
+class TransformSystem
+{
+public:
+   static constexpr uint NONE = std::numeric_limits<uint>::max();
+
+   /**
+    * New transforms are the identity, i.e. they coincide with their parent
+    */
+   uint Create (uint const parent=NONE);
+
+   /**
+    * Drops the transforms that aren't to be kept, none of which may be the parent of one that is, and moves the rest
+    * down to fill in the gaps, in order, so that parents still come first. Returns where each transform went, or
+    * NONE if it was dropped; handles held onto must be remapped accordingly.
+    */
+   std::vector<uint> Compact (std::vector<bool> const& keep);
+
+   size_t Size () const { return m_parents.size(); }
+   uint Parent (uint const transform) const { return m_parents[transform]; }
+
+   /// Local state, relative to the parent
+
+   Vector3 const& Position (uint const transform) const { return m_positions[transform]; }
+   Quaternion const& Rotation (uint const transform) const { return m_rotations[transform]; }
+   Vector3 const& Scale (uint const transform) const { return m_scales[transform]; }
+
+   void Position (uint const transform, Vector3 const& position) { m_positions[transform] = position; MarkDirty(transform); }
+   void Rotation (uint const transform, Quaternion const& rotation) { m_rotations[transform] = rotation; MarkDirty(transform); }
+   void Scale (uint const transform, Vector3 const& scale) { m_scales[transform] = scale; MarkDirty(transform); } // must not be zero along any axis
+
+   void Translate (uint const transform, Vector3 const& translation) { Position(transform, m_positions[transform] + translation); }
+
+   /**
+    * Rotates about the transform's own origin, around the axes of its parent's space
+    */
+   void Rotate (uint const transform, Quaternion const& rotation) { Rotation(transform, Normalized(rotation * m_rotations[transform])); }
+
+   /// World state, as of the last Update()
+
+   Matrix4 const& WorldMatrix (uint const transform) const { return m_worldMatrices[transform]; }
+   Matrix4 const& WorldMatrixInverse (uint const transform) const { return m_worldInverses[transform]; }
+
+   /**
+    * Transforms normals from model to world space. They need renormalizing if the transform has any scale.
+    */
+   Matrix4 const& NormalMatrix (uint const transform) const { return m_normalMatrices[transform]; }
+
+   /**
+    * Changes every time Update() recomputes the world matrix, so that dependents can cache derived values
+    */
+   uint Version (uint const transform) const { return m_versions[transform]; }
+
+   /**
+    * Told about the transform from within Update(), whenever its world matrix changes. One listener per transform.
+    */
+   void SetListener (uint const transform, ITransformListener* pListener, uint const handle=0)
+   {
+      m_listeners[transform] = pListener;
+      m_listenerHandles[transform] = handle;
+   }
+
+   /**
+    * Brings the world matrices of all dirty transforms and their descendants up to date
+    */
+   void Update ();
+
+private:
+   enum Flags : uint8_t
+   {
+      LOCAL_DIRTY = 1 << 0, // position, rotation or scale changed
+      WORLD_CHANGED = 1 << 1 // set during Update(), so that children know to follow
+   };
+
+   void MarkDirty (uint const transform)
+   {
+      m_flags[transform] |= LOCAL_DIRTY;
+      m_anyDirty = true;
+   }
+
+   void UpdateLocalMatrix (uint const transform);
+
+   // Local state
+   std::vector<Vector3> m_positions;
+   std::vector<Quaternion> m_rotations;
+   std::vector<Vector3> m_scales;
+   std::vector<uint> m_parents;
+   std::vector<uint8_t> m_flags;
+   bool m_anyDirty = false;
+
+   // Derived state
+   std::vector<Matrix4> m_localMatrices;
+   std::vector<Matrix4> m_localInverses;
+   std::vector<Matrix4> m_worldMatrices;
+   std::vector<Matrix4> m_worldInverses;
+   std::vector<Matrix4> m_normalMatrices;
+   std::vector<uint> m_versions;
+
+   std::vector<ITransformListener*> m_listeners;
+   std::vector<uint> m_listenerHandles;
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include <string>
 #include <cassert>
 
+#include "Texture.hpp"
+
 namespace pen31ope
 {
    enum WindowedMode {
@@ -18,6 +20,16 @@ namespace pen31ope
       std::string startingSceneScript = "scene.lua"; // doesn't have to be a Lua script, though
       int screenWidth = 640, screenHeight = 480;
       WindowedMode windowedMode = WindowedMode::WINDOWED;
+      std::string cpuLevel; // forces the instruction set of the renderer's kernels, e.g. "sse4.2"; empty to detect
+      int workerThreads = -1; // background threads of the job system; negative for one per hardware thread besides the main one
+      TextureFilter textureFilter = TextureFilter::TRILINEAR;
+      bool textureCompression = false; // cf. TextureCompression
+      bool asyncLoading = true; // cf. AssetRegistry::LoadAsync
+      bool textureAtlas = false; // cf. TextureAtlas
+      bool textureStreaming = false; // cf. TextureStreamer
+      int textureBudgetMB = 256; // of streamed textures' texels
+      std::string assetPack = "assets.pak"; // cf. AssetPack; loose files only if empty or missing
+      bool hotReload = true; // of the scene script, whenever it's saved
 
       struct LoadResult
       {
@@ -1,18 +1,21 @@
 #include "LuaAppSettingsFactory.hpp"
 
+#include <iostream>
+
 #include "SDL.h"
 
-LuaAppSettingsFactory::LuaAppSettingsFactory ()
+LuaAppSettingsFactory::LuaAppSettingsFactory (std::shared_ptr<LuaContext> pContext)
+   : m_pContext(std::move(pContext))
 {}
 
 pen31ope::AppSettings::LoadResult LuaAppSettingsFactory::ReadFromFile (std::string const& fileName)
 {
    pen31ope::AppSettings::LoadResult rc;   
 
-   if (!_.LoadFromFile(fileName))
+   if (!m_pContext->LoadFromFile(fileName))
       return rc;
 
-   auto config = _.lua["_"];
+   auto config = m_pContext->lua["_"];
    if (!config.valid())
       return rc;
 
@@ -42,6 +45,76 @@ pen31ope::AppSettings::LoadResult LuaAppSettingsFactory::ReadFromFile (std::stri
       settings->startingSceneScript = firstScene.value();
    }
 
+   sol::optional<std::string> cpuLevel = config["cpu_level"];
+   if (cpuLevel)
+   {
+      settings->cpuLevel = cpuLevel.value();
+   }
+
+   sol::optional<int> workerThreads = config["worker_threads"];
+   if (workerThreads)
+   {
+      settings->workerThreads = workerThreads.value();
+   }
+
+   sol::optional<std::string> textureFilter = config["texture_filter"];
+   if (textureFilter)
+   {
+      if (textureFilter.value() == "nearest")
+         settings->textureFilter = TextureFilter::NEAREST;
+      else if (textureFilter.value() == "bilinear")
+         settings->textureFilter = TextureFilter::BILINEAR;
+      else if (textureFilter.value() == "trilinear")
+         settings->textureFilter = TextureFilter::TRILINEAR;
+      else
+         std::cerr << "Unknown texture filter \"" << textureFilter.value() << "\"; expected one of nearest, bilinear or trilinear" << std::endl;
+   }
+
+   sol::optional<bool> textureCompression = config["texture_compression"];
+   if (textureCompression)
+   {
+      settings->textureCompression = textureCompression.value();
+   }
+
+   sol::optional<std::string> assetPack = config["asset_pack"];
+   if (assetPack)
+   {
+      settings->assetPack = assetPack.value();
+   }
+
+   sol::optional<bool> hotReload = config["hot_reload"];
+   if (hotReload)
+   {
+      settings->hotReload = hotReload.value();
+   }
+
+   sol::optional<bool> asyncLoading = config["async_loading"];
+   if (asyncLoading)
+   {
+      settings->asyncLoading = asyncLoading.value();
+   }
+
+   sol::optional<bool> textureAtlas = config["texture_atlas"];
+   if (textureAtlas)
+   {
+      settings->textureAtlas = textureAtlas.value();
+   }
+
+   sol::optional<bool> textureStreaming = config["texture_streaming"];
+   if (textureStreaming)
+   {
+      settings->textureStreaming = textureStreaming.value();
+   }
+
+   sol::optional<int> textureBudget = config["texture_budget"];
+   if (textureBudget)
+   {
+      if (textureBudget.value() > 0)
+         settings->textureBudgetMB = textureBudget.value();
+      else
+         std::cerr << "Texture budget must be positive; got " << textureBudget.value() << std::endl;
+   }
+
    rc.success = true;
    rc.value = std::move(settings);
 
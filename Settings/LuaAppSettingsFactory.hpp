@@ -3,14 +3,19 @@
 
 #include "IAppSettingsFactory.hpp"
 
+#include <memory>
+
 #include "LuaContext.hpp"
 
 class LuaAppSettingsFactory : virtual public IAppSettingsFactory
 {
-   LuaContext _;
+   std::shared_ptr<LuaContext> m_pContext;
 
 public:
-   LuaAppSettingsFactory ();
+   /**
+    * Settings scripts run in the given context, which may be shared with the scene's; cf. LuaSceneLoader
+    */
+   explicit LuaAppSettingsFactory (std::shared_ptr<LuaContext> pContext);
    virtual ~LuaAppSettingsFactory () {}
 
    pen31ope::AppSettings::LoadResult ReadFromFile (std::string const& fileName) override;
@@ -0,0 +1,64 @@
+/**
+ * Packs asset files into a single archive; cf. Assets/AssetPack.hpp. Every file under the given directories is packed,
+ * named after its path relative to the working directory, with forward slashes, e.g. "models/cube.obj", so that it's
+ * found by the same path the scene scripts use. The archive is checked once written.
+ *
+ * Usage: pack_assets <archive> <directory or file>...
+ */
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AssetPack.hpp"
+
+namespace fs = std::filesystem;
+
+int main (int argc, char** argv)
+{
+   if (argc < 3)
+   {
+      std::cerr << "Usage: " << argv[0] << " <archive> <directory or file>..." << std::endl;
+      return 1;
+   }
+
+   std::vector<std::pair<std::string, std::string>> files; // name, path
+   for (int i = 2; i < argc; ++i)
+   {
+      std::error_code error;
+      if (fs::is_regular_file(argv[i], error))
+      {
+         files.push_back({fs::path(argv[i]).generic_string(), argv[i]});
+         continue;
+      }
+
+      fs::recursive_directory_iterator it(argv[i], error);
+      if (error)
+      {
+         std::cerr << "Could not read " << argv[i] << ": " << error.message() << std::endl;
+         return 1;
+      }
+      for (auto const& entry : it)
+      {
+         if (entry.is_regular_file())
+            files.push_back({entry.path().generic_string(), entry.path().string()});
+      }
+   }
+
+   std::string const archive = argv[1];
+   if (!AssetPack::Write(archive, files))
+      return 1;
+
+   auto pPack = AssetPack::Open(archive);
+   if (!pPack || !pPack->Verify())
+   {
+      std::cerr << "Asset pack " << archive << " didn't read back as written" << std::endl;
+      return 1;
+   }
+
+   std::cout << "Packed " << pPack->AssetCount() << " assets into " << archive << std::endl;
+   return 0;
+}
@@ -10,10 +10,14 @@
 #include "SDLTextFactory.hpp"
 
 #include "Logger.hpp"
+#include "AssetPack.hpp"
+#include "Kernels.hpp"
+#include "JobSystem.hpp"
 #include "Game.hpp"
 
 #include "AppSettings.hpp"
 #include "LuaAppSettingsFactory.hpp"
+#include "LuaContext.hpp"
 
 pen31ope::AppSettings defaultSettings = {
     "scene.lua",
@@ -37,10 +41,13 @@ int main (int argc, char** argv)
         settingsFile = "settings.lua";
     }
 
+    // Every script runs in the same Lua state: the settings, then the scene
+    auto pLua = std::make_shared<LuaContext>();
+
     pen31ope::AppSettings settings = defaultSettings;
     {
         // Load application settings from config script
-        std::unique_ptr<IAppSettingsFactory> settingsFactory = std::make_unique<LuaAppSettingsFactory>();
+        std::unique_ptr<IAppSettingsFactory> settingsFactory = std::make_unique<LuaAppSettingsFactory>(pLua);
         auto rc = settingsFactory->ReadFromFile(settingsFile);
         if (!rc)
         {
@@ -53,6 +60,23 @@ int main (int argc, char** argv)
     }
     pen31ope::AppSettings::Validate(settings);
 
+    // Pick the renderer's kernels for this CPU before anything gets drawn
+    Kernels::Initialize(settings.cpuLevel.c_str());
+
+    // The main thread becomes worker 0 of the job system
+    JobSystem::Instance().Initialize(settings.workerThreads);
+
+    // Assets are read from a single archive when there's one, so as to open a single file rather than one per asset
+    std::shared_ptr<AssetPack const> pAssetPack;
+    if (!settings.assetPack.empty())
+    {
+        pAssetPack = AssetPack::Open(settings.assetPack);
+        if (!pAssetPack)
+        {
+            std::cout << "No asset pack at " << settings.assetPack << "; reading loose files instead" << std::endl;
+        }
+    }
+
     SDL_SetMainReady();
     std::unique_ptr<SDLRenderer> pSDL = std::make_unique<SDLRenderer>(); // resources are freed at the end via RAII
     pSDL->Initialize(argv[0], settings.screenWidth, settings.screenHeight);
@@ -61,7 +85,7 @@ int main (int argc, char** argv)
     // std::unique_ptr<SDLTextFactory> pTextFactory = std::make_unique<SDLTextFactory>(pSDL->GetRenderer());
     // pTextFactory->Initialize();
     SDLTextFactory textFactory(pSDL->GetRenderer());
-    textFactory.Initialize();
+    textFactory.Initialize(pAssetPack);
 
     // Inititalize RNGs
     // srand(time(nullptr));
@@ -78,12 +102,22 @@ int main (int argc, char** argv)
         game.SetRenderer(pSDL.get());
         // game.SetTextRenderer(pTextFactory.get());
         game.SetTextRenderer(&textFactory);
-        game.SetScreenWidthAndHeight(settings.screenWidth, settings.screenHeight);        
+        game.SetScreenWidthAndHeight(settings.screenWidth, settings.screenHeight);
+        game.SetTextureFilter(settings.textureFilter);
+        game.SetTextureCompression(settings.textureCompression);
+        game.SetTextureAtlas(settings.textureAtlas);
+        game.SetScriptContext(pLua);
+        game.SetAssetPack(pAssetPack);
+        game.SetAsyncLoading(settings.asyncLoading);
+        game.SetTextureStreaming(settings.textureStreaming, size_t(settings.textureBudgetMB) * 1024 * 1024);
+        game.SetHotReload(settings.hotReload);
 
         // Go!
         rc = game.Run();
     }
 
+    JobSystem::Instance().Shutdown();
+
     // spdlog::drop_all(); 	// in Windows, this must be called before main finishes to workaround a known VS issue
 
     return rc;
@@ -23,14 +23,46 @@ _ = {
          }
       },
       {
+         -- Changes to this file show up as soon as it's saved; objects are told apart by id, or else by position
+         id = "head",
          mesh = "models/african_head.obj",
          material = {
             diffuse = "models/african_head_diffuse.tga",
+            -- address = "repeat", -- uv outside [0, 1]: clamp (default), repeat or mirror; or address_u/address_v
          },
          transform = {
             position = {0, 0, 0},
-            rotation = {0, 0, 0}
+            rotation = {0, 0, 0},
+            -- scale = {1, 1, 1} -- or a single, uniform factor
          }
-      }
-   }
+      },
+      -- Children are placed relative to their parent, and follow it around:
+      -- {
+      --    mesh = "models/african_head.obj",
+      --    transform = { position = {2, 0, -2} },
+      --    children = {
+      --       { mesh = "models/cube2.obj", transform = { position = {0, 1.5, 0} } }
+      --    }
+      -- },
+      -- Large objects can hide whatever is behind them from the renderer altogether:
+      -- {
+      --    mesh = "models/cube2.obj",
+      --    transform = { position = {0, 0, -3} },
+      --    occluder = true
+      -- },
+      -- Many copies of one model share its mesh and textures, and are drawn as one batch:
+      -- {
+      --    mesh = "models/african_head.obj",
+      --    material = { diffuse = "models/african_head_diffuse.tga" },
+      --    transform = { position = {-4, -1, -10} },
+      --    instances = { grid = { count = {5, 1, 5}, spacing = {2, 0, 2} } }
+      --    -- or explicitly: instances = { { position = {0, 0, 0} }, { position = {2, 0, 0}, rotation = {0, 90, 0} } }
+      -- },
+   },
+   -- Directions of the lights; a single one, shining into the screen, if there are none:
+   -- lights = { {0, 0, -1} },
+   -- Drawn on top of every frame:
+   -- draw = function (commands)
+   --    commands:draw_lines({ {0, 0, 0}, {1, 0, 0}, {0, 0, 0}, {0, 1, 0}, {0, 0, 0}, {0, 0, 1} }, {255, 255, 0})
+   -- end
 }
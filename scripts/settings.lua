@@ -3,4 +3,14 @@ _ = {
       width = 800,
       height = 800
    },
+   -- cpu_level = "sse4.2", -- one of scalar, sse4.2, avx2 or avx512; detected from the CPU when left out
+   -- worker_threads = 3, -- background threads for the job system, besides the main one; one per hardware thread when left out
+   -- texture_filter = "bilinear", -- one of nearest, bilinear or trilinear; trilinear when left out
+   -- texture_compression = true, -- compresses textures as they're loaded, to 1/8 of their size, at some loss of quality
+   -- asset_pack = "", -- archive of the assets to read them from, rather than from loose files; assets.pak when left out
+   -- async_loading = false, -- loads every asset before the first frame, rather than in the background as it's drawn
+   -- texture_atlas = true, -- packs small textures into shared pages, so that the objects using them batch together
+   -- texture_streaming = true, -- loads textures in the background, their finer mips as needed, instead of up front
+   -- texture_budget = 128, -- megabytes of streamed textures to keep resident at most; 256 when left out
+   -- hot_reload = false, -- stops watching scene.lua, whose changes otherwise show up as soon as it's saved
 }
\ No newline at end of file